@@ -0,0 +1,179 @@
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "blip.h"
+
+#define BLIP_PI 3.14159265358979323846
+
+typedef struct {
+  uint8_t width;
+  // fraction of the output Nyquist frequency the impulses pass
+  double cutoff;
+} blip_quality_spec_t;
+
+static const blip_quality_spec_t quality_specs[] = {
+    [BLIP_QUALITY_LOW] = {8, 0.7},
+    [BLIP_QUALITY_MEDIUM] = {16, 0.9},
+    [BLIP_QUALITY_HIGH] = {32, 0.95},
+};
+// the high pass settles in ~2^BLIP_HIGH_PASS_SHIFT samples, ~15 Hz at 48 kHz
+#define BLIP_HIGH_PASS_SHIFT 9
+
+// sin without pulling in libm, plenty accurate for building the table once
+static double blip_sin(double x) {
+  while (x > BLIP_PI) {
+    x -= 2 * BLIP_PI;
+  }
+  while (x < -BLIP_PI) {
+    x += 2 * BLIP_PI;
+  }
+  double term = x, sum = x;
+  for (int n = 1; n < 12; ++n) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+static double blip_cos(double x) {
+  //
+  return blip_sin(x + BLIP_PI / 2);
+}
+
+/*
+ * Tap k of phase p sits at k - (width / 2 - 1) - p / phases samples from the
+ * step, so the impulse is centred in the taps and every step shows up
+ * width / 2 - 1 samples late
+ */
+void blip_set_quality(blip_t* blip, blip_quality_t quality) {
+  int width = quality_specs[quality].width;
+  double cutoff = quality_specs[quality].cutoff;
+  blip->quality = quality;
+  blip->width = width;
+  memset(blip->kernel, 0, sizeof(blip->kernel));
+  for (int phase = 0; phase < BLIP_PHASES; ++phase) {
+    double taps[BLIP_MAX_KERNEL_WIDTH];
+    double total = 0;
+    for (int k = 0; k < width; ++k) {
+      double t = k - (width / 2 - 1) - (double)phase / BLIP_PHASES;
+      double x = BLIP_PI * cutoff * t;
+      double sinc = x == 0 ? 1 : blip_sin(x) / x;
+      double w = 2 * BLIP_PI * t / width;
+      double blackman = 0.42 + 0.5 * blip_cos(w) + 0.08 * blip_cos(2 * w);
+      taps[k] = sinc * blackman;
+      total += taps[k];
+    }
+    // rounded so every impulse sums to exactly one, or steps would leave a residue
+    int32_t sum = 0;
+    int largest = 0;
+    for (int k = 0; k < width; ++k) {
+      double scaled = taps[k] / total * (1 << BLIP_KERNEL_BITS);
+      blip->kernel[phase][k] = scaled < 0 ? (int16_t)(scaled - 0.5) : (int16_t)(scaled + 0.5);
+      sum += blip->kernel[phase][k];
+      if (blip->kernel[phase][k] > blip->kernel[phase][largest]) {
+        largest = k;
+      }
+    }
+    blip->kernel[phase][largest] += (1 << BLIP_KERNEL_BITS) - sum;
+  }
+}
+
+bool blip_init(blip_t* blip, double clock_rate, double sample_rate) {
+  if (clock_rate <= 0 || sample_rate <= 0 || sample_rate > clock_rate) {
+    return false;
+  }
+  blip_set_quality(blip, BLIP_QUALITY_MEDIUM);
+  blip_set_rates(blip, clock_rate, sample_rate);
+  blip_clear(blip);
+  return true;
+}
+
+void blip_set_rates(blip_t* blip, double clock_rate, double sample_rate) {
+  //
+  blip->factor = (uint64_t)(sample_rate / clock_rate * ((uint64_t)1 << BLIP_FRACTION_BITS) + 0.5);
+}
+
+void blip_clear(blip_t* blip) {
+  blip->offset = 0;
+  blip->integrator = 0;
+  blip->high_pass = 0;
+  memset(blip->deltas, 0, sizeof(blip->deltas));
+}
+
+/*
+ * The SSE2 path takes eight taps at a time: the low and high halves of the
+ * 16-bit products are interleaved back into 32-bit ones and added to the
+ * deltas. It needs `delta` to fit 16 bits, which a sound chip's level changes
+ * always do.
+ */
+void blip_add_delta(blip_t* blip, uint32_t time, int32_t delta) {
+  uint64_t position = blip->offset + time * blip->factor;
+  size_t index = position >> BLIP_FRACTION_BITS;
+  uint32_t phase = (position >> (BLIP_FRACTION_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1);
+  if (index > BLIP_CAPACITY) {
+    return;
+  }
+  const int16_t* kernel = blip->kernel[phase];
+  int32_t* out = &blip->deltas[index];
+#if defined(__SSE2__)
+  if (delta >= INT16_MIN && delta <= INT16_MAX) {
+    __m128i factor = _mm_set1_epi16(delta);
+    for (int k = 0; k < blip->width; k += 8) {
+      __m128i taps = _mm_load_si128((const __m128i*)&kernel[k]);
+      __m128i low = _mm_mullo_epi16(taps, factor);
+      __m128i high = _mm_mulhi_epi16(taps, factor);
+      __m128i* dest = (__m128i*)&out[k];
+      _mm_storeu_si128(dest, _mm_add_epi32(_mm_loadu_si128(dest), _mm_unpacklo_epi16(low, high)));
+      _mm_storeu_si128(dest + 1, _mm_add_epi32(_mm_loadu_si128(dest + 1), _mm_unpackhi_epi16(low, high)));
+    }
+    return;
+  }
+#endif
+  for (int k = 0; k < blip->width; ++k) {
+    out[k] += delta * kernel[k];
+  }
+}
+
+void blip_end_frame(blip_t* blip, uint32_t duration) {
+  //
+  blip->offset += duration * blip->factor;
+}
+
+uint32_t blip_clocks_free(const blip_t* blip) {
+  uint64_t room = ((uint64_t)BLIP_CAPACITY << BLIP_FRACTION_BITS) - blip->offset;
+  return room / blip->factor;
+}
+
+size_t blip_samples_available(const blip_t* blip) {
+  //
+  return blip->offset >> BLIP_FRACTION_BITS;
+}
+
+size_t blip_read_samples(blip_t* blip, int16_t* out, size_t count, size_t stride) {
+  size_t available = blip_samples_available(blip);
+  if (count > available) {
+    count = available;
+  }
+  int64_t integrator = blip->integrator;
+  int32_t high_pass = blip->high_pass;
+  for (size_t i = 0; i < count; ++i) {
+    integrator += blip->deltas[i];
+    int32_t sample = integrator >> BLIP_KERNEL_BITS;
+    high_pass += (sample * 256 - high_pass) >> BLIP_HIGH_PASS_SHIFT;
+    sample -= high_pass / 256;
+    if (out != NULL) {
+      out[i * stride] = sample > INT16_MAX ? INT16_MAX : sample < INT16_MIN ? INT16_MIN : sample;
+    }
+  }
+  blip->integrator = integrator;
+  blip->high_pass = high_pass;
+
+  // what is left, including the tails of impulses past the end of the frame, however wide they were
+  size_t remaining = available - count + BLIP_MAX_KERNEL_WIDTH;
+  memmove(blip->deltas, &blip->deltas[count], remaining * sizeof(int32_t));
+  memset(&blip->deltas[remaining], 0, count * sizeof(int32_t));
+  blip->offset -= (uint64_t)count << BLIP_FRACTION_BITS;
+  return count;
+}
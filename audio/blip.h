@@ -0,0 +1,84 @@
+#ifndef AUDIO_BLIP_H
+#define AUDIO_BLIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Band-limited synthesis buffer. Rather than sampling a waveform every clock,
+ * the source only reports the moments its output changes and by how much.
+ * Each change is written into the buffer as a band-limited step: a windowed
+ * sinc impulse picked from a table by where the change falls between two
+ * output samples. Reading sums the impulses back up into samples, so the cost
+ * is per change, not per clock, and square edges come out without aliasing.
+ *
+ * Times are in source clocks relative to the start of the current frame. A
+ * frame is closed with blip_end_frame, after which its samples can be read.
+ */
+
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << (BLIP_PHASE_BITS))
+// taps of the widest impulse, see blip_quality_t
+#define BLIP_MAX_KERNEL_WIDTH 32
+// impulses are scaled so each one sums to 1 << BLIP_KERNEL_BITS
+#define BLIP_KERNEL_BITS 15
+#define BLIP_CAPACITY 4096
+// clock -> sample position, 32.32 fixed point
+#define BLIP_FRACTION_BITS 32
+
+/*
+ * Wider impulses have a steeper filter, so more of the band up to Nyquist
+ * passes and less above it aliases back, for proportionally more work per
+ * change in the output
+ */
+typedef enum {
+  // 8 taps passing 70% of the band
+  BLIP_QUALITY_LOW,
+  // 16 taps passing 90%
+  BLIP_QUALITY_MEDIUM,
+  // 32 taps passing 95%
+  BLIP_QUALITY_HIGH,
+} blip_quality_t;
+
+typedef struct {
+  uint64_t factor;
+  blip_quality_t quality;
+  uint8_t width;
+  // position of the start of the current frame in `deltas`
+  uint64_t offset;
+  int64_t integrator;
+  // slow running average of the output, subtracted to keep it centred on 0
+  int32_t high_pass;
+  // the first `width` taps of every phase are used
+  _Alignas(16) int16_t kernel[BLIP_PHASES][BLIP_MAX_KERNEL_WIDTH];
+  int32_t deltas[BLIP_CAPACITY + BLIP_MAX_KERNEL_WIDTH];
+} blip_t;
+
+// starts at BLIP_QUALITY_MEDIUM
+bool blip_init(blip_t* blip, double clock_rate, double sample_rate);
+// changes only the impulses added from here on
+void blip_set_quality(blip_t* blip, blip_quality_t quality);
+void blip_set_rates(blip_t* blip, double clock_rate, double sample_rate);
+void blip_clear(blip_t* blip);
+
+/*
+ * The output changes by `delta` at `time`, which must fall within the
+ * current frame and leave room for the samples already buffered. `delta`
+ * must stay within +-65535.
+ */
+void blip_add_delta(blip_t* blip, uint32_t time, int32_t delta);
+void blip_end_frame(blip_t* blip, uint32_t duration);
+
+// clocks a frame can last without overflowing, given what is buffered
+uint32_t blip_clocks_free(const blip_t* blip);
+size_t blip_samples_available(const blip_t* blip);
+
+/*
+ * Takes up to `count` samples out of the buffer, writing each `stride`
+ * int16_t apart so two buffers can fill one interleaved stereo stream.
+ * `out` may be NULL to drop them.
+ */
+size_t blip_read_samples(blip_t* blip, int16_t* out, size_t count, size_t stride);
+
+#endif // !DEBUG
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "blip.h"
+
+/*
+ * Reports the throughput of band-limited synthesis for every quality at both
+ * common output rates: how many output samples and how many input changes it
+ * gets through per microsecond. The input is a 4 MiHz clock with a change of
+ * level every BENCH_EDGE_CLOCKS clocks, a busy square wave, and is fed and
+ * read in 70224 clock frames the way the APU does.
+ */
+
+#define BENCH_CLOCK_RATE 4194304
+#define BENCH_FRAME_CLOCKS 70224
+#define BENCH_FRAMES 600
+#define BENCH_REPEATS 5
+#define BENCH_EDGE_CLOCKS 32
+
+typedef struct {
+  const char* name;
+  blip_quality_t quality;
+} bench_quality_t;
+
+static const bench_quality_t qualities[] = {
+    {   "low",    BLIP_QUALITY_LOW},
+    {"medium", BLIP_QUALITY_MEDIUM},
+    {  "high",   BLIP_QUALITY_HIGH},
+};
+
+static const double rates[] = {44100, 48000};
+
+static int16_t samples[BLIP_CAPACITY];
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// returns how many samples came out
+static uint64_t bench_run(blip_t* blip) {
+  uint64_t total = 0;
+  int32_t level = 1000;
+  for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+    for (uint32_t time = frame % BENCH_EDGE_CLOCKS; time < BENCH_FRAME_CLOCKS; time += BENCH_EDGE_CLOCKS) {
+      blip_add_delta(blip, time, level);
+      level = -level;
+    }
+    blip_end_frame(blip, BENCH_FRAME_CLOCKS);
+    total += blip_read_samples(blip, samples, BLIP_CAPACITY, 1);
+  }
+  return total;
+}
+
+int main(void) {
+  blip_t* blip = malloc(sizeof(blip_t));
+  if (blip == NULL) {
+    return 1;
+  }
+  double edges = (double)BENCH_FRAMES * BENCH_FRAME_CLOCKS / BENCH_EDGE_CLOCKS;
+
+  printf("%-8s %6s %12s %12s %14s\n", "quality", "rate", "ms/emu sec", "samples/us", "changes/us");
+  for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); ++q) {
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r) {
+      double best = 0;
+      uint64_t produced = 0;
+      for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+        blip_init(blip, BENCH_CLOCK_RATE, rates[r]);
+        blip_set_quality(blip, qualities[q].quality);
+        double start = bench_now_ns();
+        produced = bench_run(blip);
+        double ns = bench_now_ns() - start;
+        if (repeat == 0 || ns < best) {
+          best = ns;
+        }
+      }
+      double seconds = (double)BENCH_FRAMES * BENCH_FRAME_CLOCKS / BENCH_CLOCK_RATE;
+      printf("%-8s %6.0f %12.3f %12.1f %14.1f\n", qualities[q].name, rates[r], best / 1e6 / seconds, produced / (best / 1e3), edges / (best / 1e3));
+    }
+  }
+
+  free(blip);
+  return 0;
+}
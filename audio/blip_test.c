@@ -0,0 +1,73 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "blip.h"
+
+#define TEST_CLOCK_RATE 4194304
+#define TEST_SAMPLE_RATE 48000
+
+static blip_t blip;
+static int16_t samples[BLIP_CAPACITY];
+
+Test(blip, frames_turn_into_samples_at_the_output_rate) {
+  cr_assert(blip_init(&blip, TEST_CLOCK_RATE, TEST_SAMPLE_RATE));
+
+  blip_end_frame(&blip, TEST_CLOCK_RATE / 16);
+
+  // the rate ratio is rounded to 32 fractional bits, the count can come out one short
+  size_t available = blip_samples_available(&blip);
+  cr_assert(ge(sz, available, TEST_SAMPLE_RATE / 16 - 1));
+  cr_assert(le(sz, available, TEST_SAMPLE_RATE / 16));
+  cr_assert(eq(sz, blip_read_samples(&blip, samples, BLIP_CAPACITY, 1), available));
+  cr_assert(eq(sz, blip_samples_available(&blip), 0));
+}
+
+Test(blip, steps_settle_at_their_height) {
+  cr_assert(blip_init(&blip, TEST_CLOCK_RATE, TEST_SAMPLE_RATE));
+
+  blip_add_delta(&blip, 100, 8000);
+  blip_end_frame(&blip, 1000);
+  size_t count = blip_read_samples(&blip, samples, BLIP_CAPACITY, 1);
+
+  cr_assert(eq(sz, count, 11));
+  cr_assert(eq(i16, samples[0], 0));
+  // the high pass has only just started pulling it back towards 0
+  cr_assert(gt(i16, samples[count - 1], 0));
+  blip_end_frame(&blip, 1000);
+  blip_read_samples(&blip, samples, BLIP_CAPACITY, 1);
+  cr_assert(gt(i16, samples[10], 7500));
+  cr_assert(lt(i16, samples[10], 8200));
+}
+
+Test(blip, every_quality_keeps_steps_exact) {
+  for (blip_quality_t quality = BLIP_QUALITY_LOW; quality <= BLIP_QUALITY_HIGH; ++quality) {
+    cr_assert(blip_init(&blip, TEST_CLOCK_RATE, TEST_SAMPLE_RATE));
+    blip_set_quality(&blip, quality);
+
+    // the second one is too big for 16 bits and takes the scalar path
+    blip_add_delta(&blip, 123, 3000);
+    blip_add_delta(&blip, 777, 40000);
+    blip_end_frame(&blip, 4000);
+    blip_read_samples(&blip, samples, BLIP_CAPACITY, 1);
+    blip_end_frame(&blip, 4000);
+    blip_read_samples(&blip, samples, BLIP_CAPACITY, 1);
+
+    cr_assert(eq(i64, blip.integrator, (int64_t)43000 << BLIP_KERNEL_BITS));
+  }
+}
+
+Test(blip, a_step_and_its_inverse_leave_nothing_behind) {
+  cr_assert(blip_init(&blip, TEST_CLOCK_RATE, TEST_SAMPLE_RATE));
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    blip_add_delta(&blip, i * 400 + 13, 5000);
+    blip_add_delta(&blip, i * 400 + 213, -5000);
+  }
+  blip_end_frame(&blip, 100 * 400 + 2000);
+  blip_read_samples(&blip, samples, BLIP_CAPACITY, 1);
+  blip_end_frame(&blip, 2000);
+  blip_read_samples(&blip, samples, BLIP_CAPACITY, 1);
+
+  // every impulse sums to exactly one step, so once all their tails are read the level is back at 0
+  cr_assert(eq(i64, blip.integrator, 0));
+}
@@ -0,0 +1,93 @@
+#include "output.h"
+
+#define FRAME_BYTES (AUDIO_RING_CHANNELS * sizeof(int16_t))
+
+static void SDLCALL audio_output_callback(void* data, SDL_AudioStream* stream, int additional_amount, int total_amount) {
+  audio_output_t* output = (audio_output_t*)data;
+  size_t wanted = (additional_amount + FRAME_BYTES - 1) / FRAME_BYTES;
+  while (wanted > 0) {
+    size_t frames = wanted < AUDIO_OUTPUT_CHUNK_FRAMES ? wanted : AUDIO_OUTPUT_CHUNK_FRAMES;
+    size_t popped = audio_ring_pop(&output->ring, output->chunk, frames);
+    if (popped > 0) {
+      SDL_PutAudioStreamData(stream, output->chunk, popped * FRAME_BYTES);
+    }
+    if (popped < frames) {
+      // underrun, counted by the ring; the device plays silence for the rest
+      return;
+    }
+    wanted -= popped;
+  }
+}
+
+bool audio_output_open(audio_output_t* output, int sample_rate) {
+  audio_ring_init(&output->ring);
+  rate_control_init(&output->rate, sample_rate, AUDIO_OUTPUT_TARGET_MS);
+  output->max_frames = sample_rate * AUDIO_OUTPUT_MAX_MS / 1000;
+  output->waits = 0;
+  atomic_init(&output->latency_ms, rate_control_latency_ms(&output->rate));
+  atomic_init(&output->ratio, output->rate.ratio);
+  atomic_init(&output->min_ratio, output->rate.min_ratio);
+  atomic_init(&output->max_ratio, output->rate.max_ratio);
+  atomic_init(&output->published_waits, 0);
+  atomic_init(&output->speed, 1);
+  // a small device buffer keeps the latency down to what the ring holds
+  SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, AUDIO_OUTPUT_DEVICE_FRAMES);
+  SDL_AudioSpec spec = {
+      .format = SDL_AUDIO_S16,
+      .channels = AUDIO_RING_CHANNELS,
+      .freq = sample_rate,
+  };
+  // starts half a target ahead with silence, rate control only closes small gaps and would take seconds to fill an empty ring
+  size_t priming = output->rate.target_frames / 2;
+  SDL_memset(output->chunk, 0, sizeof(output->chunk));
+  audio_ring_push(&output->ring, output->chunk, priming < AUDIO_OUTPUT_CHUNK_FRAMES ? priming : AUDIO_OUTPUT_CHUNK_FRAMES);
+  output->stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, audio_output_callback, output);
+  if (output->stream == NULL) {
+    return false;
+  }
+  // devices start paused
+  return SDL_ResumeAudioStreamDevice(output->stream);
+}
+
+double audio_output_push(audio_output_t* output, const int16_t* samples, size_t frames) {
+  audio_ring_push(&output->ring, samples, frames);
+  size_t fill = audio_ring_fill(&output->ring);
+  if (fill > output->max_frames) {
+    output->waits += 1;
+    uint64_t deadline = SDL_GetTicksNS() + AUDIO_OUTPUT_MAX_WAIT_NS;
+    while (fill > output->max_frames && SDL_GetTicksNS() < deadline) {
+      SDL_DelayNS(1000000);
+      fill = audio_ring_fill(&output->ring);
+    }
+  }
+  rate_control_set_speed(&output->rate, atomic_load_explicit(&output->speed, memory_order_relaxed));
+  double ratio = rate_control_update(&output->rate, fill);
+  atomic_store_explicit(&output->latency_ms, rate_control_latency_ms(&output->rate), memory_order_relaxed);
+  atomic_store_explicit(&output->ratio, output->rate.ratio, memory_order_relaxed);
+  atomic_store_explicit(&output->min_ratio, output->rate.min_ratio, memory_order_relaxed);
+  atomic_store_explicit(&output->max_ratio, output->rate.max_ratio, memory_order_relaxed);
+  atomic_store_explicit(&output->published_waits, output->waits, memory_order_relaxed);
+  return ratio;
+}
+
+void audio_output_set_speed(audio_output_t* output, double speed) {
+  //
+  atomic_store_explicit(&output->speed, speed, memory_order_relaxed);
+}
+
+audio_output_stats_t audio_output_stats(audio_output_t* output) {
+  return (audio_output_stats_t){
+      .latency_ms = atomic_load_explicit(&output->latency_ms, memory_order_relaxed),
+      .ratio = atomic_load_explicit(&output->ratio, memory_order_relaxed),
+      .min_ratio = atomic_load_explicit(&output->min_ratio, memory_order_relaxed),
+      .max_ratio = atomic_load_explicit(&output->max_ratio, memory_order_relaxed),
+      .waits = atomic_load_explicit(&output->published_waits, memory_order_relaxed),
+  };
+}
+
+void audio_output_close(audio_output_t* output) {
+  if (output->stream != NULL) {
+    SDL_DestroyAudioStream(output->stream);
+    output->stream = NULL;
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include <SDL3/SDL.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "rate_control.h"
+#include "ring.h"
+
+// what the device callback pulls from the ring at a time
+#define AUDIO_OUTPUT_CHUNK_FRAMES 1024
+// the device's own buffer, 5.3 ms at 48 kHz
+#define AUDIO_OUTPUT_DEVICE_FRAMES "256"
+// where rate control holds the ring right after a frame went in, and the most it may hold
+#define AUDIO_OUTPUT_TARGET_MS 24
+#define AUDIO_OUTPUT_MAX_MS 30
+// a device that stopped pulling does not hold the emulator up for longer than this
+#define AUDIO_OUTPUT_MAX_WAIT_NS 50000000
+
+// rate control as of the last push, for display
+typedef struct {
+  double latency_ms;
+  double ratio;
+  double min_ratio;
+  double max_ratio;
+  uint64_t waits;
+} audio_output_stats_t;
+
+/*
+ * Plays 16-bit stereo from `ring` on the default device. SDL calls back from
+ * its own audio thread whenever the stream wants more, the callback tops it up
+ * from the ring and leaves the rest of the request as silence.
+ *
+ * The device's clock is the master. A push that leaves more than
+ * AUDIO_OUTPUT_MAX_MS in the ring waits for the device to play it down, so the
+ * emulator can never run ahead of what is heard, and rate control keeps the
+ * fill near AUDIO_OUTPUT_TARGET_MS so that wait is rarely needed.
+ */
+typedef struct {
+  SDL_AudioStream* stream;
+  audio_ring_t ring;
+  // only touched by the pushing thread
+  rate_control_t rate;
+  size_t max_frames;
+  uint64_t waits;
+  // copied out of `rate` after every push, so other threads can read it while the next one is going on
+  _Atomic double latency_ms;
+  _Atomic double ratio;
+  _Atomic double min_ratio;
+  _Atomic double max_ratio;
+  _Atomic uint64_t published_waits;
+  // the emulator's speed as last set, picked up by the next push
+  _Atomic double speed;
+  // only touched by the callback
+  int16_t chunk[AUDIO_OUTPUT_CHUNK_FRAMES * AUDIO_RING_CHANNELS];
+} audio_output_t;
+
+bool audio_output_open(audio_output_t* output, int sample_rate);
+/*
+ * From the emulator thread, returns the resampling ratio to produce the next
+ * frame's samples at
+ */
+double audio_output_push(audio_output_t* output, const int16_t* samples, size_t frames);
+// from any thread, whenever the emulator is told to run at another speed
+void audio_output_set_speed(audio_output_t* output, double speed);
+// from any thread, each field is as of some push but they may be from different ones
+audio_output_stats_t audio_output_stats(audio_output_t* output);
+void audio_output_close(audio_output_t* output);
+
+#endif // !DEBUG
@@ -0,0 +1,40 @@
+#include "rate_control.h"
+
+void rate_control_init(rate_control_t* rc, double sample_rate, double target_ms) {
+  rc->sample_rate = sample_rate;
+  rc->target_frames = sample_rate * target_ms / 1000;
+  rc->fill = rc->target_frames;
+  rc->integral = 0;
+  rc->speed = 1;
+  rc->ratio = 1;
+  rc->min_ratio = 1;
+  rc->max_ratio = 1;
+  rc->updates = 0;
+}
+
+void rate_control_set_speed(rate_control_t* rc, double speed) {
+  //
+  rc->speed = speed;
+}
+
+static double clamp_unit(double value) {
+  //
+  return value > 1 ? 1 : value < -1 ? -1 : value;
+}
+
+double rate_control_update(rate_control_t* rc, size_t fill_frames) {
+  rc->fill += (fill_frames - rc->fill) / (1 << RATE_CONTROL_SMOOTHING_SHIFT);
+  double error = (rc->target_frames - rc->fill) / rc->target_frames;
+  // clamped so it cannot wind up past what the ratio is allowed to do
+  rc->integral = clamp_unit(rc->integral + RATE_CONTROL_INTEGRAL * error);
+  rc->ratio = 1 + RATE_CONTROL_MAX_DEVIATION * clamp_unit(RATE_CONTROL_PROPORTIONAL * error + rc->integral);
+  rc->min_ratio = rc->ratio < rc->min_ratio ? rc->ratio : rc->min_ratio;
+  rc->max_ratio = rc->ratio > rc->max_ratio ? rc->ratio : rc->max_ratio;
+  rc->updates += 1;
+  return rc->ratio / rc->speed;
+}
+
+double rate_control_latency_ms(const rate_control_t* rc) {
+  //
+  return rc->fill * 1000 / rc->sample_rate;
+}
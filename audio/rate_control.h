@@ -0,0 +1,52 @@
+#ifndef AUDIO_RATE_CONTROL_H
+#define AUDIO_RATE_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Dynamic rate control. The emulator and the audio device run off different
+ * clocks, however close their nominal rates, so a fixed resampling ratio
+ * slowly fills or drains whatever buffer sits between them. Instead the ratio
+ * is nudged each emulated frame by how far the buffer's fill is from its
+ * target: a draining buffer gets slightly more samples per emulated second, a
+ * filling one slightly fewer. The nudge never exceeds
+ * RATE_CONTROL_MAX_DEVIATION, far too little to hear as a change in pitch.
+ *
+ * The proportional part alone would settle with the fill off target by however
+ * much it takes to cancel the drift, the integral part walks it back.
+ *
+ * An emulator deliberately run faster or slower, to match the display or for
+ * turbo, is no drift: the speed is divided out of the ratio up front, so
+ * each emulated second still fills one real second of the device.
+ */
+
+#define RATE_CONTROL_MAX_DEVIATION 0.005
+// weight of a new fill reading in the running average, 1 / 2^n
+#define RATE_CONTROL_SMOOTHING_SHIFT 3
+// in units of RATE_CONTROL_MAX_DEVIATION per target's worth of error
+#define RATE_CONTROL_PROPORTIONAL 4.0
+#define RATE_CONTROL_INTEGRAL 0.02
+
+typedef struct {
+  double sample_rate;
+  double target_frames;
+  // running average of the fill, so one late device callback does not jerk the ratio
+  double fill;
+  double integral;
+  // emulated seconds per real second
+  double speed;
+  // the correction alone, without the speed
+  double ratio;
+  double min_ratio;
+  double max_ratio;
+  uint64_t updates;
+} rate_control_t;
+
+void rate_control_init(rate_control_t* rc, double sample_rate, double target_ms);
+void rate_control_set_speed(rate_control_t* rc, double speed);
+// takes the fill right after a frame's samples went in, returns the ratio for the next frame, speed included
+double rate_control_update(rate_control_t* rc, size_t fill_frames);
+double rate_control_latency_ms(const rate_control_t* rc);
+
+#endif // !DEBUG
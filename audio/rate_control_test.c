@@ -0,0 +1,73 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "rate_control.h"
+
+#define TEST_SAMPLE_RATE 48000
+#define TEST_TARGET_MS 24
+// samples in one 70224 dot frame at 48 kHz
+#define TEST_FRAME_SAMPLES (TEST_SAMPLE_RATE * 70224.0 / 4194304)
+
+static rate_control_t rc;
+
+Test(rate_control, the_ratio_stays_within_half_a_percent) {
+  rate_control_init(&rc, TEST_SAMPLE_RATE, TEST_TARGET_MS);
+  for (int i = 0; i < 1000; ++i) {
+    rate_control_update(&rc, 0);
+  }
+  cr_assert(eq(dbl, rc.ratio, 1 + RATE_CONTROL_MAX_DEVIATION));
+  for (int i = 0; i < 1000; ++i) {
+    rate_control_update(&rc, TEST_SAMPLE_RATE);
+  }
+  cr_assert(eq(dbl, rc.ratio, 1 - RATE_CONTROL_MAX_DEVIATION));
+  cr_assert(eq(dbl, rc.min_ratio, 1 - RATE_CONTROL_MAX_DEVIATION));
+  cr_assert(eq(dbl, rc.max_ratio, 1 + RATE_CONTROL_MAX_DEVIATION));
+}
+
+Test(rate_control, a_buffer_on_target_keeps_the_nominal_ratio) {
+  rate_control_init(&rc, TEST_SAMPLE_RATE, TEST_TARGET_MS);
+  cr_assert(eq(dbl, rate_control_update(&rc, TEST_SAMPLE_RATE * TEST_TARGET_MS / 1000), 1));
+  cr_assert(eq(dbl, rate_control_latency_ms(&rc), TEST_TARGET_MS));
+}
+
+/*
+ * A device playing 0.3% faster than the emulator's nominal rate drains the
+ * buffer, until the ratio has risen to match it and the fill is back on target
+ */
+Test(rate_control, a_drifting_device_is_followed) {
+  rate_control_init(&rc, TEST_SAMPLE_RATE, TEST_TARGET_MS);
+  double device = TEST_FRAME_SAMPLES * 1.003;
+  double fill = TEST_SAMPLE_RATE * TEST_TARGET_MS / 1000.0;
+  for (int frame = 0; frame < 60 * 60; ++frame) {
+    fill += TEST_FRAME_SAMPLES * rc.ratio - device;
+    cr_assert(gt(dbl, fill, TEST_FRAME_SAMPLES));
+    rate_control_update(&rc, fill);
+  }
+  cr_assert(gt(dbl, rc.ratio, 1.0029));
+  cr_assert(lt(dbl, rc.ratio, 1.0031));
+  cr_assert(gt(dbl, rate_control_latency_ms(&rc), TEST_TARGET_MS - 1));
+  cr_assert(lt(dbl, rate_control_latency_ms(&rc), TEST_TARGET_MS + 1));
+}
+
+/*
+ * An emulator run 2% fast, as for a 60.9 Hz display, plays each frame in 2%
+ * less real time. Far more than the correction could cover, but the speed
+ * takes it out and the correction is left with nothing to do.
+ */
+Test(rate_control, the_speed_is_divided_out) {
+  rate_control_init(&rc, TEST_SAMPLE_RATE, TEST_TARGET_MS);
+  rate_control_set_speed(&rc, 1.02);
+  double device = TEST_FRAME_SAMPLES / 1.02;
+  double fill = TEST_SAMPLE_RATE * TEST_TARGET_MS / 1000.0;
+  double ratio = 1;
+  for (int frame = 0; frame < 60 * 60; ++frame) {
+    fill += TEST_FRAME_SAMPLES * ratio - device;
+    cr_assert(gt(dbl, fill, TEST_FRAME_SAMPLES));
+    cr_assert(lt(dbl, fill, TEST_SAMPLE_RATE * TEST_TARGET_MS / 1000.0 + TEST_FRAME_SAMPLES));
+    ratio = rate_control_update(&rc, fill);
+  }
+  cr_assert(gt(dbl, rc.ratio, 0.9999));
+  cr_assert(lt(dbl, rc.ratio, 1.0001));
+  cr_assert(gt(dbl, rate_control_latency_ms(&rc), TEST_TARGET_MS - 1));
+  cr_assert(lt(dbl, rate_control_latency_ms(&rc), TEST_TARGET_MS + 1));
+}
@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "ring.h"
+
+#define RING_MASK ((AUDIO_RING_FRAMES) - 1)
+
+void audio_ring_init(audio_ring_t* ring) {
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->overruns, 0);
+  atomic_init(&ring->dropped, 0);
+  atomic_init(&ring->underruns, 0);
+}
+
+/*
+ * Copies `frames` frames in at `start`, in two pieces when they run past the
+ * end of the storage
+ */
+static void ring_copy_in(audio_ring_t* ring, uint64_t start, const int16_t* samples, size_t frames) {
+  size_t offset = start & RING_MASK;
+  size_t first = frames < AUDIO_RING_FRAMES - offset ? frames : AUDIO_RING_FRAMES - offset;
+  memcpy(&ring->samples[offset * AUDIO_RING_CHANNELS], samples, first * AUDIO_RING_CHANNELS * sizeof(int16_t));
+  memcpy(ring->samples, samples + first * AUDIO_RING_CHANNELS, (frames - first) * AUDIO_RING_CHANNELS * sizeof(int16_t));
+}
+
+static void ring_copy_out(audio_ring_t* ring, uint64_t start, int16_t* samples, size_t frames) {
+  size_t offset = start & RING_MASK;
+  size_t first = frames < AUDIO_RING_FRAMES - offset ? frames : AUDIO_RING_FRAMES - offset;
+  memcpy(samples, &ring->samples[offset * AUDIO_RING_CHANNELS], first * AUDIO_RING_CHANNELS * sizeof(int16_t));
+  memcpy(samples + first * AUDIO_RING_CHANNELS, ring->samples, (frames - first) * AUDIO_RING_CHANNELS * sizeof(int16_t));
+}
+
+size_t audio_ring_push(audio_ring_t* ring, const int16_t* samples, size_t frames) {
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  // the consumer's release on `head` means it is done reading what it handed back
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  size_t room = AUDIO_RING_FRAMES - (tail - head);
+  size_t count = frames < room ? frames : room;
+  if (count < frames) {
+    atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->dropped, frames - count, memory_order_relaxed);
+  }
+  ring_copy_in(ring, tail, samples, count);
+  atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+  return count;
+}
+
+size_t audio_ring_pop(audio_ring_t* ring, int16_t* samples, size_t frames) {
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  size_t available = tail - head;
+  size_t count = frames < available ? frames : available;
+  if (count < frames) {
+    atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+  }
+  ring_copy_out(ring, head, samples, count);
+  atomic_store_explicit(&ring->head, head + count, memory_order_release);
+  return count;
+}
+
+/*
+ * Safe from either side or a third thread, though from anywhere but the
+ * consumer it can be stale by the time it is used
+ */
+size_t audio_ring_fill(audio_ring_t* ring) {
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  // read after head, so it cannot be behind it
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return tail - head;
+}
+
+audio_ring_stats_t audio_ring_stats(audio_ring_t* ring) {
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return (audio_ring_stats_t){
+      .pushed = tail,
+      .popped = head,
+      .overruns = atomic_load_explicit(&ring->overruns, memory_order_relaxed),
+      .dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed),
+      .underruns = atomic_load_explicit(&ring->underruns, memory_order_relaxed),
+      .fill = tail - head,
+  };
+}
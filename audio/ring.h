@@ -0,0 +1,52 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hands interleaved stereo samples from the emulator thread to the audio
+ * device's callback without either side taking a lock.
+ *
+ * Single producer, single consumer: only the producer moves `tail` and only
+ * the consumer moves `head`, both count sample frames from the start and are
+ * never wrapped, so the fill level is always `tail - head`. What does not fit
+ * is dropped and counted as an overrun, a pop that comes up short counts as an
+ * underrun.
+ */
+
+// a power of two, 170 ms at 48 kHz
+#define AUDIO_RING_FRAMES 8192
+#define AUDIO_RING_CHANNELS 2
+
+typedef struct {
+  uint64_t pushed;
+  uint64_t popped;
+  // pushes that had to drop frames, and how many they dropped
+  uint64_t overruns;
+  uint64_t dropped;
+  // pops that found fewer frames than asked for
+  uint64_t underruns;
+  // frames waiting right now
+  size_t fill;
+} audio_ring_stats_t;
+
+typedef struct {
+  _Alignas(64) _Atomic uint64_t head;
+  _Alignas(64) _Atomic uint64_t tail;
+  _Alignas(64) _Atomic uint64_t overruns;
+  _Atomic uint64_t dropped;
+  _Atomic uint64_t underruns;
+  int16_t samples[AUDIO_RING_FRAMES * AUDIO_RING_CHANNELS];
+} audio_ring_t;
+
+void audio_ring_init(audio_ring_t* ring);
+// producer side, returns how many frames fit
+size_t audio_ring_push(audio_ring_t* ring, const int16_t* samples, size_t frames);
+// consumer side, returns how many frames were there
+size_t audio_ring_pop(audio_ring_t* ring, int16_t* samples, size_t frames);
+size_t audio_ring_fill(audio_ring_t* ring);
+audio_ring_stats_t audio_ring_stats(audio_ring_t* ring);
+
+#endif // !DEBUG
@@ -0,0 +1,79 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ring.h"
+
+/*
+ * Pushes emulator-frame sized blocks from one thread while another pops
+ * device-callback sized blocks, as fast as both can go, and reports the cost
+ * per sample frame and that every frame came out in order.
+ */
+
+#define BENCH_FRAMES (48000 * 60)
+// one 70224 dot frame at 48 kHz, and a typical device callback
+#define BENCH_PUSH_FRAMES 803
+#define BENCH_POP_FRAMES 512
+
+static audio_ring_t ring;
+
+static void* bench_consumer(void* args) {
+  uint64_t* mismatches = (uint64_t*)args;
+  static int16_t block[BENCH_POP_FRAMES * AUDIO_RING_CHANNELS];
+  uint64_t expected = 0;
+  while (expected < BENCH_FRAMES) {
+    size_t popped = audio_ring_pop(&ring, block, BENCH_POP_FRAMES);
+    for (size_t i = 0; i < popped; ++i) {
+      *mismatches += block[i * AUDIO_RING_CHANNELS] != (int16_t)(expected + i);
+    }
+    expected += popped;
+    if (popped == 0) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void) {
+  static int16_t block[BENCH_PUSH_FRAMES * AUDIO_RING_CHANNELS];
+  audio_ring_init(&ring);
+  uint64_t mismatches = 0;
+
+  double start = bench_now_ns();
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, bench_consumer, &mismatches);
+  uint64_t sent = 0;
+  while (sent < BENCH_FRAMES) {
+    size_t frames = BENCH_FRAMES - sent < BENCH_PUSH_FRAMES ? BENCH_FRAMES - sent : BENCH_PUSH_FRAMES;
+    for (size_t i = 0; i < frames; ++i) {
+      block[i * AUDIO_RING_CHANNELS] = (int16_t)(sent + i);
+      block[i * AUDIO_RING_CHANNELS + 1] = 0;
+    }
+    // a real emulator drops what does not fit, here the producer waits so every frame is checked
+    size_t pushed = 0;
+    while (pushed < frames) {
+      size_t room = AUDIO_RING_FRAMES - audio_ring_fill(&ring);
+      size_t count = frames - pushed < room ? frames - pushed : room;
+      pushed += audio_ring_push(&ring, &block[pushed * AUDIO_RING_CHANNELS], count);
+      if (count == 0) {
+        sched_yield();
+      }
+    }
+    sent += frames;
+  }
+  pthread_join(consumer, NULL);
+  double ns = bench_now_ns() - start;
+
+  audio_ring_stats_t stats = audio_ring_stats(&ring);
+  printf("%d frames (one emulated minute) in %.2f ms, %.2f ns per frame\n", BENCH_FRAMES, ns / 1e6, ns / BENCH_FRAMES);
+  printf("mismatches=%lu overruns=%lu underruns=%lu\n", (unsigned long)mismatches, (unsigned long)stats.overruns, (unsigned long)stats.underruns);
+  return mismatches != 0;
+}
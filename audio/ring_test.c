@@ -0,0 +1,58 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "ring.h"
+
+static audio_ring_t ring;
+static int16_t in[AUDIO_RING_FRAMES * AUDIO_RING_CHANNELS];
+static int16_t out[AUDIO_RING_FRAMES * AUDIO_RING_CHANNELS];
+
+static void fill_pattern(int16_t* samples, size_t frames, int16_t start) {
+  for (size_t i = 0; i < frames * AUDIO_RING_CHANNELS; ++i) {
+    samples[i] = start + i;
+  }
+}
+
+Test(audio_ring, frames_come_out_in_order_across_the_wrap) {
+  audio_ring_init(&ring);
+  // park head and tail just short of the end of the storage
+  fill_pattern(in, AUDIO_RING_FRAMES - 10, 0);
+  audio_ring_push(&ring, in, AUDIO_RING_FRAMES - 10);
+  audio_ring_pop(&ring, out, AUDIO_RING_FRAMES - 10);
+
+  fill_pattern(in, 100, 1000);
+  cr_assert(eq(sz, audio_ring_push(&ring, in, 100), 100));
+  cr_assert(eq(sz, audio_ring_fill(&ring), 100));
+  cr_assert(eq(sz, audio_ring_pop(&ring, out, 100), 100));
+  for (size_t i = 0; i < 100 * AUDIO_RING_CHANNELS; ++i) {
+    cr_assert(eq(i16, out[i], (int16_t)(1000 + i)));
+  }
+  cr_assert(eq(sz, audio_ring_fill(&ring), 0));
+}
+
+Test(audio_ring, a_full_ring_drops_and_counts) {
+  audio_ring_init(&ring);
+  fill_pattern(in, AUDIO_RING_FRAMES, 0);
+  cr_assert(eq(sz, audio_ring_push(&ring, in, AUDIO_RING_FRAMES - 5), AUDIO_RING_FRAMES - 5));
+  cr_assert(eq(sz, audio_ring_push(&ring, in, 20), 5));
+
+  audio_ring_stats_t stats = audio_ring_stats(&ring);
+  cr_assert(eq(u64, stats.overruns, 1));
+  cr_assert(eq(u64, stats.dropped, 15));
+  cr_assert(eq(sz, stats.fill, AUDIO_RING_FRAMES));
+}
+
+Test(audio_ring, an_empty_ring_counts_underruns) {
+  audio_ring_init(&ring);
+  fill_pattern(in, 10, 0);
+  audio_ring_push(&ring, in, 10);
+
+  cr_assert(eq(sz, audio_ring_pop(&ring, out, 64), 10));
+  cr_assert(eq(sz, audio_ring_pop(&ring, out, 64), 0));
+
+  audio_ring_stats_t stats = audio_ring_stats(&ring);
+  cr_assert(eq(u64, stats.underruns, 2));
+  cr_assert(eq(u64, stats.pushed, 10));
+  cr_assert(eq(u64, stats.popped, 10));
+  cr_assert(eq(u64, stats.overruns, 0));
+}
@@ -0,0 +1,161 @@
+#include <string.h>
+
+#include "capture.h"
+
+static size_t frame_bytes(capture_format_t format) {
+  //
+  return format == CAPTURE_FORMAT_Y4M ? sizeof("FRAME\n") - 1 + YUV_FRAME_BYTES : RGB_FRAME_BYTES;
+}
+
+static void capture_flush(capture_t* capture) {
+  if (capture->buffered == 0) {
+    return;
+  }
+  if (!atomic_load_explicit(&capture->closed, memory_order_relaxed)) {
+    if (fwrite(capture->buffer, 1, capture->buffered, capture->file) == capture->buffered) {
+      atomic_fetch_add_explicit(&capture->bytes, capture->buffered, memory_order_relaxed);
+    } else {
+      atomic_store_explicit(&capture->closed, true, memory_order_relaxed);
+    }
+  }
+  capture->buffered = 0;
+}
+
+static void capture_write_frame(capture_t* capture, const capture_slot_t* slot) {
+  if (atomic_load_explicit(&capture->closed, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&capture->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  if (capture->buffered + frame_bytes(capture->format) > CAPTURE_BUFFER_BYTES) {
+    capture_flush(capture);
+  }
+  const yuv_lut_t* lut = &capture->lut;
+  if (slot->cgb) {
+    if (!capture->cgb_lut.cgb || memcmp(capture->cgb_colors, slot->colors, sizeof(slot->colors)) != 0) {
+      memcpy(capture->cgb_colors, slot->colors, sizeof(slot->colors));
+      yuv_lut_set_cgb(&capture->cgb_lut, slot->colors);
+    }
+    lut = &capture->cgb_lut;
+  }
+  uint8_t* dest = &capture->buffer[capture->buffered];
+  if (capture->format == CAPTURE_FORMAT_Y4M) {
+    memcpy(dest, "FRAME\n", 6);
+    yuv_convert_i420(lut, slot->pixels, dest + 6);
+  } else {
+    yuv_convert_rgb24(lut, slot->pixels, dest);
+  }
+  capture->buffered += frame_bytes(capture->format);
+  atomic_fetch_add_explicit(&capture->written, 1, memory_order_relaxed);
+}
+
+static void* capture_thread(void* args) {
+  capture_t* capture = (capture_t*)args;
+
+  thread_event_register(&capture->event);
+  while (true) {
+    uint64_t head = atomic_load_explicit(&capture->head, memory_order_relaxed);
+    while (head == atomic_load_explicit(&capture->tail, memory_order_acquire) && !capture->stopping) {
+      thread_event_wait(&capture->event);
+    }
+    if (head == atomic_load_explicit(&capture->tail, memory_order_acquire)) {
+      break;
+    }
+    // the emulator never waits on this lock while a frame is converted or written
+    thread_event_finish(&capture->event);
+
+    capture_write_frame(capture, &capture->slots[head % CAPTURE_QUEUE_FRAMES]);
+    atomic_store_explicit(&capture->head, head + 1, memory_order_release);
+
+    thread_event_register(&capture->event);
+  }
+  thread_event_finish(&capture->event);
+  capture_flush(capture);
+  return NULL;
+}
+
+bool capture_start(capture_t* capture, const char* path, capture_format_t format, const pixel_color_t shades[SHADE_COUNT]) {
+  capture->owns_file = strcmp(path, "-") != 0;
+  capture->file = capture->owns_file ? fopen(path, "wb") : stdout;
+  if (capture->file == NULL) {
+    return false;
+  }
+  // writes are already batched in `buffer`, a second copy through stdio would only cost time
+  setvbuf(capture->file, NULL, _IONBF, 0);
+
+  capture->format = format;
+  capture->lut = yuv_lut_create(shades);
+  capture->cgb_lut.cgb = false;
+  capture->event = thread_event_create();
+  capture->stopping = false;
+  atomic_init(&capture->closed, false);
+  atomic_init(&capture->head, 0);
+  atomic_init(&capture->tail, 0);
+  atomic_init(&capture->submitted, 0);
+  atomic_init(&capture->written, 0);
+  atomic_init(&capture->dropped, 0);
+  atomic_init(&capture->bytes, 0);
+  capture->buffered = 0;
+
+  if (format == CAPTURE_FORMAT_Y4M) {
+    capture->buffered = snprintf((char*)capture->buffer, CAPTURE_BUFFER_BYTES, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", SCREEN_WIDTH,
+                                 SCREEN_HEIGHT, CAPTURE_RATE_NUMERATOR, CAPTURE_RATE_DENOMINATOR);
+  }
+
+  if (pthread_create(&capture->thread, NULL, capture_thread, capture) != 0) {
+    if (capture->owns_file) {
+      fclose(capture->file);
+    }
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Called by whoever publishes frames. Costs a copy of the shades, never waits
+ * on the disk.
+ */
+void capture_submit(capture_t* capture, const frame_t* frame) {
+  atomic_fetch_add_explicit(&capture->submitted, 1, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&capture->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit(&capture->head, memory_order_acquire);
+  if (tail - head >= CAPTURE_QUEUE_FRAMES || atomic_load_explicit(&capture->closed, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&capture->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  capture_slot_t* slot = &capture->slots[tail % CAPTURE_QUEUE_FRAMES];
+  slot->number = frame->number;
+  memcpy(slot->pixels, frame->pixels, sizeof(slot->pixels));
+  slot->cgb = frame->cgb;
+  if (frame->cgb) {
+    memcpy(slot->colors, frame->colors, sizeof(slot->colors));
+  }
+  atomic_store_explicit(&capture->tail, tail + 1, memory_order_release);
+
+  thread_event_register(&capture->event);
+  thread_event_trigger(&capture->event);
+  thread_event_finish(&capture->event);
+}
+
+capture_stats_t capture_stats(capture_t* capture) {
+  return (capture_stats_t){
+      .submitted = atomic_load_explicit(&capture->submitted, memory_order_relaxed),
+      .written = atomic_load_explicit(&capture->written, memory_order_relaxed),
+      .dropped = atomic_load_explicit(&capture->dropped, memory_order_relaxed),
+      .bytes = atomic_load_explicit(&capture->bytes, memory_order_relaxed),
+  };
+}
+
+void capture_stop(capture_t* capture) {
+  thread_event_register(&capture->event);
+  capture->stopping = true;
+  thread_event_trigger(&capture->event);
+  thread_event_finish(&capture->event);
+  pthread_join(capture->thread, NULL);
+  atomic_store_explicit(&capture->closed, true, memory_order_relaxed);
+
+  fflush(capture->file);
+  if (capture->owns_file) {
+    fclose(capture->file);
+  }
+  capture->file = NULL;
+}
@@ -0,0 +1,87 @@
+#ifndef CAPTURE_CAPTURE_H
+#define CAPTURE_CAPTURE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../events/thread_events.h"
+#include "../events/triple_buffer.h"
+#include "yuv.h"
+
+/*
+ * Streams finished frames to a file or pipe as uncompressed video for an
+ * external encoder to pick up.
+ *
+ * The emulator side only copies the frame into a queue slot, converting and
+ * writing happen on the capture's own thread, through a large buffer so the
+ * disk sees few big writes. When the queue is full, because the disk cannot
+ * keep up, the frame is dropped and counted rather than waited for.
+ */
+
+#define CAPTURE_QUEUE_FRAMES 16
+#define CAPTURE_BUFFER_BYTES (1 << 20)
+// the DMG frame rate, 4194304 Hz / 70224 dots per frame
+#define CAPTURE_RATE_NUMERATOR 4194304
+#define CAPTURE_RATE_DENOMINATOR 70224
+
+typedef enum {
+  // YUV4MPEG2, 4:2:0 full range
+  CAPTURE_FORMAT_Y4M,
+  // packed 24-bit RGB frames back to back, no header
+  CAPTURE_FORMAT_RGB24,
+} capture_format_t;
+
+typedef struct {
+  uint64_t submitted;
+  uint64_t written;
+  uint64_t dropped;
+  uint64_t bytes;
+} capture_stats_t;
+
+typedef struct {
+  uint64_t number;
+  pixel_shade_t pixels[SCREEN_SIZE];
+  bool cgb;
+  uint16_t colors[CGB_COLOR_COUNT];
+} capture_slot_t;
+
+typedef struct {
+  FILE* file;
+  bool owns_file;
+  capture_format_t format;
+  yuv_lut_t lut;
+  // only the capture thread touches these, rebuilt when a CGB frame brings new palettes
+  yuv_lut_t cgb_lut;
+  uint16_t cgb_colors[CGB_COLOR_COUNT];
+  pthread_t thread;
+  thread_event_t event;
+  bool stopping;
+  // once a write fails or the capture is stopped, every frame after that is dropped
+  atomic_bool closed;
+
+  // single producer, single consumer: the emulator advances `tail`, the capture thread `head`
+  _Atomic uint64_t head;
+  _Atomic uint64_t tail;
+  capture_slot_t slots[CAPTURE_QUEUE_FRAMES];
+
+  _Atomic uint64_t submitted;
+  _Atomic uint64_t written;
+  _Atomic uint64_t dropped;
+  _Atomic uint64_t bytes;
+
+  size_t buffered;
+  uint8_t buffer[CAPTURE_BUFFER_BYTES];
+} capture_t;
+
+/*
+ * `path` "-" is standard output
+ */
+bool capture_start(capture_t* capture, const char* path, capture_format_t format, const pixel_color_t shades[SHADE_COUNT]);
+void capture_submit(capture_t* capture, const frame_t* frame);
+capture_stats_t capture_stats(capture_t* capture);
+// writes out whatever is still queued
+void capture_stop(capture_t* capture);
+
+#endif // !DEBUG
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "capture.h"
+
+/*
+ * Reports what converting a frame costs in each format, and what submitting
+ * costs the emulator thread while the capture thread writes to /dev/null.
+ * The burst submits far faster than 59.7 Hz so the queue fills up and frames
+ * get dropped, the paced run submits at the DMG frame rate and should drop
+ * none.
+ */
+
+#define BENCH_FRAMES 2000
+#define BENCH_REPEATS 5
+#define BENCH_PACED_FRAMES 120
+#define BENCH_SINK "/dev/null"
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_convert(const yuv_lut_t* lut, const pixel_shade_t* screen, uint8_t* dest, capture_format_t format) {
+  double best = 0;
+  for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+    double start = bench_now_ns();
+    for (int i = 0; i < BENCH_FRAMES; ++i) {
+      if (format == CAPTURE_FORMAT_Y4M) {
+        yuv_convert_i420(lut, screen, dest);
+      } else {
+        yuv_convert_rgb24(lut, screen, dest);
+      }
+    }
+    double ns = (bench_now_ns() - start) / BENCH_FRAMES;
+    if (repeat == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+static void bench_submit(capture_t* capture, frame_t* frame, capture_format_t format, const char* name, int frames, bool paced) {
+  if (!capture_start(capture, BENCH_SINK, format, DISPLAY_DMG_SHADES)) {
+    printf("could not open %s\n", BENCH_SINK);
+    return;
+  }
+  double total = 0, max = 0;
+  struct timespec interval = {0, 1000000000LL * CAPTURE_RATE_DENOMINATOR / CAPTURE_RATE_NUMERATOR};
+  for (int i = 0; i < frames; ++i) {
+    if (paced) {
+      nanosleep(&interval, NULL);
+    }
+    frame->number = i;
+    double start = bench_now_ns();
+    capture_submit(capture, frame);
+    double ns = bench_now_ns() - start;
+    total += ns;
+    if (ns > max) {
+      max = ns;
+    }
+  }
+  capture_stop(capture);
+  capture_stats_t stats = capture_stats(capture);
+  printf("%-6s %-5s submit avg %7.0f ns  max %8.0f ns  written %5lu  dropped %5lu  %6.1f MiB\n", name, paced ? "paced" : "burst", total / frames, max, (unsigned long)stats.written,
+         (unsigned long)stats.dropped, stats.bytes / 1048576.0);
+}
+
+int main(void) {
+  capture_t* capture = malloc(sizeof(capture_t));
+  frame_t* frame = malloc(sizeof(frame_t));
+  uint8_t* dest = malloc(RGB_FRAME_BYTES);
+  if (capture == NULL || frame == NULL || dest == NULL) {
+    return 1;
+  }
+  uint32_t seed = 1;
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    seed = seed * 1103515245 + 12345;
+    frame->pixels[i] = (seed >> 16) % SHADE_COUNT;
+  }
+  yuv_lut_t lut = yuv_lut_create(DISPLAY_DMG_SHADES);
+
+  printf("convert i420   %.3f ms/frame\n", bench_convert(&lut, frame->pixels, dest, CAPTURE_FORMAT_Y4M) / 1e6);
+  printf("convert rgb24  %.3f ms/frame\n\n", bench_convert(&lut, frame->pixels, dest, CAPTURE_FORMAT_RGB24) / 1e6);
+  bench_submit(capture, frame, CAPTURE_FORMAT_Y4M, "y4m", BENCH_FRAMES, false);
+  bench_submit(capture, frame, CAPTURE_FORMAT_RGB24, "rgb24", BENCH_FRAMES, false);
+  bench_submit(capture, frame, CAPTURE_FORMAT_Y4M, "y4m", BENCH_PACED_FRAMES, true);
+  bench_submit(capture, frame, CAPTURE_FORMAT_RGB24, "rgb24", BENCH_PACED_FRAMES, true);
+
+  free(dest);
+  free(frame);
+  free(capture);
+  return 0;
+}
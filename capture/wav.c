@@ -0,0 +1,266 @@
+#include <sched.h>
+#include <string.h>
+
+#include "wav.h"
+
+#define WAV_PATH_BYTES 4096
+
+static void put_le16(uint8_t* dest, uint16_t value) {
+  dest[0] = value;
+  dest[1] = value >> 8;
+}
+
+static void put_le32(uint8_t* dest, uint32_t value) {
+  put_le16(dest, value);
+  put_le16(dest + 2, value >> 16);
+}
+
+/*
+ * Canonical 44 byte PCM header. Sizes are 0 until the capture stops and
+ * knows them.
+ */
+static void wav_write_header(wav_file_t* file, uint32_t sample_rate) {
+  uint8_t header[WAV_HEADER_BYTES];
+  uint16_t block = file->channels * sizeof(int16_t);
+  uint32_t data_bytes = file->data_bytes > UINT32_MAX - 36 ? UINT32_MAX - 36 : file->data_bytes;
+  memcpy(header, "RIFF", 4);
+  put_le32(header + 4, 36 + data_bytes);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  put_le32(header + 16, 16);
+  // PCM
+  put_le16(header + 20, 1);
+  put_le16(header + 22, file->channels);
+  put_le32(header + 24, sample_rate);
+  put_le32(header + 28, sample_rate * block);
+  put_le16(header + 32, block);
+  put_le16(header + 34, 16);
+  memcpy(header + 36, "data", 4);
+  put_le32(header + 40, data_bytes);
+  fwrite(header, 1, sizeof(header), file->file);
+}
+
+static bool wav_file_open(wav_file_t* file, const char* path, uint16_t channels, uint32_t sample_rate) {
+  file->file = fopen(path, "wb");
+  if (file->file == NULL) {
+    return false;
+  }
+  // writes are already batched in `buffer`
+  setvbuf(file->file, NULL, _IONBF, 0);
+  file->channels = channels;
+  file->data_bytes = 0;
+  file->buffered = 0;
+  wav_write_header(file, sample_rate);
+  return true;
+}
+
+static void wav_file_flush(wav_capture_t* wav, wav_file_t* file) {
+  if (file->buffered == 0) {
+    return;
+  }
+  if (!atomic_load_explicit(&wav->closed, memory_order_relaxed)) {
+    if (fwrite(file->buffer, 1, file->buffered, file->file) == file->buffered) {
+      file->data_bytes += file->buffered;
+      atomic_fetch_add_explicit(&wav->bytes, file->buffered, memory_order_relaxed);
+    } else {
+      atomic_store_explicit(&wav->closed, true, memory_order_relaxed);
+    }
+  }
+  file->buffered = 0;
+}
+
+static void wav_file_append(wav_capture_t* wav, wav_file_t* file, const int16_t* samples, size_t count) {
+  size_t bytes = count * sizeof(int16_t);
+  if (file->buffered + bytes > WAV_BUFFER_BYTES) {
+    wav_file_flush(wav, file);
+  }
+  // WAV is little endian, like every host this runs on
+  memcpy(&file->buffer[file->buffered], samples, bytes);
+  file->buffered += bytes;
+}
+
+static void wav_file_close(wav_capture_t* wav, wav_file_t* file) {
+  if (file->file == NULL) {
+    return;
+  }
+  wav_file_flush(wav, file);
+  if (fseek(file->file, 0, SEEK_SET) == 0) {
+    wav_write_header(file, wav->sample_rate);
+  }
+  fclose(file->file);
+  file->file = NULL;
+}
+
+static void wav_write_frame(wav_capture_t* wav, const wav_slot_t* slot) {
+  if (atomic_load_explicit(&wav->closed, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&wav->dropped, slot->last, memory_order_relaxed);
+    return;
+  }
+  wav_file_append(wav, &wav->mix, slot->mix, slot->frames * 2);
+  for (int i = 0; wav->split_channels && i < WAV_CHANNEL_COUNT; ++i) {
+    wav_file_append(wav, &wav->channels[i], slot->channels[i], slot->frames);
+  }
+  if (!slot->last) {
+    return;
+  }
+  if (wav->hashes != NULL) {
+    fprintf(wav->hashes, "%llu %016llx\n", (unsigned long long)slot->number, (unsigned long long)slot->hash);
+  }
+  atomic_fetch_add_explicit(&wav->written, 1, memory_order_relaxed);
+}
+
+static void* wav_thread(void* args) {
+  wav_capture_t* wav = (wav_capture_t*)args;
+
+  thread_event_register(&wav->event);
+  while (true) {
+    uint64_t head = atomic_load_explicit(&wav->head, memory_order_relaxed);
+    while (head == atomic_load_explicit(&wav->tail, memory_order_acquire) && !wav->stopping) {
+      thread_event_wait(&wav->event);
+    }
+    if (head == atomic_load_explicit(&wav->tail, memory_order_acquire)) {
+      break;
+    }
+    thread_event_finish(&wav->event);
+
+    wav_write_frame(wav, &wav->slots[head % WAV_QUEUE_FRAMES]);
+    atomic_store_explicit(&wav->head, head + 1, memory_order_release);
+
+    thread_event_register(&wav->event);
+  }
+  thread_event_finish(&wav->event);
+  return NULL;
+}
+
+// "out/run.wav", 2 -> "out/run.ch2.wav"
+static void channel_path(char* dest, const char* path, int channel) {
+  const char* slash = strrchr(path, '/');
+  const char* dot = strrchr(path, '.');
+  size_t stem = dot != NULL && (slash == NULL || dot > slash) ? (size_t)(dot - path) : strlen(path);
+  snprintf(dest, WAV_PATH_BYTES, "%.*s.ch%d%s", (int)stem, path, channel, path + stem);
+}
+
+static void wav_close_files(wav_capture_t* wav) {
+  wav_file_close(wav, &wav->mix);
+  for (int i = 0; i < WAV_CHANNEL_COUNT; ++i) {
+    wav_file_close(wav, &wav->channels[i]);
+  }
+  if (wav->hashes != NULL) {
+    fclose(wav->hashes);
+    wav->hashes = NULL;
+  }
+}
+
+bool wav_capture_start(wav_capture_t* wav, const char* path, uint32_t sample_rate, bool split_channels, const char* hash_path) {
+  wav->sample_rate = sample_rate;
+  wav->split_channels = split_channels;
+  wav->mix.file = NULL;
+  wav->hashes = NULL;
+  for (int i = 0; i < WAV_CHANNEL_COUNT; ++i) {
+    wav->channels[i].file = NULL;
+  }
+  atomic_init(&wav->closed, false);
+
+  bool opened = wav_file_open(&wav->mix, path, 2, sample_rate);
+  for (int i = 0; opened && split_channels && i < WAV_CHANNEL_COUNT; ++i) {
+    char name[WAV_PATH_BYTES];
+    channel_path(name, path, i + 1);
+    opened = wav_file_open(&wav->channels[i], name, 1, sample_rate);
+  }
+  if (opened && hash_path != NULL) {
+    wav->hashes = fopen(hash_path, "w");
+    opened = wav->hashes != NULL;
+  }
+  if (!opened) {
+    wav_close_files(wav);
+    return false;
+  }
+
+  wav->event = thread_event_create();
+  wav->stopping = false;
+  atomic_init(&wav->head, 0);
+  atomic_init(&wav->tail, 0);
+  atomic_init(&wav->submitted, 0);
+  atomic_init(&wav->written, 0);
+  atomic_init(&wav->dropped, 0);
+  atomic_init(&wav->waits, 0);
+  atomic_init(&wav->bytes, 0);
+
+  if (pthread_create(&wav->thread, NULL, wav_thread, wav) != 0) {
+    wav_close_files(wav);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Called from the emulator thread once per APU frame. Costs a copy of the
+ * samples, and only waits when the writer is a whole queue behind.
+ */
+static void wav_queue_slot(wav_capture_t* wav, uint64_t number, uint64_t hash, const int16_t* mix, const int16_t* const* channels, size_t offset,
+                           size_t frames, bool last) {
+  uint64_t tail = atomic_load_explicit(&wav->tail, memory_order_relaxed);
+  if (tail - atomic_load_explicit(&wav->head, memory_order_acquire) >= WAV_QUEUE_FRAMES) {
+    atomic_fetch_add_explicit(&wav->waits, 1, memory_order_relaxed);
+    // the writer never stops while there is something queued, so this ends once it has written a frame
+    while (tail - atomic_load_explicit(&wav->head, memory_order_acquire) >= WAV_QUEUE_FRAMES) {
+      sched_yield();
+    }
+  }
+  wav_slot_t* slot = &wav->slots[tail % WAV_QUEUE_FRAMES];
+  slot->number = number;
+  slot->hash = hash;
+  slot->frames = frames;
+  slot->last = last;
+  memcpy(slot->mix, &mix[offset * 2], frames * 2 * sizeof(int16_t));
+  for (int i = 0; wav->split_channels && i < WAV_CHANNEL_COUNT; ++i) {
+    if (channels != NULL) {
+      memcpy(slot->channels[i], &channels[i][offset], frames * sizeof(int16_t));
+    } else {
+      memset(slot->channels[i], 0, frames * sizeof(int16_t));
+    }
+  }
+  atomic_store_explicit(&wav->tail, tail + 1, memory_order_release);
+
+  thread_event_register(&wav->event);
+  thread_event_trigger(&wav->event);
+  thread_event_finish(&wav->event);
+}
+
+/*
+ * A frame longer than a slot goes in over as many as it takes, rather than
+ * losing samples its hash still covers
+ */
+void wav_capture_submit(wav_capture_t* wav, uint64_t number, uint64_t hash, const int16_t* mix, const int16_t* const* channels, size_t frames) {
+  atomic_fetch_add_explicit(&wav->submitted, 1, memory_order_relaxed);
+  if (atomic_load_explicit(&wav->closed, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&wav->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  size_t offset = 0;
+  do {
+    size_t count = frames - offset < WAV_SLOT_FRAMES ? frames - offset : WAV_SLOT_FRAMES;
+    wav_queue_slot(wav, number, hash, mix, channels, offset, count, offset + count == frames);
+    offset += count;
+  } while (offset < frames);
+}
+
+wav_stats_t wav_capture_stats(wav_capture_t* wav) {
+  return (wav_stats_t){
+      .submitted = atomic_load_explicit(&wav->submitted, memory_order_relaxed),
+      .written = atomic_load_explicit(&wav->written, memory_order_relaxed),
+      .dropped = atomic_load_explicit(&wav->dropped, memory_order_relaxed),
+      .waits = atomic_load_explicit(&wav->waits, memory_order_relaxed),
+      .bytes = atomic_load_explicit(&wav->bytes, memory_order_relaxed),
+  };
+}
+
+void wav_capture_stop(wav_capture_t* wav) {
+  thread_event_register(&wav->event);
+  wav->stopping = true;
+  thread_event_trigger(&wav->event);
+  thread_event_finish(&wav->event);
+  pthread_join(wav->thread, NULL);
+
+  wav_close_files(wav);
+  atomic_store_explicit(&wav->closed, true, memory_order_relaxed);
+}
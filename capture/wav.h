@@ -0,0 +1,97 @@
+#ifndef CAPTURE_WAV_H
+#define CAPTURE_WAV_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../events/thread_events.h"
+
+/*
+ * Records audio to 16-bit PCM WAV files for regression runs: the stereo mix,
+ * optionally every channel to a mono file of its own, and optionally a line
+ * per frame with its hash.
+ *
+ * Like the video capture, the emulator side only copies the frame into a
+ * queue slot and the writer thread batches the samples into one large buffer
+ * per file. Unlike it, a full queue waits for the writer: a recording with
+ * gaps is no use for comparing runs, and a batch run that outpaces the disk
+ * has no real time to keep up with. The WAV sizes are filled in when the
+ * capture stops.
+ *
+ * The header is stamped with the rate the capture starts at, so the APU has
+ * to stay at it; rate control is left out of it while a capture runs.
+ */
+
+#define WAV_QUEUE_FRAMES 32
+// more than one APU frame's worth at 48 kHz, a longer frame goes in over several slots
+#define WAV_SLOT_FRAMES 1024
+#define WAV_CHANNEL_COUNT 4
+#define WAV_BUFFER_BYTES (1 << 18)
+#define WAV_HEADER_BYTES 44
+
+typedef struct {
+  uint64_t submitted;
+  uint64_t written;
+  // submitted after a write failed or the capture stopped
+  uint64_t dropped;
+  // submits that found the queue full and waited
+  uint64_t waits;
+  uint64_t bytes;
+} wav_stats_t;
+
+typedef struct {
+  uint64_t number;
+  uint64_t hash;
+  size_t frames;
+  // the frame's last slot, the one its hash and counts go with
+  bool last;
+  int16_t mix[WAV_SLOT_FRAMES * 2];
+  int16_t channels[WAV_CHANNEL_COUNT][WAV_SLOT_FRAMES];
+} wav_slot_t;
+
+typedef struct {
+  FILE* file;
+  uint16_t channels;
+  uint64_t data_bytes;
+  size_t buffered;
+  _Alignas(64) uint8_t buffer[WAV_BUFFER_BYTES];
+} wav_file_t;
+
+typedef struct {
+  uint32_t sample_rate;
+  bool split_channels;
+  wav_file_t mix;
+  wav_file_t channels[WAV_CHANNEL_COUNT];
+  FILE* hashes;
+
+  pthread_t thread;
+  thread_event_t event;
+  bool stopping;
+  atomic_bool closed;
+
+  // single producer, single consumer: the emulator advances `tail`, the writer thread `head`
+  _Atomic uint64_t head;
+  _Atomic uint64_t tail;
+  wav_slot_t slots[WAV_QUEUE_FRAMES];
+
+  _Atomic uint64_t submitted;
+  _Atomic uint64_t written;
+  _Atomic uint64_t dropped;
+  _Atomic uint64_t waits;
+  _Atomic uint64_t bytes;
+} wav_capture_t;
+
+/*
+ * Channel files go next to `path`, named after it with .ch1 - .ch4 before the
+ * extension. `hash_path` may be NULL.
+ */
+bool wav_capture_start(wav_capture_t* wav, const char* path, uint32_t sample_rate, bool split_channels, const char* hash_path);
+// `channels` may be NULL when the capture does not split them
+void wav_capture_submit(wav_capture_t* wav, uint64_t number, uint64_t hash, const int16_t* mix, const int16_t* const* channels, size_t frames);
+wav_stats_t wav_capture_stats(wav_capture_t* wav);
+// writes out whatever is still queued and finishes the headers
+void wav_capture_stop(wav_capture_t* wav);
+
+#endif // !DEBUG
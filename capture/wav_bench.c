@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../emulator/apu.h"
+#include "../hash.h"
+#include "wav.h"
+
+/*
+ * Reports what recording audio costs the emulator thread: the time per
+ * submit, and a batch run of APU frames with and without a recording,
+ * mix only and split per channel, written to /dev/null. The recording should
+ * add no more than the submits' copies to the batch.
+ */
+
+#define BENCH_FRAMES 3600
+#define BENCH_REPEATS 3
+#define BENCH_SINK "/dev/null"
+
+static int16_t mix[BLIP_CAPACITY];
+static int16_t channel_samples[APU_CHANNEL_COUNT][BLIP_CAPACITY / 2];
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_tune(apu_t* apu, blip_t* channel_outputs) {
+  apu_init(apu, APU_SAMPLE_RATE);
+  if (channel_outputs != NULL) {
+    apu_set_channel_outputs(apu, channel_outputs);
+  }
+  apu_write(apu, NR52, NR52_POWER);
+  apu_write(apu, NR50, 0x77);
+  apu_write(apu, NR51, 0xFF);
+  apu_write(apu, NR12, 0xF3);
+  apu_write(apu, NR22, 0xA7);
+  apu_write(apu, NR42, 0xC2);
+  apu_write(apu, NR43, 0x55);
+}
+
+/*
+ * BENCH_FRAMES frames of two squares and noise, each read, hashed and, with
+ * a recording, submitted; returns ns per frame and the slowest submit
+ */
+static double bench_batch(apu_t* apu, wav_capture_t* wav, blip_t* channel_outputs, double* max_submit) {
+  bench_tune(apu, channel_outputs);
+  const int16_t* channels[APU_CHANNEL_COUNT];
+  for (int i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    channels[i] = channel_samples[i];
+  }
+  *max_submit = 0;
+  double start = bench_now_ns();
+  for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+    apu_write(apu, NR13, 0x40 + frame % 64);
+    apu_write(apu, NR14, NRX4_TRIGGER | 0x06);
+    apu_write(apu, NR23, 0x80 + frame % 32);
+    apu_write(apu, NR24, NRX4_TRIGGER | 0x05);
+    apu_write(apu, NR44, NRX4_TRIGGER);
+    apu->clock += APU_FRAME_DOTS;
+    apu_end_frame(apu);
+    size_t frames = apu_read_samples(apu, mix, BLIP_CAPACITY / 2);
+    uint64_t hash = hash64(mix, frames * 2 * sizeof(int16_t));
+    for (uint8_t i = 0; channel_outputs != NULL && i < APU_CHANNEL_COUNT; ++i) {
+      apu_read_channel_samples(apu, i, channel_samples[i], frames);
+    }
+    if (wav != NULL) {
+      double submit = bench_now_ns();
+      wav_capture_submit(wav, frame, hash, mix, channel_outputs != NULL ? channels : NULL, frames);
+      submit = bench_now_ns() - submit;
+      *max_submit = submit > *max_submit ? submit : *max_submit;
+    }
+  }
+  return (bench_now_ns() - start) / BENCH_FRAMES;
+}
+
+int main(void) {
+  apu_t* apu = malloc(sizeof(apu_t));
+  blip_t* channel_outputs = malloc(sizeof(blip_t) * APU_CHANNEL_COUNT);
+  wav_capture_t* wav = aligned_alloc(64, sizeof(wav_capture_t));
+  if (apu == NULL || channel_outputs == NULL || wav == NULL) {
+    return 1;
+  }
+
+  printf("%-16s %12s %14s %9s %9s %8s\n", "batch", "us/frame", "max submit us", "written", "waits", "MiB");
+  for (int mode = 0; mode < 3; ++mode) {
+    const char* names[] = {"no recording", "mix", "mix + channels"};
+    double best = 0, max_submit = 0;
+    wav_stats_t stats = {0};
+    for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+      blip_t* outputs = mode == 2 ? channel_outputs : NULL;
+      if (mode > 0 && !wav_capture_start(wav, BENCH_SINK, APU_SAMPLE_RATE, mode == 2, NULL)) {
+        printf("could not open %s\n", BENCH_SINK);
+        return 1;
+      }
+      double slowest;
+      double ns = bench_batch(apu, mode > 0 ? wav : NULL, outputs, &slowest);
+      if (mode > 0) {
+        wav_capture_stop(wav);
+        stats = wav_capture_stats(wav);
+      }
+      if (repeat == 0 || ns < best) {
+        best = ns;
+        max_submit = slowest;
+      }
+    }
+    printf("%-16s %12.2f %14.2f %9lu %9lu %8.1f\n", names[mode], best / 1e3, max_submit / 1e3, (unsigned long)stats.written, (unsigned long)stats.waits,
+           stats.bytes / 1048576.0);
+  }
+
+  free(wav);
+  free(channel_outputs);
+  free(apu);
+  return 0;
+}
@@ -0,0 +1,109 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "yuv.h"
+
+static uint8_t clamp_byte(double value) {
+  if (value < 0) {
+    return 0;
+  }
+  if (value > 255) {
+    return 255;
+  }
+  return (uint8_t)(value + 0.5);
+}
+
+static void lut_set(yuv_lut_t* lut, uint8_t index, pixel_color_t color) {
+  double r = color.r, g = color.g, b = color.b;
+  lut->y[index] = clamp_byte(0.299 * r + 0.587 * g + 0.114 * b);
+  lut->u[index] = clamp_byte(128 - 0.168736 * r - 0.331264 * g + 0.5 * b);
+  lut->v[index] = clamp_byte(128 + 0.5 * r - 0.418688 * g - 0.081312 * b);
+  lut->rgb[index] = color;
+}
+
+yuv_lut_t yuv_lut_create(const pixel_color_t shades[SHADE_COUNT]) {
+  yuv_lut_t lut = {.cgb = false};
+  for (uint8_t index = 0; index < CGB_COLOR_COUNT; ++index) {
+    lut_set(&lut, index, shades[index % SHADE_COUNT]);
+  }
+  return lut;
+}
+
+void yuv_lut_set_cgb(yuv_lut_t* lut, const uint16_t colors[CGB_COLOR_COUNT]) {
+  lut->cgb = true;
+  for (uint8_t index = 0; index < CGB_COLOR_COUNT; ++index) {
+    lut_set(lut, index, display_cgb_color(colors[index]));
+  }
+}
+
+#if defined(__SSE2__)
+// the table entry of each of 16 shades, picked with one compare mask per shade
+static inline __m128i lookup_epi8(__m128i shades, const uint8_t table[SHADE_COUNT]) {
+  shades = _mm_and_si128(shades, _mm_set1_epi8(SHADE_COUNT - 1));
+  __m128i result = _mm_setzero_si128();
+  for (uint8_t shade = 0; shade < SHADE_COUNT; ++shade) {
+    __m128i mask = _mm_cmpeq_epi8(shades, _mm_set1_epi8(shade));
+    result = _mm_or_si128(result, _mm_and_si128(mask, _mm_set1_epi8(table[shade])));
+  }
+  return result;
+}
+
+// rounded mean of each 2x2 block of two rows of 16, as 8 bytes in the low half
+static inline __m128i average_2x2_epi8(__m128i top, __m128i bottom) {
+  __m128i low = _mm_set1_epi16(0x00FF);
+  __m128i sum = _mm_add_epi16(_mm_and_si128(top, low), _mm_srli_epi16(top, 8));
+  sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(bottom, low), _mm_srli_epi16(bottom, 8)));
+  sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+  return _mm_packus_epi16(sum, sum);
+}
+#endif
+
+static void convert_luma(const yuv_lut_t* lut, const pixel_shade_t* screen, uint8_t* dest) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; !lut->cgb && i + 16 <= SCREEN_SIZE; i += 16) {
+    __m128i shades = _mm_loadu_si128((const __m128i*)&screen[i]);
+    _mm_storeu_si128((__m128i*)&dest[i], lookup_epi8(shades, lut->y));
+  }
+#endif
+  for (; i < SCREEN_SIZE; ++i) {
+    dest[i] = lut->y[screen[i] & (CGB_COLOR_COUNT - 1)];
+  }
+}
+
+static void convert_chroma(const uint8_t table[CGB_COLOR_COUNT], bool cgb, const pixel_shade_t* screen, uint8_t* dest) {
+  for (size_t y = 0; y < YUV_CHROMA_HEIGHT; ++y) {
+    const pixel_shade_t* top = &screen[y * 2 * SCREEN_WIDTH];
+    const pixel_shade_t* bottom = top + SCREEN_WIDTH;
+    uint8_t* out = &dest[y * YUV_CHROMA_WIDTH];
+    size_t x = 0;
+#if defined(__SSE2__)
+    for (; !cgb && x + 16 <= SCREEN_WIDTH; x += 16) {
+      __m128i t = lookup_epi8(_mm_loadu_si128((const __m128i*)&top[x]), table);
+      __m128i b = lookup_epi8(_mm_loadu_si128((const __m128i*)&bottom[x]), table);
+      _mm_storel_epi64((__m128i*)&out[x / 2], average_2x2_epi8(t, b));
+    }
+#endif
+    for (; x < SCREEN_WIDTH; x += 2) {
+      uint16_t sum = table[top[x] & (CGB_COLOR_COUNT - 1)] + table[top[x + 1] & (CGB_COLOR_COUNT - 1)];
+      sum += table[bottom[x] & (CGB_COLOR_COUNT - 1)] + table[bottom[x + 1] & (CGB_COLOR_COUNT - 1)];
+      out[x / 2] = (sum + 2) >> 2;
+    }
+  }
+}
+
+void yuv_convert_i420(const yuv_lut_t* lut, const pixel_shade_t screen[SCREEN_SIZE], uint8_t* dest) {
+  convert_luma(lut, screen, dest);
+  convert_chroma(lut->u, lut->cgb, screen, dest + YUV_LUMA_BYTES);
+  convert_chroma(lut->v, lut->cgb, screen, dest + YUV_LUMA_BYTES + YUV_CHROMA_BYTES);
+}
+
+void yuv_convert_rgb24(const yuv_lut_t* lut, const pixel_shade_t screen[SCREEN_SIZE], uint8_t* dest) {
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    pixel_color_t color = lut->rgb[screen[i] & (CGB_COLOR_COUNT - 1)];
+    dest[i * 3 + 0] = color.r;
+    dest[i * 3 + 1] = color.g;
+    dest[i * 3 + 2] = color.b;
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef CAPTURE_YUV_H
+#define CAPTURE_YUV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../display.h"
+
+/*
+ * Frames of shades -> planar 4:2:0 YUV (I420), full range BT.601 as in JFIF.
+ * A DMG frame only ever holds four colors and a CGB one 64, so the table
+ * holds Y, U and V for each of them and converting is a lookup plus averaging
+ * the chroma of every 2x2 block. Only the four shades have a SIMD lookup.
+ */
+
+#define YUV_CHROMA_WIDTH ((SCREEN_WIDTH) / 2)
+#define YUV_CHROMA_HEIGHT ((SCREEN_HEIGHT) / 2)
+#define YUV_LUMA_BYTES (SCREEN_SIZE)
+#define YUV_CHROMA_BYTES ((YUV_CHROMA_WIDTH) * (YUV_CHROMA_HEIGHT))
+#define YUV_FRAME_BYTES ((YUV_LUMA_BYTES) + 2 * (YUV_CHROMA_BYTES))
+#define RGB_FRAME_BYTES ((SCREEN_SIZE) * 3)
+
+typedef struct {
+  // filled from CGB palettes, so more than the first four entries are in use
+  bool cgb;
+  uint8_t y[CGB_COLOR_COUNT];
+  uint8_t u[CGB_COLOR_COUNT];
+  uint8_t v[CGB_COLOR_COUNT];
+  pixel_color_t rgb[CGB_COLOR_COUNT];
+} yuv_lut_t;
+
+yuv_lut_t yuv_lut_create(const pixel_color_t shades[SHADE_COUNT]);
+void yuv_lut_set_cgb(yuv_lut_t* lut, const uint16_t colors[CGB_COLOR_COUNT]);
+
+/*
+ * Writes the Y plane, then U, then V, YUV_FRAME_BYTES in all
+ */
+void yuv_convert_i420(const yuv_lut_t* lut, const pixel_shade_t screen[SCREEN_SIZE], uint8_t* dest);
+
+/*
+ * Writes packed 24-bit RGB, RGB_FRAME_BYTES in all
+ */
+void yuv_convert_rgb24(const yuv_lut_t* lut, const pixel_shade_t screen[SCREEN_SIZE], uint8_t* dest);
+
+#endif // !DEBUG
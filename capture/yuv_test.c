@@ -0,0 +1,77 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "yuv.h"
+
+static pixel_shade_t screen[SCREEN_SIZE];
+// big enough for either format
+static uint8_t dest[RGB_FRAME_BYTES];
+
+Test(yuv, greys_have_neutral_chroma) {
+  const pixel_color_t shades[SHADE_COUNT] = {{255, 255, 255}, {170, 170, 170}, {85, 85, 85}, {0, 0, 0}};
+  yuv_lut_t lut = yuv_lut_create(shades);
+
+  cr_assert(eq(u8, lut.y[0], 255));
+  cr_assert(eq(u8, lut.y[1], 170));
+  cr_assert(eq(u8, lut.y[3], 0));
+  for (uint8_t shade = 0; shade < SHADE_COUNT; ++shade) {
+    cr_assert(eq(u8, lut.u[shade], 128));
+    cr_assert(eq(u8, lut.v[shade], 128));
+  }
+}
+
+// a random screen of the first `colors` entries of `lut`
+static void check_i420(const yuv_lut_t* lut, uint8_t colors) {
+  uint32_t seed = 7;
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    seed = seed * 1103515245 + 12345;
+    screen[i] = (seed >> 16) % colors;
+  }
+
+  yuv_convert_i420(lut, screen, dest);
+
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    cr_assert(eq(u8, dest[i], lut->y[screen[i]]));
+  }
+  const uint8_t* u = dest + YUV_LUMA_BYTES;
+  const uint8_t* v = u + YUV_CHROMA_BYTES;
+  for (size_t y = 0; y < YUV_CHROMA_HEIGHT; ++y) {
+    for (size_t x = 0; x < YUV_CHROMA_WIDTH; ++x) {
+      size_t i = y * 2 * SCREEN_WIDTH + x * 2;
+      size_t j = i + SCREEN_WIDTH;
+      uint16_t u_sum = lut->u[screen[i]] + lut->u[screen[i + 1]] + lut->u[screen[j]] + lut->u[screen[j + 1]];
+      uint16_t v_sum = lut->v[screen[i]] + lut->v[screen[i + 1]] + lut->v[screen[j]] + lut->v[screen[j + 1]];
+      cr_assert(eq(u8, u[y * YUV_CHROMA_WIDTH + x], (u_sum + 2) / 4));
+      cr_assert(eq(u8, v[y * YUV_CHROMA_WIDTH + x], (v_sum + 2) / 4));
+    }
+  }
+}
+
+Test(yuv, i420_matches_per_pixel_conversion) {
+  yuv_lut_t lut = yuv_lut_create(DISPLAY_DMG_SHADES);
+  check_i420(&lut, SHADE_COUNT);
+}
+
+Test(yuv, cgb_palettes_convert_all_colors) {
+  uint16_t colors[CGB_COLOR_COUNT];
+  for (uint8_t i = 0; i < CGB_COLOR_COUNT; ++i) {
+    colors[i] = i * 0x1FF;
+  }
+  yuv_lut_t lut = yuv_lut_create(DISPLAY_DMG_SHADES);
+  yuv_lut_set_cgb(&lut, colors);
+  cr_assert(eq(u8, lut.rgb[CGB_PIXEL_OBJ | 1].r, display_cgb_color(colors[CGB_PIXEL_OBJ | 1]).r));
+  cr_assert(eq(u8, lut.rgb[CGB_COLOR_COUNT - 1].b, display_cgb_color(colors[CGB_COLOR_COUNT - 1]).b));
+  check_i420(&lut, CGB_COLOR_COUNT);
+}
+
+Test(yuv, rgb24_is_packed) {
+  yuv_lut_t lut = yuv_lut_create(DISPLAY_DMG_SHADES);
+  memset(screen, 0, sizeof(screen));
+  screen[1] = 3;
+
+  yuv_convert_rgb24(&lut, screen, dest);
+
+  cr_assert(eq(u8, dest[0], DISPLAY_DMG_SHADES[0].r));
+  cr_assert(eq(u8, dest[3], DISPLAY_DMG_SHADES[3].r));
+  cr_assert(eq(u8, dest[5], DISPLAY_DMG_SHADES[3].b));
+}
@@ -0,0 +1,62 @@
+#include "display.h"
+
+#define DISPLAY_ALPHA_OPAQUE 0xFFu
+
+const pixel_color_t DISPLAY_DMG_SHADES[SHADE_COUNT] = {
+    {0xE0, 0xF8, 0xD0},
+    {0x88, 0xC0, 0x70},
+    {0x34, 0x68, 0x56},
+    {0x08, 0x18, 0x20},
+};
+
+uint32_t display_pack_color(pixel_color_t color, display_format_t format) {
+  switch (format) {
+  case DISPLAY_FORMAT_ARGB8888:
+    return DISPLAY_ALPHA_OPAQUE << 24 | (uint32_t)color.r << 16 | (uint32_t)color.g << 8 | color.b;
+  case DISPLAY_FORMAT_RGBA8888:
+  default:
+    return (uint32_t)color.r << 24 | (uint32_t)color.g << 16 | (uint32_t)color.b << 8 | DISPLAY_ALPHA_OPAQUE;
+  }
+}
+
+/*
+ * 5 bits a channel stretched to 8, so 0x1F comes out as full 0xFF
+ */
+pixel_color_t display_cgb_color(uint16_t color) {
+  uint8_t r = color & 0x1F, g = (color >> 5) & 0x1F, b = (color >> 10) & 0x1F;
+  return (pixel_color_t){
+      .r = r << 3 | r >> 2,
+      .g = g << 3 | g >> 2,
+      .b = b << 3 | b >> 2,
+  };
+}
+
+display_lut_t display_lut_create(const pixel_color_t shades[SHADE_COUNT], display_format_t format) {
+  display_lut_t lut = {
+      .format = format,
+  };
+  for (size_t i = 0; i < CGB_COLOR_COUNT; ++i) {
+    lut.colors[i] = display_pack_color(shades[i % SHADE_COUNT], format);
+  }
+  return lut;
+}
+
+void display_lut_set_cgb(display_lut_t* lut, const uint16_t colors[CGB_COLOR_COUNT]) {
+  for (size_t i = 0; i < CGB_COLOR_COUNT; ++i) {
+    lut->colors[i] = display_pack_color(display_cgb_color(colors[i]), lut->format);
+  }
+}
+
+void display_convert(const display_lut_t* lut, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch) {
+  const uint32_t* colors = lut->colors;
+  uint8_t* row = dest;
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    const pixel_shade_t* src = &screen[y * SCREEN_WIDTH];
+    uint32_t* out = (uint32_t*)row;
+    for (size_t x = 0; x < SCREEN_WIDTH; ++x) {
+      // masking keeps a corrupt frame from reading past the table
+      out[x] = colors[src[x] & (CGB_COLOR_COUNT - 1)];
+    }
+    row += pitch;
+  }
+}
@@ -2,6 +2,7 @@
 #define EMULATOR_DISPLAY_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define DISPLAY_WIDTH 800
@@ -21,10 +22,59 @@ typedef struct {
   uint8_t b;
 } pixel_color_t;
 
+/*
+ * The PPU writes one byte per pixel: the DMG shade (0: lightest .. 3: darkest)
+ * after BGP/OBP0/OBP1 have been applied. A CGB writes where in palette RAM the
+ * color is instead: bits 0-1 the color number, bits 2-4 the palette and bit 5
+ * set for object palettes, with the frame carrying the palettes alongside.
+ * Turning either into host colors is left to whoever actually consumes the
+ * pixels, see display_lut_t.
+ */
+typedef uint8_t pixel_shade_t;
+
+#define SHADE_COUNT 4
+// 8 BG then 8 OBJ palettes of 4 colors, each color 15-bit RGB with red in the low bits
+#define CGB_COLOR_COUNT 64
+#define CGB_PIXEL_OBJ (1 << 5)
+
 typedef struct {
   uint8_t y;
   uint8_t x;
-  pixel_color_t pixels[SCREEN_DATA_SIZE];
+  pixel_shade_t pixels[SCREEN_DATA_SIZE];
 } screen_data_t;
 
+/*
+ * Packed 32-bit host pixel layouts, named after their SDL counterparts.
+ * RGBA8888 keeps red in the most significant byte, ARGB8888 keeps alpha there.
+ */
+typedef enum {
+  DISPLAY_FORMAT_RGBA8888,
+  DISPLAY_FORMAT_ARGB8888,
+} display_format_t;
+
+/*
+ * Pixel -> host pixel lookup table. Built once per palette/format pair and
+ * then used for the single conversion pass over a finished frame. A DMG table
+ * repeats its four shades across every entry, a CGB one is refilled from a
+ * frame's palettes whenever they change.
+ */
+typedef struct {
+  display_format_t format;
+  uint32_t colors[CGB_COLOR_COUNT];
+} display_lut_t;
+
+extern const pixel_color_t DISPLAY_DMG_SHADES[SHADE_COUNT];
+
+display_lut_t display_lut_create(const pixel_color_t shades[SHADE_COUNT], display_format_t format);
+void display_lut_set_cgb(display_lut_t* lut, const uint16_t colors[CGB_COLOR_COUNT]);
+uint32_t display_pack_color(pixel_color_t color, display_format_t format);
+pixel_color_t display_cgb_color(uint16_t color);
+
+/*
+ * Converts a full frame of pixels into packed 32-bit pixels. `pitch` is the
+ * length of a destination row in bytes so that locked texture memory can be
+ * written to directly.
+ */
+void display_convert(const display_lut_t* lut, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch);
+
 #endif // !DEBUG
@@ -0,0 +1,46 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "display.h"
+
+Test(display, lut_packs_formats) {
+  const pixel_color_t shades[SHADE_COUNT] = {{0x11, 0x22, 0x33}, {0}, {0}, {0}};
+
+  display_lut_t rgba = display_lut_create(shades, DISPLAY_FORMAT_RGBA8888);
+  display_lut_t argb = display_lut_create(shades, DISPLAY_FORMAT_ARGB8888);
+
+  cr_assert(eq(u32, rgba.colors[0], 0x112233FF));
+  cr_assert(eq(u32, argb.colors[0], 0xFF112233));
+}
+
+Test(display, convert_respects_pitch) {
+  static pixel_shade_t screen[SCREEN_SIZE];
+  static uint32_t dest[SCREEN_HEIGHT][SCREEN_WIDTH + 8];
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    screen[i] = i % SHADE_COUNT;
+  }
+
+  display_lut_t lut = display_lut_create(DISPLAY_DMG_SHADES, DISPLAY_FORMAT_RGBA8888);
+  display_convert(&lut, screen, dest, sizeof(dest[0]));
+
+  cr_assert(eq(u32, dest[0][0], lut.colors[0]));
+  cr_assert(eq(u32, dest[1][0], lut.colors[SCREEN_WIDTH % SHADE_COUNT]));
+  cr_assert(eq(u32, dest[SCREEN_HEIGHT - 1][SCREEN_WIDTH - 1], lut.colors[(SCREEN_SIZE - 1) % SHADE_COUNT]));
+  cr_assert(eq(u32, dest[0][SCREEN_WIDTH], 0));
+}
+
+Test(display, cgb_colors_fill_the_lut) {
+  uint16_t colors[CGB_COLOR_COUNT] = {0};
+  // white, pure red in BG palette 0, pure blue as color 3 of OBJ palette 7
+  colors[0] = 0x7FFF;
+  colors[1] = 0x001F;
+  colors[CGB_COLOR_COUNT - 1] = 0x7C00;
+
+  display_lut_t lut = display_lut_create(DISPLAY_DMG_SHADES, DISPLAY_FORMAT_RGBA8888);
+  display_lut_set_cgb(&lut, colors);
+
+  cr_assert(eq(u32, lut.colors[0], 0xFFFFFFFF));
+  cr_assert(eq(u32, lut.colors[1], 0xFF0000FF));
+  cr_assert(eq(u32, lut.colors[2], 0x000000FF));
+  cr_assert(eq(u32, lut.colors[CGB_COLOR_COUNT - 1], 0x0000FFFF));
+}
@@ -0,0 +1,476 @@
+#include <string.h>
+
+#include "apu.h"
+
+#define REGISTER(address) (apu->registers[(address) - APU_REGISTERS_START])
+
+enum { CHANNEL_SQUARE1, CHANNEL_SQUARE2, CHANNEL_WAVE, CHANNEL_NOISE };
+
+// one bit per duty step: 12.5%, 25%, 50%, 75%
+static const uint8_t duty_patterns[4] = {0x01, 0x81, 0x87, 0x7E};
+static const uint8_t noise_divisors[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+static const uint16_t length_max[APU_CHANNEL_COUNT] = {64, 64, 256, 64};
+// a tone repeating faster than this, 21.8 kHz, sits above the output filter's cutoff
+#define ULTRASONIC_DOTS 192
+
+/*
+ * What a channel adds to each side follows from its level, NR51 and NR50.
+ * Whenever any of those change the difference goes into the blip buffers.
+ */
+static void channel_output(apu_t* apu, uint8_t index, uint32_t time) {
+  if (apu->shadow) {
+    return;
+  }
+  apu_channel_t* channel = &apu->channels[index];
+  uint8_t level = channel->enabled && channel->dac ? channel->level : 0;
+  uint8_t panning = REGISTER(NR51);
+  uint8_t volume = REGISTER(NR50);
+  int32_t left = panning & (0x10 << index) ? level * (((volume >> 4) & 7) + 1) * APU_VOLUME_SCALE : 0;
+  int32_t right = panning & (0x01 << index) ? level * ((volume & 7) + 1) * APU_VOLUME_SCALE : 0;
+  if (left != channel->left) {
+    blip_add_delta(&apu->left, time, left - channel->left);
+    channel->left = left;
+  }
+  if (right != channel->right) {
+    blip_add_delta(&apu->right, time, right - channel->right);
+    channel->right = right;
+  }
+  // as loud as a channel panned to one side at full master volume
+  int32_t solo = level * 8 * APU_VOLUME_SCALE;
+  if (apu->channel_outputs != NULL && solo != channel->solo) {
+    blip_add_delta(&apu->channel_outputs[index], time, solo - channel->solo);
+    channel->solo = solo;
+  }
+}
+
+static uint8_t wave_sample(const apu_t* apu, uint8_t step) {
+  uint8_t byte = REGISTER(WAVE_RAM_START + step / 2);
+  uint8_t sample = step & 1 ? byte & 0x0F : byte >> 4;
+  uint8_t shift = (REGISTER(NR32) >> 5) & 3;
+  // 0: mute, 1: 100%, 2: 50%, 3: 25%
+  return shift == 0 ? 0 : sample >> (shift - 1);
+}
+
+static uint8_t channel_level(const apu_t* apu, uint8_t index) {
+  const apu_channel_t* channel = &apu->channels[index];
+  switch (index) {
+  case CHANNEL_SQUARE1:
+  case CHANNEL_SQUARE2: {
+    uint8_t duty = REGISTER(index == CHANNEL_SQUARE1 ? NR11 : NR21) >> 6;
+    return (duty_patterns[duty] >> channel->step) & 1 ? channel->volume : 0;
+  }
+  case CHANNEL_WAVE:
+    return wave_sample(apu, channel->step);
+  default:
+    return apu->lfsr & 1 ? 0 : channel->volume;
+  }
+}
+
+static void noise_step(apu_t* apu) {
+  uint16_t bit = (apu->lfsr ^ (apu->lfsr >> 1)) & 1;
+  apu->lfsr = (apu->lfsr >> 1) | (bit << 14);
+  if (REGISTER(NR43) & 0x08) {
+    apu->lfsr = (apu->lfsr & ~0x40) | (bit << 6);
+  }
+}
+
+/*
+ * Steps a channel's timer up to `end`, turning every change of level into an
+ * edge. A channel that is off just has its position moved on, and so does a
+ * square or wave whose tone is too high to survive the band limiting: its
+ * edges would cost the most and all be filtered out again.
+ */
+static void channel_run(apu_t* apu, uint8_t index, uint32_t end) {
+  apu_channel_t* channel = &apu->channels[index];
+  if (channel->next >= end) {
+    return;
+  }
+  uint8_t step_mask = index == CHANNEL_WAVE ? 31 : 7;
+  bool ultrasonic = index != CHANNEL_NOISE && channel->period * (step_mask + 1) < ULTRASONIC_DOTS;
+  if (!channel->enabled || !channel->dac || ultrasonic) {
+    // a trigger resets the LFSR, so a silent noise channel can skip it too
+    uint32_t steps = (end - channel->next + channel->period - 1) / channel->period;
+    channel->step = (channel->step + steps) & step_mask;
+    channel->next += steps * channel->period;
+    return;
+  }
+  while (channel->next < end) {
+    if (index == CHANNEL_NOISE) {
+      noise_step(apu);
+    } else {
+      channel->step = (channel->step + 1) & step_mask;
+    }
+    uint8_t level = channel_level(apu, index);
+    if (level != channel->level) {
+      channel->level = level;
+      channel_output(apu, index, channel->next);
+    }
+    channel->next += channel->period;
+  }
+}
+
+static void channel_disable(apu_t* apu, uint8_t index, uint32_t time) {
+  apu->channels[index].enabled = false;
+  channel_output(apu, index, time);
+}
+
+static uint16_t sweep_next_frequency(apu_t* apu) {
+  uint16_t delta = apu->sweep.shadow >> apu->sweep.shift;
+  return apu->sweep.down ? apu->sweep.shadow - delta : apu->sweep.shadow + delta;
+}
+
+static void square_set_frequency(apu_channel_t* channel, uint16_t frequency) {
+  channel->frequency = frequency;
+  channel->period = (2048 - frequency) * 4;
+}
+
+static void sweep_clock(apu_t* apu) {
+  apu_sweep_t* sweep = &apu->sweep;
+  if (sweep->timer > 0) {
+    sweep->timer -= 1;
+  }
+  if (sweep->timer != 0) {
+    return;
+  }
+  sweep->timer = sweep->period ? sweep->period : 8;
+  if (!sweep->enabled || sweep->period == 0) {
+    return;
+  }
+  uint16_t frequency = sweep_next_frequency(apu);
+  if (frequency > 2047) {
+    channel_disable(apu, CHANNEL_SQUARE1, apu->time);
+    return;
+  }
+  if (sweep->shift != 0) {
+    sweep->shadow = frequency;
+    square_set_frequency(&apu->channels[CHANNEL_SQUARE1], frequency);
+    // the overflow check runs again with the new frequency
+    if (sweep_next_frequency(apu) > 2047) {
+      channel_disable(apu, CHANNEL_SQUARE1, apu->time);
+    }
+  }
+}
+
+static void envelope_clock(apu_t* apu, uint8_t index) {
+  apu_channel_t* channel = &apu->channels[index];
+  if (channel->envelope_period == 0) {
+    return;
+  }
+  channel->envelope_timer -= 1;
+  if (channel->envelope_timer != 0) {
+    return;
+  }
+  channel->envelope_timer = channel->envelope_period;
+  if (channel->envelope_up && channel->volume < 15) {
+    channel->volume += 1;
+  } else if (!channel->envelope_up && channel->volume > 0) {
+    channel->volume -= 1;
+  } else {
+    return;
+  }
+  channel->level = channel_level(apu, index);
+  channel_output(apu, index, apu->time);
+}
+
+/*
+ * Steps 0, 2, 4, 6 clock the length counters, 2 and 6 the sweep and 7 the
+ * envelopes
+ */
+static void sequencer_clock(apu_t* apu) {
+  uint8_t step = apu->sequencer_step;
+  if ((step & 1) == 0) {
+    for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+      apu_channel_t* channel = &apu->channels[i];
+      if (channel->length_enabled && channel->length > 0) {
+        channel->length -= 1;
+        if (channel->length == 0) {
+          channel_disable(apu, i, apu->time);
+        }
+      }
+    }
+  }
+  if (step == 2 || step == 6) {
+    sweep_clock(apu);
+  }
+  if (step == 7) {
+    envelope_clock(apu, CHANNEL_SQUARE1);
+    envelope_clock(apu, CHANNEL_SQUARE2);
+    envelope_clock(apu, CHANNEL_NOISE);
+  }
+  apu->sequencer_step = (step + 1) & 7;
+}
+
+/*
+ * Brings every channel up to `until`, a stretch between two frame sequencer
+ * steps at a time. A shadow only needs the frame sequencer.
+ */
+static void apu_run(apu_t* apu, uint32_t until) {
+  while (apu->time < until) {
+    uint32_t end = until < apu->sequencer_next ? until : apu->sequencer_next;
+    for (uint8_t i = 0; !apu->shadow && i < APU_CHANNEL_COUNT; ++i) {
+      channel_run(apu, i, end);
+    }
+    apu->time = end;
+    if (end == apu->sequencer_next) {
+      if (REGISTER(NR52) & NR52_POWER) {
+        sequencer_clock(apu);
+      }
+      apu->sequencer_next += APU_SEQUENCER_DOTS;
+    }
+  }
+}
+
+static void channel_trigger(apu_t* apu, uint8_t index) {
+  apu_channel_t* channel = &apu->channels[index];
+  channel->enabled = channel->dac;
+  if (channel->length == 0) {
+    channel->length = length_max[index];
+  }
+  channel->next = apu->time + channel->period;
+  if (index == CHANNEL_WAVE) {
+    channel->step = 0;
+  } else {
+    uint8_t envelope = REGISTER(index == CHANNEL_SQUARE1 ? NR12 : index == CHANNEL_SQUARE2 ? NR22 : NR42);
+    channel->volume = envelope >> 4;
+    channel->envelope_up = envelope & 0x08;
+    channel->envelope_period = envelope & 0x07;
+    channel->envelope_timer = channel->envelope_period;
+  }
+  if (index == CHANNEL_NOISE) {
+    apu->lfsr = 0x7FFF;
+  }
+  if (index == CHANNEL_SQUARE1) {
+    apu_sweep_t* sweep = &apu->sweep;
+    sweep->shadow = channel->frequency;
+    sweep->timer = sweep->period ? sweep->period : 8;
+    sweep->enabled = sweep->period != 0 || sweep->shift != 0;
+    if (sweep->shift != 0 && sweep_next_frequency(apu) > 2047) {
+      channel->enabled = false;
+    }
+  }
+  channel->level = channel_level(apu, index);
+  channel_output(apu, index, apu->time);
+}
+
+static void channel_set_dac(apu_t* apu, uint8_t index, bool dac) {
+  apu_channel_t* channel = &apu->channels[index];
+  channel->dac = dac;
+  if (!dac) {
+    channel->enabled = false;
+  }
+  channel_output(apu, index, apu->time);
+}
+
+static void apu_power_off(apu_t* apu) {
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    apu_channel_t* channel = &apu->channels[i];
+    uint32_t next = channel->next;
+    uint32_t period = channel->period;
+    *channel = (apu_channel_t){
+        .next = next,
+        .period = period,
+        .left = channel->left,
+        .right = channel->right,
+        .solo = channel->solo,
+    };
+  }
+  apu->sweep = (apu_sweep_t){0};
+  // everything but wave RAM reads back as 0
+  memset(apu->registers, 0, NR52 - APU_REGISTERS_START);
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    channel_output(apu, i, apu->time);
+  }
+}
+
+bool apu_init(apu_t* apu, uint32_t sample_rate) {
+  memset(apu->registers, 0, sizeof(apu->registers));
+  apu->sweep = (apu_sweep_t){0};
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    apu->channels[i] = (apu_channel_t){0};
+    square_set_frequency(&apu->channels[i], 0);
+  }
+  apu->lfsr = 0x7FFF;
+  apu->sequencer_step = 0;
+  apu->sequencer_next = APU_SEQUENCER_DOTS;
+  apu->clock = 0;
+  apu->time = 0;
+  apu->overruns = 0;
+  apu->channel_outputs = NULL;
+  apu->shadow = false;
+  if (!blip_init(&apu->left, APU_CLOCK_HZ, sample_rate) || !blip_init(&apu->right, APU_CLOCK_HZ, sample_rate)) {
+    return false;
+  }
+  return true;
+}
+
+void apu_write(apu_t* apu, uint16_t address, uint8_t value) {
+  apu_run(apu, apu->clock);
+  bool powered = REGISTER(NR52) & NR52_POWER;
+  if (!powered && address != NR52 && address < WAVE_RAM_START) {
+    return;
+  }
+  uint8_t previous = REGISTER(address);
+  REGISTER(address) = value;
+
+  apu_channel_t* channels = apu->channels;
+  switch (address) {
+  case NR10:
+    apu->sweep.period = (value >> 4) & 7;
+    apu->sweep.down = value & 0x08;
+    apu->sweep.shift = value & 7;
+    break;
+  case NR11:
+  case NR21:
+  case NR41:
+    channels[(address - NR11) / 5].length = 64 - (value & 0x3F);
+    break;
+  case NR31:
+    channels[CHANNEL_WAVE].length = 256 - value;
+    break;
+  case NR12:
+  case NR22:
+  case NR42:
+    channel_set_dac(apu, (address - NR12) / 5, value & 0xF8);
+    break;
+  case NR30:
+    channel_set_dac(apu, CHANNEL_WAVE, value & 0x80);
+    break;
+  case NR13:
+  case NR23:
+    square_set_frequency(&channels[(address - NR13) / 5], (channels[(address - NR13) / 5].frequency & 0x700) | value);
+    break;
+  case NR33:
+    channels[CHANNEL_WAVE].frequency = (channels[CHANNEL_WAVE].frequency & 0x700) | value;
+    channels[CHANNEL_WAVE].period = (2048 - channels[CHANNEL_WAVE].frequency) * 2;
+    break;
+  case NR43:
+    channels[CHANNEL_NOISE].period = noise_divisors[value & 7] << (value >> 4);
+    break;
+  case NR14:
+  case NR24:
+  case NR34:
+  case NR44: {
+    uint8_t index = (address - NR14) / 5;
+    apu_channel_t* channel = &channels[index];
+    if (index == CHANNEL_WAVE) {
+      channel->frequency = (channel->frequency & 0xFF) | (value & 7) << 8;
+      channel->period = (2048 - channel->frequency) * 2;
+    } else if (index != CHANNEL_NOISE) {
+      square_set_frequency(channel, (channel->frequency & 0xFF) | (value & 7) << 8);
+    }
+    channel->length_enabled = value & NRX4_LENGTH_ENABLE;
+    if (value & NRX4_TRIGGER) {
+      channel_trigger(apu, index);
+    }
+    break;
+  }
+  case NR32:
+    channels[CHANNEL_WAVE].level = channel_level(apu, CHANNEL_WAVE);
+    channel_output(apu, CHANNEL_WAVE, apu->time);
+    break;
+  case NR50:
+  case NR51:
+    for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+      channel_output(apu, i, apu->time);
+    }
+    break;
+  case NR52:
+    REGISTER(NR52) = value & NR52_POWER;
+    if ((previous & NR52_POWER) && !(value & NR52_POWER)) {
+      apu_power_off(apu);
+    } else if (!(previous & NR52_POWER) && (value & NR52_POWER)) {
+      apu->sequencer_step = 0;
+    }
+    break;
+  }
+}
+
+uint8_t apu_status(const apu_t* apu) {
+  uint8_t status = (apu->registers[NR52 - APU_REGISTERS_START] & NR52_POWER) | 0x70;
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    if (apu->channels[i].enabled) {
+      status |= 1 << i;
+    }
+  }
+  return status;
+}
+
+void apu_end_frame(apu_t* apu) {
+  apu_run(apu, apu->clock);
+  if (apu->shadow) {
+    apu->sequencer_next -= apu->clock;
+    apu->time = 0;
+    apu->clock = 0;
+    return;
+  }
+  blip_end_frame(&apu->left, apu->clock);
+  blip_end_frame(&apu->right, apu->clock);
+  for (uint8_t i = 0; apu->channel_outputs != NULL && i < APU_CHANNEL_COUNT; ++i) {
+    blip_end_frame(&apu->channel_outputs[i], apu->clock);
+  }
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    apu->channels[i].next -= apu->clock;
+  }
+  apu->sequencer_next -= apu->clock;
+  apu->time = 0;
+  apu->clock = 0;
+
+  // nobody is reading, drop the oldest samples rather than run out of room for the next frame
+  if (blip_clocks_free(&apu->left) < 2 * APU_FRAME_DOTS) {
+    size_t excess = blip_samples_available(&apu->left) / 2;
+    blip_read_samples(&apu->left, NULL, excess, 1);
+    blip_read_samples(&apu->right, NULL, excess, 1);
+    for (uint8_t i = 0; apu->channel_outputs != NULL && i < APU_CHANNEL_COUNT; ++i) {
+      blip_read_samples(&apu->channel_outputs[i], NULL, excess, 1);
+    }
+    apu->overruns += 1;
+  }
+}
+
+void apu_set_sample_rate(apu_t* apu, double sample_rate) {
+  blip_set_rates(&apu->left, APU_CLOCK_HZ, sample_rate);
+  blip_set_rates(&apu->right, APU_CLOCK_HZ, sample_rate);
+  for (uint8_t i = 0; apu->channel_outputs != NULL && i < APU_CHANNEL_COUNT; ++i) {
+    blip_set_rates(&apu->channel_outputs[i], APU_CLOCK_HZ, sample_rate);
+  }
+}
+
+void apu_set_quality(apu_t* apu, blip_quality_t quality) {
+  blip_set_quality(&apu->left, quality);
+  blip_set_quality(&apu->right, quality);
+  for (uint8_t i = 0; apu->channel_outputs != NULL && i < APU_CHANNEL_COUNT; ++i) {
+    blip_set_quality(&apu->channel_outputs[i], quality);
+  }
+}
+
+/*
+ * Set before any sound is made, the channel buffers start out silent and
+ * match the sides' rate and quality
+ */
+bool apu_set_channel_outputs(apu_t* apu, blip_t* outputs) {
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    if (!blip_init(&outputs[i], APU_CLOCK_HZ, APU_SAMPLE_RATE)) {
+      return false;
+    }
+    blip_set_quality(&outputs[i], apu->left.quality);
+    outputs[i].factor = apu->left.factor;
+    apu->channels[i].solo = 0;
+  }
+  apu->channel_outputs = outputs;
+  return true;
+}
+
+size_t apu_samples_available(const apu_t* apu) {
+  //
+  return blip_samples_available(&apu->left);
+}
+
+size_t apu_read_channel_samples(apu_t* apu, uint8_t index, int16_t* out, size_t count) {
+  //
+  return blip_read_samples(&apu->channel_outputs[index], out, count, 1);
+}
+
+size_t apu_read_samples(apu_t* apu, int16_t* out, size_t count) {
+  blip_read_samples(&apu->left, out, count, 2);
+  return blip_read_samples(&apu->right, out == NULL ? NULL : out + 1, count, 2);
+}
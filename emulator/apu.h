@@ -0,0 +1,216 @@
+#ifndef EMULATOR_APU_H
+#define EMULATOR_APU_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../audio/blip.h"
+#include "../events/thread_events.h"
+
+/*
+ * Sound registers
+ *
+ *   NR10 - NR14   channel 1: square with frequency sweep
+ *   NR21 - NR24   channel 2: square
+ *   NR30 - NR34   channel 3: 32 4-bit samples from wave RAM
+ *   NR41 - NR44   channel 4: noise from a 15 (or 7) bit LFSR
+ *   NR50          master volume per side, 0-7
+ *   NR51          which channels go to which side, bits 0-3 right, 4-7 left
+ *   NR52          bit 7 powers the APU, bits 0-3 read back which channels are on
+ */
+#define NR10 0xFF10
+#define NR11 0xFF11
+#define NR12 0xFF12
+#define NR13 0xFF13
+#define NR14 0xFF14
+#define NR21 0xFF16
+#define NR22 0xFF17
+#define NR23 0xFF18
+#define NR24 0xFF19
+#define NR30 0xFF1A
+#define NR31 0xFF1B
+#define NR32 0xFF1C
+#define NR33 0xFF1D
+#define NR34 0xFF1E
+#define NR41 0xFF20
+#define NR42 0xFF21
+#define NR43 0xFF22
+#define NR44 0xFF23
+#define NR50 0xFF24
+#define NR51 0xFF25
+#define NR52 0xFF26
+#define NR52_POWER (1 << 7)
+#define NRX4_TRIGGER (1 << 7)
+#define NRX4_LENGTH_ENABLE (1 << 6)
+#define WAVE_RAM_START 0xFF30
+#define WAVE_RAM_END 0xFF3F
+#define APU_REGISTERS_START NR10
+#define APU_REGISTERS_END WAVE_RAM_END
+#define APU_REGISTER_COUNT ((APU_REGISTERS_END) - (APU_REGISTERS_START) + 1)
+
+#define APU_CHANNEL_COUNT 4
+#define APU_CLOCK_HZ 4194304
+#define APU_SAMPLE_RATE 48000
+// the frame sequencer steps at 512 Hz
+#define APU_SEQUENCER_DOTS 8192
+// the APU closes a blip frame at least this often, whether or not the LCD runs
+#define APU_FRAME_DOTS 70224
+// output per step of digital level, times the master volume (1-8)
+#define APU_VOLUME_SCALE 16
+#define APU_LOG_ENTRIES 0x10000
+// a frame of a write every double speed M-cycle, more than a CPU can make
+#define APU_LOG_FRAME_ENTRIES (APU_FRAME_DOTS / 2 + 256)
+// a log entry with this address closes the frame instead of writing
+#define APU_LOG_END_FRAME 0
+
+/*
+ * The APU runs lazily. The emulator only adds to `clock`, the channels are
+ * brought up to it, edge by edge into the blip buffers, when a sound register
+ * is written and when a frame closes. In between it costs nothing.
+ */
+typedef struct {
+  bool enabled;
+  bool dac;
+  // dots between timer steps, and when the next one happens within the frame
+  uint32_t period;
+  uint32_t next;
+  // duty step (0-7) or wave sample (0-31)
+  uint8_t step;
+  uint16_t length;
+  bool length_enabled;
+  uint16_t frequency;
+
+  uint8_t volume;
+  uint8_t envelope_period;
+  uint8_t envelope_timer;
+  bool envelope_up;
+
+  // current digital output, and what it adds to each side right now
+  uint8_t level;
+  int32_t left;
+  int32_t right;
+  // what it adds to its own output, see apu_set_channel_outputs
+  int32_t solo;
+} apu_channel_t;
+
+typedef struct {
+  bool enabled;
+  uint8_t period;
+  uint8_t timer;
+  uint8_t shift;
+  bool down;
+  uint16_t shadow;
+} apu_sweep_t;
+
+typedef struct {
+  uint8_t registers[APU_REGISTER_COUNT];
+  apu_channel_t channels[APU_CHANNEL_COUNT];
+  apu_sweep_t sweep;
+  uint16_t lfsr;
+  uint8_t sequencer_step;
+  uint32_t sequencer_next;
+  // dots into the current frame the emulator has reached, and the channels have
+  uint32_t clock;
+  uint32_t time;
+  uint64_t overruns;
+  blip_t left;
+  blip_t right;
+  // NULL unless every channel is also wanted on its own
+  blip_t* channel_outputs;
+  // keeps only what the CPU can read back and makes no sound, see apu_pipeline_t
+  bool shadow;
+} apu_t;
+
+/*
+ * APU thread. While it runs, the emulator thread does not synthesize. Every
+ * sound register and wave RAM write goes into a log with the dot it was made
+ * at, and so does the end of every frame. The APU thread replays the log into
+ * the gameboy's own APU, each write at the dot it would have been made inline,
+ * so the samples come out bit for bit the same, and hands each frame to the
+ * audio sink while the emulator is already on the next one.
+ *
+ * The emulator keeps a shadow APU that takes the same writes but never runs
+ * its channels. Channels only switch on and off through writes, the length
+ * counters and the sweep, none of which depend on synthesis, so NR52 and the
+ * registers read back exactly as inline without waiting for the APU thread.
+ *
+ * The log is a single producer, single consumer ring: the emulator appends
+ * without locking and only wakes the APU thread once per frame. Writes never
+ * get dropped. Like the PPU pipeline, the emulator waits at the end of a
+ * frame while the log has less than a whole frame's worth of room left.
+ */
+typedef struct {
+  uint32_t time;
+  uint16_t address;
+  uint8_t value;
+} apu_log_entry_t;
+
+typedef struct {
+  // handed over by the emulator, and played by the APU thread
+  uint64_t submitted;
+  uint64_t frames;
+  uint64_t writes;
+  // times the emulator had to wait for room at the end of a frame
+  uint64_t stalls;
+  // the most entries waiting when a frame was handed over
+  uint64_t backlog_max;
+} apu_pipeline_stats_t;
+
+typedef struct {
+  pthread_t thread;
+  thread_event_t event;
+  bool stopping;
+  apu_t shadow;
+
+  // the APU thread advances `head`, the emulator `tail`
+  _Alignas(64) _Atomic uint64_t head;
+  _Alignas(64) _Atomic uint64_t tail;
+  apu_log_entry_t entries[APU_LOG_ENTRIES];
+
+  // each only ever changed by one thread, the other just reads them for stats
+  _Atomic uint64_t submitted;
+  _Atomic uint64_t frames;
+  _Atomic uint64_t stalls;
+  _Atomic uint64_t backlog_max;
+} apu_pipeline_t;
+
+/*
+ * Logs a write at the dot the shadow has reached, which is where the
+ * emulator is. Room for it was made when the previous frame ended.
+ */
+static inline void apu_log_write(apu_pipeline_t* pipeline, uint16_t address, uint8_t value) {
+  uint64_t tail = atomic_load_explicit(&pipeline->tail, memory_order_relaxed);
+  pipeline->entries[tail % APU_LOG_ENTRIES] = (apu_log_entry_t){
+      .time = pipeline->shadow.clock,
+      .address = address,
+      .value = value,
+  };
+  atomic_store_explicit(&pipeline->tail, tail + 1, memory_order_release);
+}
+
+bool apu_init(apu_t* apu, uint32_t sample_rate);
+void apu_write(apu_t* apu, uint16_t address, uint8_t value);
+// NR52 as the CPU reads it
+uint8_t apu_status(const apu_t* apu);
+void apu_end_frame(apu_t* apu);
+// takes effect from the next sample on, for rate control
+void apu_set_sample_rate(apu_t* apu, double sample_rate);
+void apu_set_quality(apu_t* apu, blip_quality_t quality);
+
+/*
+ * Also synthesizes each channel into its own mono buffer, before panning and
+ * master volume, for recording the channels separately. `outputs` holds
+ * APU_CHANNEL_COUNT buffers and belongs to the caller. Costs a third buffer
+ * per channel change on top of the two sides.
+ */
+bool apu_set_channel_outputs(apu_t* apu, blip_t* outputs);
+size_t apu_read_channel_samples(apu_t* apu, uint8_t index, int16_t* out, size_t count);
+
+/*
+ * Copies up to `count` interleaved stereo sample frames out, returns how many
+ */
+size_t apu_read_samples(apu_t* apu, int16_t* out, size_t count);
+size_t apu_samples_available(const apu_t* apu);
+
+#endif // !DEBUG
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "apu.h"
+
+/*
+ * Reports what an emulated second of sound costs, as a share of one core, for
+ * a quiet APU, a typical tune and the worst case of every channel at its
+ * highest pitch. Register writes come at the rate a music driver makes them,
+ * a burst once per frame, and the samples are read out every frame the way
+ * the audio device would.
+ */
+
+#define BENCH_SECONDS 4
+#define BENCH_REPEATS 3
+#define BENCH_FRAMES_PER_SECOND 60
+
+typedef struct {
+  const char* name;
+  // NRx3/NRx4 frequency for the squares and wave, NR43 for the noise
+  uint16_t square_frequency;
+  uint16_t wave_frequency;
+  uint8_t noise;
+  bool playing;
+} bench_tune_t;
+
+static const bench_tune_t tunes[] = {
+    { "silent",     0,     0, 0x00, false},
+    {"typical", 0x6D6, 0x783, 0x55,  true},
+    {  "worst", 0x7FF, 0x7FF, 0x00,  true},
+};
+
+static int16_t samples[BLIP_CAPACITY * 2];
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_setup(apu_t* apu, const bench_tune_t* tune) {
+  apu_init(apu, APU_SAMPLE_RATE);
+  apu_write(apu, NR52, NR52_POWER);
+  if (!tune->playing) {
+    return;
+  }
+  apu_write(apu, NR50, 0x77);
+  apu_write(apu, NR51, 0xFF);
+  for (uint16_t address = WAVE_RAM_START; address <= WAVE_RAM_END; ++address) {
+    apu_write(apu, address, (address & 1) ? 0x13 : 0xF7);
+  }
+  apu_write(apu, NR10, 0x00);
+  apu_write(apu, NR11, 0x80);
+  apu_write(apu, NR12, 0xF3);
+  apu_write(apu, NR21, 0x40);
+  apu_write(apu, NR22, 0xA7);
+  apu_write(apu, NR30, 0x80);
+  apu_write(apu, NR32, 0x20);
+  apu_write(apu, NR42, 0xC2);
+  apu_write(apu, NR43, tune->noise);
+}
+
+/*
+ * A music driver's frame: new notes on the squares and the wave, a retriggered
+ * noise hit every other frame
+ */
+static void bench_frame(apu_t* apu, const bench_tune_t* tune, uint32_t frame) {
+  if (tune->playing) {
+    uint16_t detune = tune->square_frequency == 0x7FF ? 0 : frame % 8;
+    apu_write(apu, NR13, (tune->square_frequency + detune) & 0xFF);
+    apu_write(apu, NR14, NRX4_TRIGGER | (tune->square_frequency + detune) >> 8);
+    apu_write(apu, NR23, (tune->square_frequency - detune) & 0xFF);
+    apu_write(apu, NR24, NRX4_TRIGGER | (tune->square_frequency - detune) >> 8);
+    apu_write(apu, NR33, tune->wave_frequency & 0xFF);
+    apu_write(apu, NR34, NRX4_TRIGGER | tune->wave_frequency >> 8);
+    if (frame % 2 == 0) {
+      apu_write(apu, NR44, NRX4_TRIGGER);
+    }
+  }
+  apu->clock += APU_FRAME_DOTS;
+  apu_end_frame(apu);
+  apu_read_samples(apu, samples, BLIP_CAPACITY);
+}
+
+int main(void) {
+  apu_t* apu = malloc(sizeof(apu_t));
+  if (apu == NULL) {
+    return 1;
+  }
+
+  printf("%-8s %14s %10s %10s\n", "tune", "ns/emu second", "core %", "overruns");
+  for (size_t t = 0; t < sizeof(tunes) / sizeof(tunes[0]); ++t) {
+    double best = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+      bench_setup(apu, &tunes[t]);
+      double start = bench_now_ns();
+      for (uint32_t frame = 0; frame < BENCH_SECONDS * BENCH_FRAMES_PER_SECOND; ++frame) {
+        bench_frame(apu, &tunes[t], frame);
+      }
+      double ns = (bench_now_ns() - start) / BENCH_SECONDS;
+      if (repeat == 0 || ns < best) {
+        best = ns;
+      }
+    }
+    printf("%-8s %14.0f %9.2f%% %10lu\n", tunes[t].name, best, best / 1e7, (unsigned long)apu->overruns);
+  }
+
+  free(apu);
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+/*
+ * Plays one log entry into the gameboy's APU, at the dot the emulator
+ * reached it
+ */
+static void pipeline_replay(gameboy_t* gb, const apu_log_entry_t* entry) {
+  gb->apu.clock = entry->time;
+  if (entry->address != APU_LOG_END_FRAME) {
+    apu_write(&gb->apu, entry->address, entry->value);
+    return;
+  }
+  apu_end_frame(&gb->apu);
+  gameboy_publish_audio_frame(gb);
+  atomic_store_explicit(&gb->apu_pipeline->frames, atomic_load_explicit(&gb->apu_pipeline->frames, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static void* apu_pipeline_thread(void* args) {
+  gameboy_t* gb = (gameboy_t*)args;
+  apu_pipeline_t* pipeline = gb->apu_pipeline;
+
+  while (true) {
+    thread_event_register(&pipeline->event);
+    uint64_t head = atomic_load_explicit(&pipeline->head, memory_order_relaxed);
+    uint64_t tail;
+    while ((tail = atomic_load_explicit(&pipeline->tail, memory_order_acquire)) == head && !pipeline->stopping) {
+      thread_event_wait(&pipeline->event);
+    }
+    thread_event_finish(&pipeline->event);
+    if (tail == head) {
+      break;
+    }
+
+    for (; head < tail; ++head) {
+      pipeline_replay(gb, &pipeline->entries[head % APU_LOG_ENTRIES]);
+      atomic_store_explicit(&pipeline->head, head + 1, memory_order_release);
+    }
+    // the emulator may be waiting for room, anyone flushing for the log to run dry. Made without the lock so it does not also end this
+    // thread's own next wait.
+    thread_event_trigger(&pipeline->event);
+  }
+  return NULL;
+}
+
+/*
+ * The shadow starts out as a copy of the APU, so the registers and NR52 carry
+ * on from where they were
+ */
+bool apu_pipeline_start(gameboy_t* gb) {
+  if (gb->apu_pipeline != NULL) {
+    return false;
+  }
+  apu_pipeline_t* pipeline = aligned_alloc(_Alignof(apu_pipeline_t), sizeof(apu_pipeline_t));
+  if (pipeline == NULL) {
+    return false;
+  }
+  memset(pipeline, 0, sizeof(*pipeline));
+  pipeline->event = thread_event_create();
+  pipeline->shadow = gb->apu;
+  pipeline->shadow.shadow = true;
+  pipeline->shadow.channel_outputs = NULL;
+  atomic_init(&pipeline->head, 0);
+  atomic_init(&pipeline->tail, 0);
+  atomic_init(&pipeline->submitted, 0);
+  atomic_init(&pipeline->frames, 0);
+  atomic_init(&pipeline->stalls, 0);
+  atomic_init(&pipeline->backlog_max, 0);
+  gb->apu_pipeline = pipeline;
+
+  if (pthread_create(&pipeline->thread, NULL, apu_pipeline_thread, gb) != 0) {
+    gb->apu_pipeline = NULL;
+    free(pipeline);
+    return false;
+  }
+  return true;
+}
+
+static uint64_t pipeline_backlog(apu_pipeline_t* pipeline) {
+  //
+  return atomic_load_explicit(&pipeline->tail, memory_order_relaxed) - atomic_load_explicit(&pipeline->head, memory_order_acquire);
+}
+
+/*
+ * Closes the frame on the shadow and in the log, and wakes the APU thread to
+ * play it while the emulator goes on with the next one. Waits first if the
+ * next frame's writes might not fit.
+ */
+void apu_pipeline_submit(gameboy_t* gb) {
+  apu_pipeline_t* pipeline = gb->apu_pipeline;
+  apu_log_write(pipeline, APU_LOG_END_FRAME, 0);
+  apu_end_frame(&pipeline->shadow);
+
+  uint64_t backlog = pipeline_backlog(pipeline);
+  if (backlog > atomic_load_explicit(&pipeline->backlog_max, memory_order_relaxed)) {
+    atomic_store_explicit(&pipeline->backlog_max, backlog, memory_order_relaxed);
+  }
+  atomic_store_explicit(&pipeline->submitted, atomic_load_explicit(&pipeline->submitted, memory_order_relaxed) + 1, memory_order_relaxed);
+
+  // before taking the lock, a trigger made holding it would end the wait below at once
+  thread_event_trigger(&pipeline->event);
+  if (pipeline_backlog(pipeline) > APU_LOG_ENTRIES - APU_LOG_FRAME_ENTRIES) {
+    atomic_store_explicit(&pipeline->stalls, atomic_load_explicit(&pipeline->stalls, memory_order_relaxed) + 1, memory_order_relaxed);
+    thread_event_register(&pipeline->event);
+    while (pipeline_backlog(pipeline) > APU_LOG_ENTRIES - APU_LOG_FRAME_ENTRIES) {
+      thread_event_wait(&pipeline->event);
+    }
+    thread_event_finish(&pipeline->event);
+  }
+}
+
+// waits until the APU thread has played everything logged so far
+void apu_pipeline_flush(gameboy_t* gb) {
+  apu_pipeline_t* pipeline = gb->apu_pipeline;
+  if (pipeline == NULL) {
+    return;
+  }
+  // writes since the last frame ended have not woken it yet
+  thread_event_trigger(&pipeline->event);
+  thread_event_register(&pipeline->event);
+  while (atomic_load_explicit(&pipeline->head, memory_order_acquire) != atomic_load_explicit(&pipeline->tail, memory_order_relaxed)) {
+    thread_event_wait(&pipeline->event);
+  }
+  thread_event_finish(&pipeline->event);
+}
+
+/*
+ * Plays out the log and goes back to synthesizing on the emulator thread,
+ * the APU picking up at the dot the emulator has reached
+ */
+void apu_pipeline_stop(gameboy_t* gb) {
+  apu_pipeline_t* pipeline = gb->apu_pipeline;
+  if (pipeline == NULL) {
+    return;
+  }
+  apu_pipeline_flush(gb);
+  thread_event_register(&pipeline->event);
+  pipeline->stopping = true;
+  thread_event_trigger(&pipeline->event);
+  thread_event_finish(&pipeline->event);
+  pthread_join(pipeline->thread, NULL);
+
+  gb->apu.clock = pipeline->shadow.clock;
+  gb->apu_pipeline = NULL;
+  free(pipeline);
+}
+
+apu_pipeline_stats_t apu_pipeline_stats(gameboy_t* gb) {
+  apu_pipeline_stats_t stats = {0};
+  apu_pipeline_t* pipeline = gb->apu_pipeline;
+  if (pipeline == NULL) {
+    return stats;
+  }
+  stats.submitted = atomic_load_explicit(&pipeline->submitted, memory_order_relaxed);
+  stats.frames = atomic_load_explicit(&pipeline->frames, memory_order_relaxed);
+  // every entry that is not the end of a frame is a write
+  stats.writes = atomic_load_explicit(&pipeline->tail, memory_order_relaxed) - stats.submitted;
+  stats.stalls = atomic_load_explicit(&pipeline->stalls, memory_order_relaxed);
+  stats.backlog_max = atomic_load_explicit(&pipeline->backlog_max, memory_order_relaxed);
+  return stats;
+}
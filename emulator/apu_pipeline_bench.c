@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gameboy.h"
+
+/*
+ * Plays the same register writes through the APU inline and on the APU
+ * thread, and reports what an emulated second costs the emulator thread in
+ * either case and whether the samples and what NR52 read back came out the
+ * same. The writes are spread across the frame at the M-cycles a driver would
+ * make them, with the LCD off so the PPU costs nothing.
+ */
+
+#define BENCH_FRAMES 600
+#define BENCH_REPEATS 3
+// M-cycles in a 70224 dot frame
+#define BENCH_FRAME_CYCLES (APU_FRAME_DOTS / PPU_DOTS_PER_CYCLE)
+
+typedef struct {
+  const char* name;
+  // M-cycles between two wave RAM writes, 0 for none
+  uint32_t wave_stream_cycles;
+} bench_driver_t;
+
+static const bench_driver_t drivers[] = {
+    {     "music",  0},
+    {"wave stream", 64},
+};
+
+typedef struct {
+  uint64_t frames;
+  // every frame's hash folded into one
+  uint64_t hash;
+} bench_sink_t;
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_sink(void* data, const gameboy_audio_frame_t* frame) {
+  bench_sink_t* sink = (bench_sink_t*)data;
+  sink->frames += 1;
+  sink->hash = (sink->hash ^ frame->hash) * 0x100000001B3ull;
+}
+
+static void bench_setup(gameboy_t* gb) {
+  memory_write(gb, NR52, NR52_POWER);
+  memory_write(gb, NR50, 0x77);
+  memory_write(gb, NR51, 0xFF);
+  for (uint16_t address = WAVE_RAM_START; address <= WAVE_RAM_END; ++address) {
+    memory_write(gb, address, (address & 1) ? 0x13 : 0xF7);
+  }
+  memory_write(gb, NR11, 0x80);
+  memory_write(gb, NR12, 0xF3);
+  memory_write(gb, NR21, 0x40);
+  memory_write(gb, NR22, 0xA7);
+  memory_write(gb, NR30, 0x80);
+  memory_write(gb, NR32, 0x20);
+  memory_write(gb, NR42, 0xC2);
+  memory_write(gb, NR43, 0x55);
+}
+
+/*
+ * A music driver's update at the top of the frame, notes with a length so
+ * channels switch themselves off for NR52 to show, and optionally a stream
+ * of samples into wave RAM for the rest of it
+ */
+static void bench_frame(gameboy_t* gb, const bench_driver_t* driver, uint32_t frame) {
+  uint16_t square = 0x6D6 + frame % 8;
+  memory_write(gb, NR11, 0x80 | (frame % 64));
+  memory_write(gb, NR13, square & 0xFF);
+  memory_write(gb, NR14, NRX4_TRIGGER | NRX4_LENGTH_ENABLE | square >> 8);
+  gameboy_advance(gb, 200);
+  memory_write(gb, NR23, (square - 16) & 0xFF);
+  memory_write(gb, NR24, NRX4_TRIGGER | (square - 16) >> 8);
+  memory_write(gb, NR33, 0x83);
+  memory_write(gb, NR34, NRX4_TRIGGER | 0x07);
+  if (frame % 2 == 0) {
+    memory_write(gb, NR44, NRX4_TRIGGER);
+  }
+  uint32_t cycles = 200;
+  for (uint8_t sample = 0; driver->wave_stream_cycles > 0 && cycles + driver->wave_stream_cycles < BENCH_FRAME_CYCLES; ++sample) {
+    gameboy_advance(gb, driver->wave_stream_cycles);
+    cycles += driver->wave_stream_cycles;
+    memory_write(gb, WAVE_RAM_START + sample % 16, frame + sample * 17);
+  }
+  gameboy_advance(gb, BENCH_FRAME_CYCLES - cycles);
+}
+
+/*
+ * Returns ns per emulated second on the emulator thread, up to the last
+ * frame handed over, and in `played_ns` until the APU thread has played it
+ */
+static double bench_run(gameboy_t* gb, const bench_driver_t* driver, bool pipeline, bench_sink_t* sink, uint8_t* status, double* played_ns) {
+  gameboy_init(gb);
+  *sink = (bench_sink_t){0};
+  gameboy_set_audio_sink(gb, bench_sink, sink);
+  bench_setup(gb);
+  if (pipeline) {
+    apu_pipeline_start(gb);
+  }
+  double start = bench_now_ns();
+  for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+    bench_frame(gb, driver, frame);
+    status[frame] = MEMORY_AT(NR52);
+  }
+  double ns = bench_now_ns() - start;
+  apu_pipeline_flush(gb);
+  *played_ns = (bench_now_ns() - start) / BENCH_FRAMES * 60;
+  return ns / BENCH_FRAMES * 60;
+}
+
+int main(void) {
+  gameboy_t* gb = malloc(sizeof(gameboy_t));
+  if (gb == NULL) {
+    return 1;
+  }
+  static uint8_t inline_status[BENCH_FRAMES];
+  static uint8_t pipeline_status[BENCH_FRAMES];
+
+  printf("%-12s %-8s %14s %14s %8s %8s %10s %10s\n", "driver", "apu", "emu ns/sec", "played ns/sec", "stalls", "backlog", "samples", "nr52");
+  for (size_t d = 0; d < sizeof(drivers) / sizeof(drivers[0]); ++d) {
+    double inline_best = 0, pipeline_best = 0, played_best = 0, played;
+    bench_sink_t reference, sink;
+    apu_pipeline_stats_t stats = {0};
+    size_t mismatched = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+      double ns = bench_run(gb, &drivers[d], false, &reference, inline_status, &played);
+      inline_best = repeat == 0 || ns < inline_best ? ns : inline_best;
+
+      ns = bench_run(gb, &drivers[d], true, &sink, pipeline_status, &played);
+      stats = apu_pipeline_stats(gb);
+      apu_pipeline_stop(gb);
+      if (repeat == 0 || ns < pipeline_best) {
+        pipeline_best = ns;
+        played_best = played;
+      }
+      mismatched = 0;
+      for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+        mismatched += inline_status[frame] != pipeline_status[frame];
+      }
+    }
+    bool same = reference.frames == sink.frames && reference.hash == sink.hash;
+    printf("%-12s %-8s %14.0f %14s %8s %8s %10s %10s\n", drivers[d].name, "inline", inline_best, "-", "-", "-", "-", "-");
+    printf("%-12s %-8s %14.0f %14.0f %8lu %8lu %10s %10zu\n", drivers[d].name, "thread", pipeline_best, played_best, (unsigned long)stats.stalls,
+           (unsigned long)stats.backlog_max, same ? "identical" : "DIFFER", mismatched);
+  }
+
+  free(gb);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <stdlib.h>
+
+#include "apu.h"
+
+static apu_t apu;
+static int16_t samples[BLIP_CAPACITY * 2];
+
+static void apu_advance(apu_t* apu, uint32_t dots) {
+  while (dots > 0) {
+    uint32_t step = dots < APU_FRAME_DOTS - apu->clock ? dots : APU_FRAME_DOTS - apu->clock;
+    apu->clock += step;
+    dots -= step;
+    if (apu->clock == APU_FRAME_DOTS) {
+      apu_end_frame(apu);
+    }
+  }
+}
+
+static void apu_power_on_square(apu_t* apu, uint8_t length) {
+  apu_init(apu, APU_SAMPLE_RATE);
+  apu_write(apu, NR52, NR52_POWER);
+  apu_write(apu, NR50, 0x77);
+  apu_write(apu, NR51, 0xFF);
+  apu_write(apu, NR21, 0x80 | (64 - length));
+  apu_write(apu, NR22, 0xF0);
+  apu_write(apu, NR23, 0x00);
+}
+
+Test(apu, triggering_a_channel_shows_in_nr52) {
+  apu_power_on_square(&apu, 64);
+  cr_assert(eq(u8, apu_status(&apu), NR52_POWER | 0x70));
+
+  apu_write(&apu, NR24, NRX4_TRIGGER | 0x07);
+  cr_assert(eq(u8, apu_status(&apu), NR52_POWER | 0x70 | 0x02));
+
+  // a DAC turned off takes the channel with it
+  apu_write(&apu, NR22, 0x00);
+  cr_assert(eq(u8, apu_status(&apu), NR52_POWER | 0x70));
+}
+
+Test(apu, length_runs_out_at_256_hz) {
+  apu_power_on_square(&apu, 2);
+  apu_write(&apu, NR24, NRX4_TRIGGER | NRX4_LENGTH_ENABLE | 0x07);
+
+  // the first length clock comes with the first sequencer step, the second two steps later
+  apu_advance(&apu, APU_SEQUENCER_DOTS);
+  apu_write(&apu, NR50, 0x77);
+  cr_assert(eq(u8, apu_status(&apu) & 0x02, 0x02));
+  apu_advance(&apu, APU_SEQUENCER_DOTS * 2);
+  apu_write(&apu, NR50, 0x77);
+  cr_assert(eq(u8, apu_status(&apu) & 0x02, 0x00));
+}
+
+Test(apu, powering_off_silences_and_clears) {
+  apu_power_on_square(&apu, 64);
+  apu_write(&apu, WAVE_RAM_START, 0xAB);
+  apu_write(&apu, NR24, NRX4_TRIGGER | 0x07);
+  apu_advance(&apu, APU_FRAME_DOTS * 2);
+  cr_assert(gt(sz, apu_read_samples(&apu, samples, BLIP_CAPACITY), 0));
+
+  apu_write(&apu, NR52, 0);
+  cr_assert(eq(u8, apu_status(&apu), 0x70));
+  cr_assert(eq(u8, apu.registers[NR22 - APU_REGISTERS_START], 0));
+  cr_assert(eq(u8, apu.registers[WAVE_RAM_START - APU_REGISTERS_START], 0xAB));
+
+  // writes are ignored until it is powered on again
+  apu_write(&apu, NR24, NRX4_TRIGGER | 0x07);
+  cr_assert(eq(u8, apu_status(&apu), 0x70));
+
+  // once the filter's tail is through, the output stays at the high pass's resting level
+  apu_advance(&apu, APU_FRAME_DOTS * 30);
+  size_t count = apu_read_samples(&apu, samples, BLIP_CAPACITY);
+  cr_assert(gt(sz, count, 2));
+  cr_assert(lt(i32, abs(samples[(count - 1) * 2] - samples[(count - 2) * 2]), 2));
+}
+
+Test(apu, a_playing_square_produces_a_48_khz_stream) {
+  apu_power_on_square(&apu, 64);
+  apu_write(&apu, NR24, NRX4_TRIGGER | 0x07);
+  apu_advance(&apu, APU_FRAME_DOTS);
+
+  size_t count = apu_read_samples(&apu, samples, BLIP_CAPACITY);
+  // 70224 dots at 4194304 Hz, in 48 kHz samples
+  cr_assert(ge(sz, count, 802));
+  cr_assert(le(sz, count, 804));
+  int16_t low = samples[0];
+  int16_t high = samples[0];
+  for (size_t i = 0; i < count; ++i) {
+    low = samples[i * 2] < low ? samples[i * 2] : low;
+    high = samples[i * 2] > high ? samples[i * 2] : high;
+    cr_assert(eq(i16, samples[i * 2], samples[i * 2 + 1]));
+  }
+  cr_assert(gt(i32, high - low, 1000));
+}
+
+Test(apu, channel_outputs_carry_only_their_own_channel) {
+  static blip_t outputs[APU_CHANNEL_COUNT];
+  static int16_t solo[BLIP_CAPACITY];
+  apu_power_on_square(&apu, 64);
+  cr_assert(apu_set_channel_outputs(&apu, outputs));
+  apu_write(&apu, NR24, NRX4_TRIGGER | 0x07);
+  apu_advance(&apu, APU_FRAME_DOTS);
+
+  size_t count = apu_read_samples(&apu, samples, BLIP_CAPACITY);
+  for (uint8_t i = 0; i < APU_CHANNEL_COUNT; ++i) {
+    cr_assert(eq(sz, apu_read_channel_samples(&apu, i, solo, BLIP_CAPACITY), count));
+    int32_t range = 0;
+    for (size_t k = 1; k < count; ++k) {
+      range = abs(solo[k] - solo[0]) > range ? abs(solo[k] - solo[0]) : range;
+    }
+    // square 2 is the only one playing
+    cr_assert(i == 1 ? gt(i32, range, 1000) : eq(i32, range, 0));
+  }
+}
@@ -0,0 +1,184 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "gameboy.h"
+
+/*
+ * Shows BENCH_FRAMES frames at the Game Boy's frame rate twice: once with an
+ * emulator thread paced by the frame pacer handing frames to a presenting
+ * thread the way main.c does by default, and once --cooperative style with a
+ * single thread that wakes once a frame, runs the time that passed and takes
+ * the frame itself. Reports the CPU time and context switches of each.
+ *
+ * The CPU core cannot run cartridges yet, so like gameboy_bench a stand-in
+ * instruction stream advances the scheduler, which gameboy_run_elapsed and
+ * gameboy_run_thread would do through gameboy_emulate_cycle.
+ */
+
+#define BENCH_FRAMES 300
+
+// M-cycles of a plausible run of instructions
+static const uint8_t instruction_cycles[] = {1, 2, 3, 2, 4, 1, 2, 3};
+
+typedef struct {
+  gameboy_t* gb;
+  thread_event_t frame_ready;
+  _Atomic bool stopping;
+} bench_threaded_t;
+
+typedef struct {
+  uint64_t wall_ns;
+  double cpu_s;
+  long voluntary;
+  long involuntary;
+  uint64_t frames;
+} bench_result_t;
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_setup(gameboy_t* gb) {
+  gameboy_init(gb);
+  uint32_t seed = 1;
+  for (uint16_t address = CHAR_DATA_START; address <= BG_DATA_2_END; ++address) {
+    seed = seed * 1103515245 + 12345;
+    memory_write(gb, address, seed >> 16);
+  }
+  memory_write(gb, BGP, 0xE4);
+  memory_write(gb, LCDC, LCDC_ON | LCDC_BG_ON | LCDC_BG_CHAR_AREA);
+}
+
+/*
+ * Runs at least `cycles` M-cycles of stand-in instructions, returns how many
+ * it ran
+ */
+static int64_t bench_run(gameboy_t* gb, int64_t cycles) {
+  int64_t done = 0;
+  for (uint32_t i = 0; done < cycles; ++i) {
+    uint8_t n = instruction_cycles[i % sizeof(instruction_cycles)];
+    if (i % 8 == 0) {
+      memory_write(gb, 0xC000 + (i >> 3) % 0x2000, i);
+    }
+    gameboy_advance(gb, n);
+    done += n;
+  }
+  return done;
+}
+
+static void bench_notify(void* data) {
+  //
+  thread_event_trigger(&((bench_threaded_t*)data)->frame_ready);
+}
+
+// gameboy_run_thread with the stand-in instructions
+static void* bench_emulator_thread(void* args) {
+  bench_threaded_t* threaded = (bench_threaded_t*)args;
+  gameboy_t* gb = threaded->gb;
+  int64_t frame_cycles = APU_FRAME_DOTS / PPU_DOTS_PER_CYCLE;
+  frame_pacer_init(&gb->pacer, frame_cycles * 1000000000 / gb->clock_speed);
+  int64_t cycles = 0;
+  while (!atomic_load(&threaded->stopping)) {
+    cycles += frame_cycles;
+    cycles -= bench_run(gb, cycles);
+    frame_pacer_wait(&gb->pacer);
+  }
+  return NULL;
+}
+
+static void bench_begin(bench_result_t* result, struct rusage* usage) {
+  getrusage(RUSAGE_SELF, usage);
+  result->wall_ns = bench_now_ns();
+}
+
+static void bench_end(bench_result_t* result, const struct rusage* start) {
+  struct rusage end;
+  getrusage(RUSAGE_SELF, &end);
+  result->wall_ns = bench_now_ns() - result->wall_ns;
+  result->cpu_s = (end.ru_utime.tv_sec - start->ru_utime.tv_sec) + (end.ru_utime.tv_usec - start->ru_utime.tv_usec) / 1e6 +
+                  (end.ru_stime.tv_sec - start->ru_stime.tv_sec) + (end.ru_stime.tv_usec - start->ru_stime.tv_usec) / 1e6;
+  result->voluntary = end.ru_nvcsw - start->ru_nvcsw;
+  result->involuntary = end.ru_nivcsw - start->ru_nivcsw;
+}
+
+static bench_result_t bench_threaded(gameboy_t* gb) {
+  bench_result_t result = {0};
+  struct rusage usage;
+  bench_threaded_t threaded = {.gb = gb, .frame_ready = thread_event_create()};
+  bench_setup(gb);
+  triple_buffer_set_notify(&gb->frames, bench_notify, &threaded);
+
+  bench_begin(&result, &usage);
+  pthread_t thread;
+  pthread_create(&thread, NULL, bench_emulator_thread, &threaded);
+  thread_event_register(&threaded.frame_ready);
+  while (result.frames < BENCH_FRAMES) {
+    bool is_new;
+    triple_buffer_acquire(&gb->frames, &is_new);
+    if (!is_new) {
+      thread_event_wait(&threaded.frame_ready);
+      continue;
+    }
+    result.frames += 1;
+  }
+  thread_event_finish(&threaded.frame_ready);
+  atomic_store(&threaded.stopping, true);
+  pthread_join(thread, NULL);
+  bench_end(&result, &usage);
+  return result;
+}
+
+/*
+ * SDL_AppIterate on a callback rate of one frame: sleep to the next tick, run
+ * what gameboy_run_elapsed would, take the newest frame
+ */
+static bench_result_t bench_cooperative(gameboy_t* gb) {
+  bench_result_t result = {0};
+  struct rusage usage;
+  bench_setup(gb);
+  uint64_t interval = (uint64_t)(APU_FRAME_DOTS / PPU_DOTS_PER_CYCLE) * 1000000000 / gb->clock_speed;
+
+  bench_begin(&result, &usage);
+  uint64_t tick = bench_now_ns();
+  uint64_t clock = tick;
+  int64_t credit = 0;
+  while (result.frames < BENCH_FRAMES) {
+    tick += interval;
+    struct timespec ts = {.tv_sec = tick / 1000000000, .tv_nsec = tick % 1000000000};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    uint64_t now = bench_now_ns();
+    credit += (int64_t)(now - clock) * gb->clock_speed;
+    clock = now;
+    credit -= bench_run(gb, (credit + 999999999) / 1000000000) * 1000000000;
+    bool is_new;
+    triple_buffer_acquire(&gb->frames, &is_new);
+    result.frames += is_new;
+  }
+  bench_end(&result, &usage);
+  return result;
+}
+
+static void bench_report(const char* name, const bench_result_t* result) {
+  double seconds = result->wall_ns / 1e9;
+  printf("%-12s %8lu %8.2fs %9.1f%% %12.1f %12.1f\n", name, (unsigned long)result->frames, seconds, result->cpu_s / seconds * 100,
+         result->voluntary / seconds, result->involuntary / seconds);
+}
+
+int main(void) {
+  gameboy_t* gb = malloc(sizeof(gameboy_t));
+  if (gb == NULL) {
+    return 1;
+  }
+  printf("%-12s %8s %9s %10s %12s %12s\n", "mode", "frames", "wall", "cpu", "vol cs/s", "invol cs/s");
+  bench_result_t threaded = bench_threaded(gb);
+  bench_report("threaded", &threaded);
+  bench_result_t cooperative = bench_cooperative(gb);
+  bench_report("cooperative", &cooperative);
+  free(gb);
+  return 0;
+}
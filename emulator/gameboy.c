@@ -1,39 +1,233 @@
 #include <pthread.h>
 #include <stdio.h>
-#include <unistd.h>
+#include <string.h>
+#include <time.h>
 
+#include "../hash.h"
 #include "gameboy.h"
 
 bool gameboy_init(gameboy_t* gb) {
-  //
+  memset(gb, 0, sizeof(*gb));
+  triple_buffer_init(&gb->frames);
+  gb->screen = triple_buffer_back(&gb->frames)->pixels;
+  gb->wram_bank = 1;
+  gb->clock_speed = GAMEBOY_CYCLES_PER_SECOND;
+  command_queue_init(&gb->commands);
+  MEMORY_AT(P1) = joypad_register(0, 0);
+  ppu_init(gb);
+  if (!apu_init(&gb->apu, APU_SAMPLE_RATE)) {
+    return false;
+  }
+  MEMORY_AT(NR52) = apu_status(&gb->apu);
   return true;
 }
+
+/*
+ * Runs the emulated clock `ratio` times as fast as the real hardware, so the
+ * frame rate can be nudged onto the host's refresh rate
+ */
+void gameboy_set_speed(gameboy_t* gb, double ratio) {
+  double cycles = GAMEBOY_CYCLES_PER_SECOND * ratio;
+  gb->clock_speed = gb->double_speed ? cycles * 2 : cycles;
+}
+
+// set before the emulator thread starts
+void gameboy_set_frame_sink(gameboy_t* gb, gameboy_frame_sink_f sink, void* data) {
+  gb->frame_sink = sink;
+  gb->frame_sink_data = data;
+}
+
+// set before the emulator thread starts
+void gameboy_set_audio_sink(gameboy_t* gb, gameboy_audio_sink_f sink, void* data) {
+  gb->audio_sink = sink;
+  gb->audio_sink_data = data;
+}
+
+void gameboy_set_model(gameboy_t* gb, gameboy_model_t model) {
+  gb->model = model;
+  if (model == GAMEBOY_MODEL_CGB) {
+    MEMORY_AT(SVBK) = gb->wram_bank;
+  }
+  // the planes were drawn without map attributes, or with them
+  gb->ppu.caches.cgb = model == GAMEBOY_MODEL_CGB;
+  ppu_caches_invalidate(&gb->ppu.caches);
+}
 bool gameboy_load_rom(gameboy_t* gb, const char* rom_path) {
   //
   return true;
 }
 
-typedef struct {
-  thread_event_t* te;
-  uint32_t* clock_speed;
-} clock_thread_args_t;
-void* cpu_clock_thread(void* args);
 typedef struct {
   gameboy_t* gb;
 } display_thread_args_t;
+
+// M-cycles in one APU frame, which is also one LCD frame
+static uint32_t gameboy_frame_cycles(const gameboy_t* gb) {
+  //
+  return APU_FRAME_DOTS / (gb->double_speed ? PPU_DOTS_PER_CYCLE / 2 : PPU_DOTS_PER_CYCLE);
+}
+
+static uint64_t gameboy_frame_interval_ns(const gameboy_t* gb) {
+  //
+  return (uint64_t)gameboy_frame_cycles(gb) * 1000000000 / gb->clock_speed;
+}
+
+/*
+ * From any thread. False when the emulator is too far behind on its commands
+ * to take another one.
+ */
+bool gameboy_send(gameboy_t* gb, command_t command) {
+  //
+  return command_queue_push(&gb->commands, command);
+}
+
+static void gameboy_set_buttons(gameboy_t* gb, uint8_t buttons) {
+  uint8_t before = MEMORY_AT(P1);
+  gb->buttons = buttons;
+  MEMORY_AT(P1) = joypad_register(buttons, before);
+  if (before & ~MEMORY_AT(P1) & P1_KEYS) {
+    MEMORY_AT(INTERRUPT_FLAG) |= INTERRUPT_JOYPAD;
+    gb->low_power = false;
+  }
+}
+
+/*
+ * The APU and PPU threads each hold state of their own that a save state
+ * would have to be synced with, so saving and loading is turned down while
+ * either runs
+ */
+static bool gameboy_save_state(gameboy_t* gb, gameboy_state_t* state) {
+  if (gb->apu_pipeline != NULL || gb->ppu.pipeline != NULL) {
+    return false;
+  }
+  memcpy(state->memory, gb->memory, sizeof(state->memory));
+  state->cpu = gb->cpu;
+  state->low_power = gb->low_power;
+  state->ppu = gb->ppu;
+  state->apu = gb->apu;
+  state->model = gb->model;
+  state->double_speed = gb->double_speed;
+  state->vram_bank = gb->vram_bank;
+  state->wram_bank = gb->wram_bank;
+  memcpy(state->vram, gb->vram, sizeof(state->vram));
+  memcpy(state->wram, gb->wram, sizeof(state->wram));
+  memcpy(state->bg_palettes, gb->bg_palettes, sizeof(state->bg_palettes));
+  memcpy(state->obj_palettes, gb->obj_palettes, sizeof(state->obj_palettes));
+  return true;
+}
+
+/*
+ * Frames go on being numbered from where they are and the renderer settings
+ * stay, the rest is put back as it was saved
+ */
+static bool gameboy_load_state(gameboy_t* gb, const gameboy_state_t* state) {
+  if (gb->apu_pipeline != NULL || gb->ppu.pipeline != NULL) {
+    return false;
+  }
+  memcpy(gb->memory, state->memory, sizeof(gb->memory));
+  if (state->double_speed != gb->double_speed) {
+    gb->clock_speed = state->double_speed ? gb->clock_speed * 2 : gb->clock_speed / 2;
+  }
+  gb->cpu = state->cpu;
+  gb->low_power = state->low_power;
+  ppu_renderer_t renderer = gb->ppu.renderer;
+  ppu_frame_skip_t frame_skip = gb->ppu.frame_skip;
+  uint64_t frames = gb->ppu.frames;
+  gb->ppu = state->ppu;
+  gb->ppu.renderer = renderer;
+  gb->ppu.frame_skip = frame_skip;
+  gb->ppu.frames = frames;
+  blip_t* channel_outputs = gb->apu.channel_outputs;
+  gb->apu = state->apu;
+  gb->apu.channel_outputs = channel_outputs;
+  gb->model = state->model;
+  gb->double_speed = state->double_speed;
+  gb->vram_bank = state->vram_bank;
+  gb->wram_bank = state->wram_bank;
+  memcpy(gb->vram, state->vram, sizeof(gb->vram));
+  memcpy(gb->wram, state->wram, sizeof(gb->wram));
+  memcpy(gb->bg_palettes, state->bg_palettes, sizeof(gb->bg_palettes));
+  memcpy(gb->obj_palettes, state->obj_palettes, sizeof(gb->obj_palettes));
+  // the keys held are the host's, not the save's
+  MEMORY_AT(P1) = joypad_register(gb->buttons, MEMORY_AT(P1));
+  return true;
+}
+
+static void gameboy_apply_command(gameboy_t* gb, const command_t* command) {
+  switch (command->type) {
+  case GAMEBOY_COMMAND_JOYPAD:
+    gameboy_set_buttons(gb, command->value);
+    break;
+  case GAMEBOY_COMMAND_PAUSE:
+    gb->paused = true;
+    break;
+  case GAMEBOY_COMMAND_RESUME:
+    gb->paused = false;
+    break;
+  case GAMEBOY_COMMAND_SAVE_STATE:
+    gb->command_stats.refused += !gameboy_save_state(gb, command->data);
+    break;
+  case GAMEBOY_COMMAND_LOAD_STATE:
+    gb->command_stats.refused += !gameboy_load_state(gb, command->data);
+    break;
+  case GAMEBOY_COMMAND_SPEED:
+    gameboy_set_speed(gb, command->ratio);
+    break;
+  case GAMEBOY_COMMAND_SHUTDOWN:
+    gb->stopped = true;
+    break;
+  }
+}
+
+static void gameboy_run_commands(gameboy_t* gb) {
+  command_t command;
+  if (!command_queue_pop(&gb->commands, &command)) {
+    return;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t now = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  do {
+    gameboy_apply_command(gb, &command);
+    uint64_t latency = now - command.time_ns;
+    gb->command_stats.applied += 1;
+    gb->command_stats.latency_total_ns += latency;
+    if (latency > gb->command_stats.latency_max_ns) {
+      gb->command_stats.latency_max_ns = latency;
+    }
+  } while (command_queue_pop(&gb->commands, &command));
+}
+
+/*
+ * Runs at least `cycles` M-cycles, taking commands before every block of
+ * GAMEBOY_COMMAND_BLOCK_CYCLES. Stops early once paused or shut down, returns
+ * how many it ran.
+ */
+static int64_t gameboy_run_blocks(gameboy_t* gb, int64_t cycles) {
+  int64_t done = 0;
+  while (done < cycles) {
+    gameboy_run_commands(gb);
+    if (gb->paused || gb->stopped) {
+      break;
+    }
+    int64_t block_end = done + GAMEBOY_COMMAND_BLOCK_CYCLES;
+    while (done < cycles && done < block_end) {
+      done += gameboy_emulate_cycle(gb);
+    }
+  }
+  return done;
+}
+
+/*
+ * Runs a frame's worth of M-cycles as fast as it can, then waits for the
+ * frame's deadline. Cycles an instruction ran over by count against the next
+ * frame, and the clock speed is picked up every frame. While paused it still
+ * wakes every frame, to see whether it has been resumed.
+ */
 void* gameboy_run_thread(void* args) {
 
   gameboy_t* gb = ((gameboy_thread_args_t*)args)->gb;
 
-  // spawn cpu clock thread
-  pthread_t clock_thread;
-  clock_thread_args_t ctargs = {
-      .te = &gb->clock_tick,
-      .clock_speed = &gb->clock_speed,
-  };
-  if (!pthread_create(&clock_thread, NULL, cpu_clock_thread, &ctargs)) {
-    // TODO:
-  }
   // spawn display driver thread
   pthread_t display_thread;
   display_thread_args_t dtargs = {
@@ -43,41 +237,119 @@ void* gameboy_run_thread(void* args) {
     // TODO:
   }
 
-  // simluating cpu cycle delay
-  num_cycles cpu_cycles_to_wait = 0;
-  while (true) {
-    thread_event_register(&gb->clock_tick);
-    thread_event_wait(&gb->clock_tick);
-    if (cpu_cycles_to_wait < 1) {
-      cpu_cycles_to_wait = gameboy_emulate_cycle(gb);
+  frame_pacer_init(&gb->pacer, gameboy_frame_interval_ns(gb));
+  int64_t cycles = 0;
+  while (!gb->stopped) {
+    cycles += gameboy_frame_cycles(gb);
+    cycles -= gameboy_run_blocks(gb, cycles);
+    if (gb->paused) {
+      cycles = 0;
     }
-    thread_event_finish(&gb->clock_tick);
-    cpu_cycles_to_wait -= 1;
+    frame_pacer_set_interval(&gb->pacer, gameboy_frame_interval_ns(gb));
+    frame_pacer_wait(&gb->pacer);
   }
 
+  pthread_join(display_thread, NULL);
   return args;
 }
 
-void* cpu_clock_thread(void* args) {
-  clock_thread_args_t* ctargs = (clock_thread_args_t*)args;
-  uint32_t* clock_speed = ctargs->clock_speed;
-  thread_event_t* te = ctargs->te;
-  while (true) {
-    usleep(1000000 / *clock_speed);
-    thread_event_trigger(te);
+/*
+ * Runs the emulated time that passed between the previous call and `now_ns`
+ * on the calling thread, for a caller that drives the emulator itself rather
+ * than giving it gameboy_run_thread. The first call only starts the clock.
+ * Like the frame pacer, more than FRAME_PACER_MAX_LAG frames behind is
+ * skipped instead of run flat out, and so is the time spent paused. Returns
+ * the M-cycles run.
+ */
+uint64_t gameboy_run_elapsed(gameboy_t* gb, uint64_t now_ns) {
+  if (gb->run_clock_ns == 0) {
+    gb->run_clock_ns = now_ns;
+    return 0;
   }
-  return args;
+  uint64_t elapsed = now_ns - gb->run_clock_ns;
+  uint64_t limit = FRAME_PACER_MAX_LAG * gameboy_frame_interval_ns(gb);
+  if (elapsed > limit) {
+    gb->run_skipped_ns += elapsed - limit;
+    elapsed = limit;
+  }
+  gb->run_clock_ns = now_ns;
+  // in billionths so the fraction of a cycle each call ends on is not lost
+  gb->run_credit += (int64_t)elapsed * gb->clock_speed;
+  int64_t cycles = gameboy_run_blocks(gb, (gb->run_credit + 999999999) / 1000000000);
+  gb->run_credit -= cycles * 1000000000;
+  if (gb->paused && gb->run_credit > 0) {
+    gb->run_credit = 0;
+  }
+  return cycles;
 }
 
 num_cycles gameboy_emulate_cycle(gameboy_t* gb) {
+  if (gb->low_power) {
+    // nothing is clocked, the cycle only lets the caller see to its commands
+    return 1;
+  }
   opcode op = gb->memory[PC];
   instruction_f instruction = fetch_instruction_from_opcode(op);
 
   num_cycles n = instruction(gb, op);
+  gameboy_advance(gb, n);
 
   return n;
 }
 
+/*
+ * Hands the samples of the frame `gb->apu` just closed to the sink, on
+ * whichever thread synthesizes
+ */
+void gameboy_publish_audio_frame(gameboy_t* gb) {
+  if (gb->audio_sink == NULL) {
+    return;
+  }
+  // a frame is ~800 stereo samples, anything past half the buffer waits for the next one
+  int16_t samples[BLIP_CAPACITY];
+  int16_t channels[APU_CHANNEL_COUNT][BLIP_CAPACITY / 2];
+  gameboy_audio_frame_t frame = {
+      .number = gb->audio_frames++,
+      .samples = samples,
+      .frames = apu_read_samples(&gb->apu, samples, BLIP_CAPACITY / 2),
+  };
+  frame.hash = hash64(samples, frame.frames * 2 * sizeof(int16_t));
+  for (uint8_t i = 0; gb->apu.channel_outputs != NULL && i < APU_CHANNEL_COUNT; ++i) {
+    // the same number as the sides, they all started out together
+    apu_read_channel_samples(&gb->apu, i, channels[i], frame.frames);
+    frame.channels[i] = channels[i];
+  }
+  gb->audio_sink(gb->audio_sink_data, &frame);
+}
+
+static void gameboy_end_audio_frame(gameboy_t* gb) {
+  if (gb->apu_pipeline != NULL) {
+    apu_pipeline_submit(gb);
+    MEMORY_AT(NR52) = apu_status(&gb->apu_pipeline->shadow);
+    return;
+  }
+  apu_end_frame(&gb->apu);
+  MEMORY_AT(NR52) = apu_status(&gb->apu);
+  gameboy_publish_audio_frame(gb);
+}
+
+/*
+ * Runs everything clocked alongside the CPU for `cycles` M-cycles. The PPU
+ * counts dots, which do not speed up in double speed mode, so a double speed
+ * M-cycle is only half as many dots and the PPU costs the same per emulated
+ * second in either mode.
+ */
+void gameboy_advance(gameboy_t* gb, uint32_t cycles) {
+  uint32_t dots_per_cycle = gb->double_speed ? PPU_DOTS_PER_CYCLE / 2 : PPU_DOTS_PER_CYCLE;
+  ppu_step(gb, cycles * dots_per_cycle);
+  // the APU only catches up when it has to, see apu_t
+  apu_t* apu = gb->apu_pipeline != NULL ? &gb->apu_pipeline->shadow : &gb->apu;
+  apu->clock += cycles * dots_per_cycle;
+  if (apu->clock >= APU_FRAME_DOTS) {
+    gameboy_end_audio_frame(gb);
+  }
+}
+
 instruction_f fetch_instruction_from_opcode(opcode oc) {
   switch (oc) {
   default:
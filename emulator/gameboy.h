@@ -3,12 +3,31 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "../display.h"
+#include "../events/command_queue.h"
+#include "../events/frame_pacer.h"
 #include "../events/thread_events.h"
+#include "../events/triple_buffer.h"
+#include "apu.h"
+#include "ppu.h"
 
 #define MEMORY_SIZE 0xFFFF
 
+// M-cycles per second at normal speed, and the frame rate that comes out of it (~59.73 Hz)
+#define GAMEBOY_CYCLES_PER_SECOND ((PPU_CLOCK_HZ) / (PPU_DOTS_PER_CYCLE))
+#define GAMEBOY_FRAME_HZ ((double)(PPU_CLOCK_HZ) / (PPU_DOTS_PER_FRAME))
+
+#define VRAM_BANK_COUNT PPU_VRAM_BANKS
+#define WRAM_BANK_COUNT 8
+#define WRAM_BANK_SIZE 0x1000
+#define WRAM_BANK_START 0xD000
+#define PALETTE_RAM_SIZE 64
+
+// commands are picked up between blocks of this many M-cycles, one scanline
+#define GAMEBOY_COMMAND_BLOCK_CYCLES 114
+
 /*
  * The CPU houses the registers used for computations
  *
@@ -55,17 +74,145 @@ typedef struct {
   uint16_t sp;
 } cpu_t;
 
+typedef enum {
+  GAMEBOY_MODEL_DMG,
+  GAMEBOY_MODEL_CGB,
+} gameboy_model_t;
+
+/*
+ * Called with every frame right before it is published, from whichever thread
+ * publishes it. It must not hold on to `frame` or take long.
+ */
+typedef void (*gameboy_frame_sink_f)(void* data, const frame_t* frame);
+
+/*
+ * The samples of one APU frame, only valid during the sink call
+ */
+typedef struct {
+  uint64_t number;
+  // interleaved stereo
+  const int16_t* samples;
+  size_t frames;
+  // hash64 of `samples`, compared across runs the same way as frame_t's
+  uint64_t hash;
+  // each channel on its own, NULL unless the APU has channel outputs
+  const int16_t* channels[APU_CHANNEL_COUNT];
+} gameboy_audio_frame_t;
+
+/*
+ * Called on the emulator thread with every APU frame as it closes, or on the
+ * APU thread while that runs. Without a sink the samples pile up in the APU,
+ * which drops the oldest once it runs out of room.
+ */
+typedef void (*gameboy_audio_sink_f)(void* data, const gameboy_audio_frame_t* frame);
+
+/*
+ * What other threads can ask of a running emulator through gameboy_send. The
+ * thread running it acts on them in order between blocks of instructions.
+ */
+typedef enum {
+  // `value`: every JOYPAD_* key held from now on
+  GAMEBOY_COMMAND_JOYPAD,
+  GAMEBOY_COMMAND_PAUSE,
+  GAMEBOY_COMMAND_RESUME,
+  // `data`: the gameboy_state_t to save into or load from, the sender leaves it alone until the emulator is done with it
+  GAMEBOY_COMMAND_SAVE_STATE,
+  GAMEBOY_COMMAND_LOAD_STATE,
+  // `ratio`: as for gameboy_set_speed
+  GAMEBOY_COMMAND_SPEED,
+  // gameboy_run_thread returns
+  GAMEBOY_COMMAND_SHUTDOWN,
+} gameboy_command_type_t;
+
+typedef struct {
+  uint64_t applied;
+  // from the push to the emulator acting on it
+  uint64_t latency_total_ns;
+  uint64_t latency_max_ns;
+  // save and load states turned down because a pipeline was running
+  uint64_t refused;
+} gameboy_command_stats_t;
+
 typedef struct {
   uint8_t memory[MEMORY_SIZE];
-  pixel_color_t screen[SCREEN_SIZE];
+  // where the PPU draws the frame in progress: the back buffer of `frames`,
+  // or the pixels of the current log while the pipeline runs
+  pixel_shade_t* screen;
+  triple_buffer_t frames;
+  gameboy_frame_sink_f frame_sink;
+  void* frame_sink_data;
+  gameboy_audio_sink_f audio_sink;
+  void* audio_sink_data;
+  uint64_t audio_frames;
   uint32_t clock_speed;
-  thread_event_t clock_tick;
+  // paces the emulator thread a frame at a time
+  frame_pacer_t pacer;
+  // the same for a caller that runs the emulator itself, see gameboy_run_elapsed
+  uint64_t run_clock_ns;
+  // billionths of an M-cycle still owed, negative when the last instruction ran over
+  int64_t run_credit;
+  uint64_t run_skipped_ns;
+  // to the thread running the emulator, only it touches what follows
+  command_queue_t commands;
+  gameboy_command_stats_t command_stats;
+  bool paused;
+  bool stopped;
+  // after STOP the system clock is held until a key is pressed
+  bool low_power;
+  // JOYPAD_* held
+  uint8_t buttons;
   cpu_t cpu;
+  ppu_t ppu;
+  apu_t apu;
+  // NULL unless the APU runs on its own thread, which then owns `apu`
+  apu_pipeline_t* apu_pipeline;
+
+  /*
+   * CGB state. Banked memory stays in the flat memory map: the mapped bank
+   * is what sits in `memory` and switching banks copies. VRAM banks are kept
+   * current on every write since the PPU reads them directly, WRAM banks only
+   * hold what was there when they were last mapped out.
+   */
+  gameboy_model_t model;
+  bool double_speed;
+  uint8_t vram_bank;
+  uint8_t wram_bank;
+  uint8_t vram[VRAM_BANK_COUNT][PPU_VRAM_BYTES];
+  // bank 0 is fixed at 0xC000 - 0xCFFF, its slot is unused
+  uint8_t wram[WRAM_BANK_COUNT][WRAM_BANK_SIZE];
+  uint8_t bg_palettes[PALETTE_RAM_SIZE];
+  uint8_t obj_palettes[PALETTE_RAM_SIZE];
 } gameboy_t;
 
+/*
+ * The emulated machine as a save state keeps it: memory, CPU, PPU, APU and the
+ * CGB banks, but not the host's side of things like how fast it runs or which
+ * keys are held. The PPU keeps its caches, they match the VRAM saved with it.
+ */
+typedef struct {
+  uint8_t memory[MEMORY_SIZE];
+  cpu_t cpu;
+  bool low_power;
+  ppu_t ppu;
+  apu_t apu;
+  gameboy_model_t model;
+  bool double_speed;
+  uint8_t vram_bank;
+  uint8_t wram_bank;
+  uint8_t vram[VRAM_BANK_COUNT][PPU_VRAM_BYTES];
+  uint8_t wram[WRAM_BANK_COUNT][WRAM_BANK_SIZE];
+  uint8_t bg_palettes[PALETTE_RAM_SIZE];
+  uint8_t obj_palettes[PALETTE_RAM_SIZE];
+} gameboy_state_t;
+
 bool gameboy_init(gameboy_t* gb);
+void gameboy_set_model(gameboy_t* gb, gameboy_model_t model);
+void gameboy_set_speed(gameboy_t* gb, double ratio);
+void gameboy_set_frame_sink(gameboy_t* gb, gameboy_frame_sink_f sink, void* data);
+void gameboy_set_audio_sink(gameboy_t* gb, gameboy_audio_sink_f sink, void* data);
 bool gameboy_load_rom(gameboy_t* gb, const char* rom_path);
 void* gameboy_run_thread(void* args);
+bool gameboy_send(gameboy_t* gb, command_t command);
 
 typedef uint8_t opcode;
 typedef uint8_t num_cycles;
@@ -90,11 +237,54 @@ typedef uint16_t* register16_p;
 #define N (gb->memory[gb->cpu.pc + 1])
 #define NN (*(uint16_t*)&gb->memory[gb->cpu.pc + 1])
 #define MEMORY_AT(X) (gb->memory[(X)])
+#define MEMORY_WRITE(X, V) (memory_write(gb, (X), (V)))
 
 /*
  * Important Registers
  */
 
+/*
+ * Interrupt request flags, a bit is set by the hardware raising the interrupt
+ */
+#define INTERRUPT_FLAG 0xFF0F
+#define INTERRUPT_VBLANK (1 << 0)
+#define INTERRUPT_STAT (1 << 1)
+#define INTERRUPT_JOYPAD (1 << 4)
+
+/*
+ * Joypad. Writing bit 4 low selects the direction keys, bit 5 low the
+ * buttons, and bits 0-3 read low for the selected keys held. A selected key
+ * going down requests INTERRUPT_JOYPAD.
+ */
+#define P1 0xFF00
+#define P1_SELECT_DIRECTIONS (1 << 4)
+#define P1_SELECT_BUTTONS (1 << 5)
+#define P1_KEYS 0x0F
+
+// the keys in GAMEBOY_COMMAND_JOYPAD, directions in the low nibble and buttons in the high one the way P1 reads them
+#define JOYPAD_RIGHT (1 << 0)
+#define JOYPAD_LEFT (1 << 1)
+#define JOYPAD_UP (1 << 2)
+#define JOYPAD_DOWN (1 << 3)
+#define JOYPAD_A (1 << 4)
+#define JOYPAD_B (1 << 5)
+#define JOYPAD_SELECT (1 << 6)
+#define JOYPAD_START (1 << 7)
+
+/*
+ * What P1 reads with `buttons` held and the select bits of `select`
+ */
+static inline uint8_t joypad_register(uint8_t buttons, uint8_t select) {
+  uint8_t held = 0;
+  if (!(select & P1_SELECT_DIRECTIONS)) {
+    held |= buttons & P1_KEYS;
+  }
+  if (!(select & P1_SELECT_BUTTONS)) {
+    held |= buttons >> 4;
+  }
+  return 0xC0 | (select & (P1_SELECT_DIRECTIONS | P1_SELECT_BUTTONS)) | (~held & P1_KEYS);
+}
+
 /*
  * LCDC bits:
  *   0 - [DMG mode] 0: BG display off, 1: BG display on [CGB mode] BG display always on
@@ -107,8 +297,32 @@ typedef uint16_t* register16_p;
  *   7 - [LCD controller operation stop flag] 0: LCDC off, 1: LCDC on
  */
 #define LCDC 0xFF40
-
-#define STAT 0xFF41 // may not need
+#define LCDC_BG_ON (1 << 0)
+#define LCDC_OBJ_ON (1 << 1)
+#define LCDC_OBJ_16 (1 << 2)
+#define LCDC_BG_CODE_AREA (1 << 3)
+#define LCDC_BG_CHAR_AREA (1 << 4)
+#define LCDC_WINDOW_ON (1 << 5)
+#define LCDC_WINDOW_CODE_AREA (1 << 6)
+#define LCDC_ON (1 << 7)
+
+/*
+ * STAT bits:
+ *   0-1 - current PPU mode (read only)
+ *   2   - LYC == LY (read only)
+ *   3   - mode 0 STAT interrupt enable
+ *   4   - mode 1 STAT interrupt enable
+ *   5   - mode 2 STAT interrupt enable
+ *   6   - LYC == LY STAT interrupt enable
+ */
+#define STAT 0xFF41
+#define STAT_MODE_MASK 0x03
+#define STAT_LYC_EQUAL (1 << 2)
+#define STAT_HBLANK_INT (1 << 3)
+#define STAT_VBLANK_INT (1 << 4)
+#define STAT_OAM_INT (1 << 5)
+#define STAT_LYC_INT (1 << 6)
+#define STAT_READ_ONLY ((STAT_MODE_MASK) | (STAT_LYC_EQUAL))
 
 /*
  * Starting y-coordinate of where to render the screen
@@ -120,13 +334,50 @@ typedef uint16_t* register16_p;
  */
 #define SCX 0xFF43
 
-#define LY 0xFF44  // may not need
-#define LYC 0xFF45 //
+#define LY 0xFF44
+#define LYC 0xFF45
+
+/*
+ * Writing XX starts a transfer of 0xXX00 - 0xXX9F into OAM
+ */
+#define DMA 0xFF46
 
 #define BGP 0xFF47
 #define OBP0 0xFF48
 #define OBP1 0xFF49
 
+/*
+ * Window position, WX is offset by 7
+ */
+#define WY 0xFF4A
+#define WX 0xFF4B
+
+/*
+ * CGB speed switch. Writing bit 0 arms it and the next STOP switches, bit 7
+ * reads back the current speed.
+ */
+#define KEY1 0xFF4D
+#define KEY1_ARMED (1 << 0)
+#define KEY1_DOUBLE_SPEED (1 << 7)
+
+/*
+ * CGB VRAM bank (bit 0) and WRAM bank mapped at 0xD000 (bits 0-2, 0 selects 1)
+ */
+#define VBK 0xFF4F
+#define SVBK 0xFF70
+
+/*
+ * CGB palette RAM is reached through an index and a data register each for
+ * BG and OBJ palettes. Index bits 0-5 pick the byte, bit 7 moves it on after
+ * every write to the data register.
+ */
+#define BCPS 0xFF68
+#define BCPD 0xFF69
+#define OCPS 0xFF6A
+#define OCPD 0xFF6B
+#define PALETTE_INDEX_MASK 0x3F
+#define PALETTE_AUTO_INCREMENT (1 << 7)
+
 #define CHAR_DATA_START 0x8000
 #define CHAR_DATA_END 0x97FF
 #define CHAR_DATA_SIZE ((CHAR_DATA_END) - (CHAR_DATA_START))
@@ -163,13 +414,204 @@ typedef struct {
   uint8_t atribute_data;
 } obj_display_data_t;
 
+/*
+ * OBJ attribute bits:
+ *   0-2 - [CGB palette] OBJ palette 0-7
+ *   3   - [CGB character bank] 0: VRAM bank 0, 1: VRAM bank 1
+ *   4   - [DMG palette] 0: OBP0, 1: OBP1
+ *   5   - [horizontal flip]
+ *   6   - [vertical flip]
+ *   7   - [BG priority] 0: OBJ above BG, 1: OBJ behind BG colors 1-3
+ */
+#define OBJ_ATTR_CGB_PALETTE 0x07
+#define OBJ_ATTR_BANK (1 << 3)
+#define OBJ_ATTR_PALETTE (1 << 4)
+#define OBJ_ATTR_X_FLIP (1 << 5)
+#define OBJ_ATTR_Y_FLIP (1 << 6)
+#define OBJ_ATTR_BG_PRIORITY (1 << 7)
+
+/*
+ * CGB BG map attribute bits, kept in VRAM bank 1 at the address of the tile
+ * number they go with:
+ *   0-2 - [palette] BG palette 0-7
+ *   3   - [character bank] 0: VRAM bank 0, 1: VRAM bank 1
+ *   5   - [horizontal flip]
+ *   6   - [vertical flip]
+ *   7   - [priority] 1: colors 1-3 stay above objects
+ */
+#define BG_ATTR_PALETTE 0x07
+#define BG_ATTR_BANK (1 << 3)
+#define BG_ATTR_X_FLIP (1 << 5)
+#define BG_ATTR_Y_FLIP (1 << 6)
+#define BG_ATTR_PRIORITY (1 << 7)
+
+/*
+ * Tells a set of PPU caches that the VRAM/OAM byte at `address` changed,
+ * `bank` is the VRAM bank and 0 for OAM
+ */
+static inline void ppu_caches_written(ppu_caches_t* caches, uint8_t bank, uint16_t address) {
+  if (address >= CHAR_DATA_START && address <= BG_DATA_2_END) {
+    caches->vram_generation += 1;
+  }
+  if (address >= CHAR_DATA_START && address <= CHAR_DATA_END) {
+    uint16_t tile = bank * TILE_COUNT + (address - CHAR_DATA_START) / TILE_BYTES;
+    caches->tiles.dirty[tile / 64] |= 1ull << (tile % 64);
+  } else if (address >= OAM_START && address < OAM_START + PPU_OAM_BYTES) {
+    caches->objs.dirty_objs |= 1ull << ((address - OAM_START) / OBJ_BYTES);
+  }
+}
+
+static inline void ppu_video_written(gameboy_t* gb, uint8_t bank, uint16_t address, uint8_t value) {
+  ppu_caches_written(&gb->ppu.caches, bank, address);
+  if (gb->ppu.log != NULL) {
+    ppu_log_write(gb->ppu.log, bank, address, value);
+  }
+}
+
+static inline void palette_write(gameboy_t* gb, uint16_t index_register, uint8_t* palettes, uint8_t value) {
+  uint8_t index = MEMORY_AT(index_register);
+  palettes[index & PALETTE_INDEX_MASK] = value;
+  if (index & PALETTE_AUTO_INCREMENT) {
+    index = (index & ~PALETTE_INDEX_MASK) | ((index + 1) & PALETTE_INDEX_MASK);
+    MEMORY_AT(index_register) = index;
+  }
+  // the data register reads back whatever the index points at
+  MEMORY_AT(index_register + 1) = palettes[index & PALETTE_INDEX_MASK];
+}
+
+static inline void cgb_register_write(gameboy_t* gb, uint16_t address, uint8_t value) {
+  switch (address) {
+  case KEY1:
+    MEMORY_AT(KEY1) = (value & KEY1_ARMED) | (MEMORY_AT(KEY1) & KEY1_DOUBLE_SPEED);
+    break;
+  case VBK:
+    value &= VRAM_BANK_COUNT - 1;
+    if (value != gb->vram_bank) {
+      memcpy(&MEMORY_AT(CHAR_DATA_START), gb->vram[value], PPU_VRAM_BYTES);
+      gb->vram_bank = value;
+    }
+    MEMORY_AT(VBK) = value;
+    break;
+  case SVBK:
+    value &= WRAM_BANK_COUNT - 1;
+    if (value == 0) {
+      value = 1;
+    }
+    if (value != gb->wram_bank) {
+      memcpy(gb->wram[gb->wram_bank], &MEMORY_AT(WRAM_BANK_START), WRAM_BANK_SIZE);
+      memcpy(&MEMORY_AT(WRAM_BANK_START), gb->wram[value], WRAM_BANK_SIZE);
+      gb->wram_bank = value;
+    }
+    MEMORY_AT(SVBK) = value;
+    break;
+  case BCPS:
+    MEMORY_AT(BCPS) = value;
+    MEMORY_AT(BCPD) = gb->bg_palettes[value & PALETTE_INDEX_MASK];
+    break;
+  case OCPS:
+    MEMORY_AT(OCPS) = value;
+    MEMORY_AT(OCPD) = gb->obj_palettes[value & PALETTE_INDEX_MASK];
+    break;
+  case BCPD:
+    palette_write(gb, BCPS, gb->bg_palettes, value);
+    break;
+  case OCPD:
+    palette_write(gb, OCPS, gb->obj_palettes, value);
+    break;
+  }
+}
+
+/*
+ * All CPU-side writes go through here so that the PPU caches hear about
+ * VRAM changes and the registers with side effects get them.
+ */
+static inline void memory_write(gameboy_t* gb, uint16_t address, uint8_t value) {
+  if (address >= CHAR_DATA_START && address <= BG_DATA_2_END) {
+    gb->vram[gb->vram_bank][address - CHAR_DATA_START] = value;
+    ppu_video_written(gb, gb->vram_bank, address, value);
+  } else if (address >= OAM_START && address < OAM_START + PPU_OAM_BYTES) {
+    ppu_video_written(gb, 0, address, value);
+  } else if (address >= APU_REGISTERS_START && address <= APU_REGISTERS_END) {
+    apu_t* apu = &gb->apu;
+    if (gb->apu_pipeline != NULL) {
+      // the APU thread makes the write at the same dot, the shadow answers the reads
+      apu_log_write(gb->apu_pipeline, address, value);
+      apu = &gb->apu_pipeline->shadow;
+    }
+    apu_write(apu, address, value);
+    // writes while powered off are ignored, and powering off clears the registers
+    if (address == NR52) {
+      memcpy(&MEMORY_AT(APU_REGISTERS_START), apu->registers, NR52 - APU_REGISTERS_START);
+    } else {
+      MEMORY_AT(address) = apu->registers[address - APU_REGISTERS_START];
+    }
+    // NR52 reads back which channels are playing
+    MEMORY_AT(NR52) = apu_status(apu);
+    return;
+  }
+  switch (address) {
+  case P1:
+    value = joypad_register(gb->buttons, value);
+    break;
+  case STAT:
+    value = (value & ~STAT_READ_ONLY) | (MEMORY_AT(STAT) & STAT_READ_ONLY);
+    break;
+  case LY:
+    return;
+  case DMA:
+    for (uint16_t i = 0; i < PPU_OAM_BYTES; ++i) {
+      uint8_t byte = MEMORY_AT((value << 8) + i);
+      if (MEMORY_AT(OAM_START + i) != byte) {
+        MEMORY_AT(OAM_START + i) = byte;
+        ppu_video_written(gb, 0, OAM_START + i, byte);
+      }
+    }
+    break;
+  case KEY1:
+  case VBK:
+  case SVBK:
+  case BCPS:
+  case BCPD:
+  case OCPS:
+  case OCPD:
+    if (gb->model == GAMEBOY_MODEL_CGB) {
+      cgb_register_write(gb, address, value);
+      return;
+    }
+    break;
+  }
+  MEMORY_AT(address) = value;
+}
+
+void ppu_init(gameboy_t* gb);
+void ppu_set_renderer(gameboy_t* gb, ppu_renderer_t renderer);
+void ppu_set_frame_skip(gameboy_t* gb, ppu_frame_skip_mode_t mode, uint8_t interval);
+void ppu_step(gameboy_t* gb, uint32_t dots);
+void ppu_palette_colors(const gameboy_t* gb, uint16_t colors[CGB_COLOR_COUNT]);
+uint64_t ppu_frame_hash(const frame_t* frame);
+void ppu_fifo_begin_line(gameboy_t* gb);
+bool ppu_fifo_tick(gameboy_t* gb, pixel_shade_t line[SCREEN_WIDTH]);
+bool ppu_pipeline_start(gameboy_t* gb, uint8_t workers);
+void ppu_pipeline_stop(gameboy_t* gb);
+void ppu_pipeline_flush(gameboy_t* gb);
+void ppu_pipeline_submit(gameboy_t* gb);
+ppu_pipeline_stats_t ppu_pipeline_stats(gameboy_t* gb);
+bool apu_pipeline_start(gameboy_t* gb);
+void apu_pipeline_stop(gameboy_t* gb);
+void apu_pipeline_flush(gameboy_t* gb);
+void apu_pipeline_submit(gameboy_t* gb);
+apu_pipeline_stats_t apu_pipeline_stats(gameboy_t* gb);
+void gameboy_publish_audio_frame(gameboy_t* gb);
+
 void* display_driver_thread(void* args);
 
 typedef struct {
   gameboy_t* gb;
 } gameboy_thread_args_t;
 void* gameboy_run_thread(void* args);
+uint64_t gameboy_run_elapsed(gameboy_t* gb, uint64_t now_ns);
 num_cycles gameboy_emulate_cycle(gameboy_t* gb);
+void gameboy_advance(gameboy_t* gb, uint32_t cycles);
 
 typedef num_cycles (*instruction_f)(gameboy_t* gb, opcode op8);
 instruction_f fetch_instruction_from_opcode(opcode oc8);
@@ -2243,4 +2685,23 @@ num_cycles AND_H(gameboy_t* gb, opcode op8);
  */
 num_cycles AND_L(gameboy_t* gb, opcode op8);
 
+/*
+ * CPU control instructions
+ */
+
+/*
+ * Instruction: STOP
+ *
+ * Action: On a CGB with KEY1 armed, switches between normal and double
+ *         speed. Otherwise stops the system clock until a button is pressed.
+ *         Either way the byte after the opcode is skipped.
+ *
+ * Flags: None
+ *
+ * Cycles: 1
+ *
+ * Opcode: 0x10 0x00
+ */
+num_cycles STOP(gameboy_t* gb, opcode op8);
+
 #endif // !DEBUG
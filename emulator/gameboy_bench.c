@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gameboy.h"
+
+/*
+ * Compares what an emulated second costs on a DMG, on a CGB at normal speed
+ * and on a CGB in double speed. The CPU core cannot run cartridges yet, so a
+ * stand-in instruction stream advances the scheduler by typical instruction
+ * lengths and makes the kind of WRAM/VRAM writes and bank switches a game
+ * would.
+ */
+
+#define BENCH_SECONDS 2
+#define BENCH_REPEATS 3
+#define BENCH_SWITCHES 100000
+
+typedef struct {
+  const char* name;
+  gameboy_model_t model;
+  bool double_speed;
+} bench_mode_t;
+
+static const bench_mode_t modes[] = {
+    {     "dmg", GAMEBOY_MODEL_DMG, false},
+    {  "cgb 1x", GAMEBOY_MODEL_CGB, false},
+    {  "cgb 2x", GAMEBOY_MODEL_CGB,  true},
+};
+
+// M-cycles of a plausible run of instructions
+static const uint8_t instruction_cycles[] = {1, 2, 3, 2, 4, 1, 2, 3};
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_setup(gameboy_t* gb, const bench_mode_t* mode) {
+  gameboy_init(gb);
+  gameboy_set_model(gb, mode->model);
+  uint32_t seed = 1;
+  for (uint16_t address = CHAR_DATA_START; address <= BG_DATA_2_END; ++address) {
+    seed = seed * 1103515245 + 12345;
+    memory_write(gb, address, seed >> 16);
+  }
+  for (uint8_t i = 0; i < OBJ_COUNT; ++i) {
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 0, 16 + i * 3);
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 1, 8 + i * 4);
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 2, i);
+  }
+  memory_write(gb, BGP, 0xE4);
+  memory_write(gb, OBP0, 0xD2);
+  memory_write(gb, LCDC, LCDC_ON | LCDC_BG_ON | LCDC_BG_CHAR_AREA | LCDC_OBJ_ON);
+  if (mode->double_speed) {
+    memory_write(gb, KEY1, KEY1_ARMED);
+    STOP(gb, 0x10);
+  }
+}
+
+/*
+ * One emulated second of instructions: a WRAM write every 8th, a VRAM write
+ * every 64th and, on a CGB, a WRAM bank switch every 4096th
+ */
+static void bench_second(gameboy_t* gb, const bench_mode_t* mode) {
+  uint32_t cycles = mode->double_speed ? GAMEBOY_CYCLES_PER_SECOND * 2 : GAMEBOY_CYCLES_PER_SECOND;
+  uint32_t done = 0;
+  for (uint32_t i = 0; done < cycles; ++i) {
+    uint8_t n = instruction_cycles[i % sizeof(instruction_cycles)];
+    if (i % 8 == 0) {
+      memory_write(gb, 0xC000 + (i >> 3) % 0x2000, i);
+    }
+    if (i % 64 == 0) {
+      memory_write(gb, CHAR_DATA_START + (i >> 6) % CHAR_DATA_SIZE, i);
+    }
+    if (mode->model == GAMEBOY_MODEL_CGB && i % 4096 == 0) {
+      memory_write(gb, SVBK, 1 + (i >> 12) % 7);
+    }
+    gameboy_advance(gb, n);
+    done += n;
+  }
+}
+
+static void bench_switches(gameboy_t* gb) {
+  bench_setup(gb, &modes[1]);
+  double start = bench_now_ns();
+  for (int i = 0; i < BENCH_SWITCHES; ++i) {
+    memory_write(gb, SVBK, 1 + i % 7);
+  }
+  double svbk = (bench_now_ns() - start) / BENCH_SWITCHES;
+  start = bench_now_ns();
+  for (int i = 0; i < BENCH_SWITCHES; ++i) {
+    memory_write(gb, VBK, i & 1);
+  }
+  double vbk = (bench_now_ns() - start) / BENCH_SWITCHES;
+  printf("\nbank switch  SVBK %6.0f ns  VBK %6.0f ns\n", svbk, vbk);
+}
+
+int main(void) {
+  gameboy_t* gb = malloc(sizeof(gameboy_t));
+  if (gb == NULL) {
+    return 1;
+  }
+
+  printf("%-8s %14s %10s %10s %10s\n", "mode", "ns/emu second", "frames", "vs dmg", "realtime");
+  double dmg_ns = 0;
+  for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+    double best = 0;
+    uint64_t frames = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+      bench_setup(gb, &modes[m]);
+      double start = bench_now_ns();
+      for (int second = 0; second < BENCH_SECONDS; ++second) {
+        bench_second(gb, &modes[m]);
+      }
+      double ns = (bench_now_ns() - start) / BENCH_SECONDS;
+      if (repeat == 0 || ns < best) {
+        best = ns;
+      }
+      frames = gb->ppu.frames;
+    }
+    if (m == 0) {
+      dmg_ns = best;
+    }
+    printf("%-8s %14.0f %10lu %9.2fx %9.0fx\n", modes[m].name, best, (unsigned long)frames, best / dmg_ns, 1e9 / best);
+  }
+
+  bench_switches(gb);
+  free(gb);
+  return 0;
+}
@@ -265,8 +265,7 @@ num_cycles ADD_A_n(gameboy_t* gb, opcode op8);
 num_cycles ADD_A__HL(gameboy_t* gb, opcode op8);
 
 num_cycles LD__HL_n(gameboy_t* gb, opcode op8) {
-  memory_at mdest = MEMORY_AT(HL);
-  mdest = N;
+  MEMORY_WRITE(HL, N);
   PC += sizeof(N);
   return 3;
 }
@@ -287,7 +286,7 @@ num_cycles LD_A__C(gameboy_t* gb, opcode op8) {
 }
 
 num_cycles LD__C_A(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(0xFF00 + C) = A;
+  MEMORY_WRITE(0xFF00 + C, A);
   return 2;
 }
 
@@ -298,7 +297,7 @@ num_cycles LD_A__n(gameboy_t* gb, opcode op8) {
 }
 
 num_cycles LD__n_A(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(0xFF00 + N) = A;
+  MEMORY_WRITE(0xFF00 + N, A);
   PC += sizeof(N);
   return 3;
 }
@@ -311,7 +310,7 @@ num_cycles LD_A__nn(gameboy_t* gb, opcode op8) {
 }
 
 num_cycles LD__nn_A(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(NN) = A;
+  MEMORY_WRITE(NN, A);
   PC += sizeof(NN);
 
   return 4;
@@ -330,23 +329,23 @@ num_cycles LD_A__HLD(gameboy_t* gb, opcode op8) {
 }
 
 num_cycles LD__BC_A(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(BC) = A;
+  MEMORY_WRITE(BC, A);
   return 2;
 }
 
 num_cycles LD__DE_A(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(DE) = A;
+  MEMORY_WRITE(DE, A);
   return 2;
 }
 
 num_cycles LD__HLI_A(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(HL) = A;
+  MEMORY_WRITE(HL, A);
   HL += 1;
   return 2;
 }
 
 num_cycles LD_HLI_D(gameboy_t* gb, opcode op8) {
-  MEMORY_AT(HL) = A;
+  MEMORY_WRITE(HL, A);
   HL -= 1;
   return 2;
 }
@@ -399,3 +398,17 @@ num_cycles PUSH_AF(gameboy_t* gb, opcode op8) {
   *(uint16_t*)&MEMORY_AT(SP) = AF;
   return 4;
 }
+
+num_cycles STOP(gameboy_t* gb, opcode op8) {
+  if (gb->model == GAMEBOY_MODEL_CGB && (MEMORY_AT(KEY1) & KEY1_ARMED)) {
+    gb->double_speed = !gb->double_speed;
+    MEMORY_AT(KEY1) = gb->double_speed ? KEY1_DOUBLE_SPEED : 0;
+    // M-cycles come twice as fast, the dot clock the PPU runs on does not change
+    gb->clock_speed = gb->double_speed ? gb->clock_speed * 2 : gb->clock_speed / 2;
+  } else {
+    // until a key pressed pulls a selected P1 line low, see gameboy_set_buttons
+    gb->low_power = true;
+  }
+  PC += sizeof(N);
+  return 1;
+}
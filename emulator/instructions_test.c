@@ -17,3 +17,82 @@ Test(macros, dotheywork) {
 
   cr_assert(eq(u8, gb.cpu.a, gb.memory[0xBBCC]));
 }
+
+Test(cgb, stop_switches_speed_when_armed) {
+  static gameboy_t gb = {0};
+  gb.model = GAMEBOY_MODEL_CGB;
+  gb.clock_speed = 1000;
+
+  STOP(&gb, 0x10);
+  cr_assert(not(gb.double_speed));
+  cr_assert(gb.low_power);
+
+  gb.low_power = false;
+  memory_write(&gb, KEY1, KEY1_ARMED);
+  STOP(&gb, 0x10);
+  cr_assert(gb.double_speed);
+  cr_assert(eq(u8, gb.memory[KEY1], KEY1_DOUBLE_SPEED));
+  cr_assert(eq(u32, gb.clock_speed, 2000));
+  cr_assert(not(gb.low_power));
+}
+
+Test(cpu, stop_skips_its_operand_and_powers_down) {
+  static gameboy_t gb = {0};
+  gb.cpu.pc = 0x0150;
+
+  STOP(&gb, 0x10);
+  cr_assert(gb.low_power);
+  cr_assert(eq(u16, gb.cpu.pc, 0x0151));
+}
+
+Test(cgb, banks_swap_through_the_memory_map) {
+  static gameboy_t gb = {0};
+  gb.model = GAMEBOY_MODEL_CGB;
+  gb.wram_bank = 1;
+
+  memory_write(&gb, 0xD000, 0x11);
+  memory_write(&gb, SVBK, 3);
+  memory_write(&gb, 0xD000, 0x33);
+  memory_write(&gb, SVBK, 0);
+  cr_assert(eq(u8, gb.memory[0xD000], 0x11));
+  memory_write(&gb, SVBK, 3);
+  cr_assert(eq(u8, gb.memory[0xD000], 0x33));
+
+  memory_write(&gb, 0x8000, 0xA0);
+  memory_write(&gb, VBK, 1);
+  memory_write(&gb, 0x8000, 0xA1);
+  cr_assert(eq(u8, gb.vram[0][0], 0xA0));
+  cr_assert(eq(u8, gb.vram[1][0], 0xA1));
+  memory_write(&gb, VBK, 0);
+  cr_assert(eq(u8, gb.memory[0x8000], 0xA0));
+}
+
+Test(cgb, palette_index_auto_increments) {
+  static gameboy_t gb = {0};
+  gb.model = GAMEBOY_MODEL_CGB;
+
+  memory_write(&gb, BCPS, PALETTE_AUTO_INCREMENT | (PALETTE_RAM_SIZE - 1));
+  memory_write(&gb, BCPD, 0x12);
+  memory_write(&gb, BCPD, 0x34);
+  cr_assert(eq(u8, gb.bg_palettes[PALETTE_RAM_SIZE - 1], 0x12));
+  cr_assert(eq(u8, gb.bg_palettes[0], 0x34));
+  cr_assert(eq(u8, gb.memory[BCPS], PALETTE_AUTO_INCREMENT | 1));
+
+  memory_write(&gb, OCPS, 5);
+  memory_write(&gb, OCPD, 0x56);
+  cr_assert(eq(u8, gb.obj_palettes[5], 0x56));
+  cr_assert(eq(u8, gb.memory[OCPS], 5));
+  cr_assert(eq(u8, gb.memory[OCPD], 0x56));
+}
+
+Test(joypad, p1_reads_the_selected_keys) {
+  static gameboy_t gb = {0};
+  gb.buttons = JOYPAD_UP | JOYPAD_START;
+
+  memory_write(&gb, P1, P1_SELECT_BUTTONS);
+  cr_assert(eq(u8, gb.memory[P1], 0xC0 | P1_SELECT_BUTTONS | (P1_KEYS & ~JOYPAD_UP)));
+  memory_write(&gb, P1, P1_SELECT_DIRECTIONS);
+  cr_assert(eq(u8, gb.memory[P1], 0xC0 | P1_SELECT_DIRECTIONS | (P1_KEYS & ~(JOYPAD_START >> 4))));
+  memory_write(&gb, P1, P1_SELECT_DIRECTIONS | P1_SELECT_BUTTONS);
+  cr_assert(eq(u8, gb.memory[P1], 0xFF));
+}
@@ -0,0 +1,664 @@
+#include <string.h>
+#include <time.h>
+
+#include "../hash.h"
+#include "gameboy.h"
+
+#define WINDOW_X_OFFSET 7
+#define WINDOW_X_MAX 166
+#define OBJ_Y_OFFSET 16
+#define OBJ_X_OFFSET 8
+#define OBJ_X_HIDDEN 168
+#define OBJ_FETCH_DOTS 6
+#define WINDOW_FETCH_DOTS 6
+#define FRAME_SKIP_LOAD_HIGH(T) ((T) * 95 / 100)
+#define FRAME_SKIP_LOAD_LOW(T) ((T) * 70 / 100)
+
+void ppu_caches_init(ppu_caches_t* caches, const uint8_t* vram, const uint8_t* oam) {
+  caches->vram = vram;
+  caches->oam = oam;
+  ppu_caches_invalidate(caches);
+}
+
+void ppu_caches_invalidate(ppu_caches_t* caches) {
+  memset(caches->tiles.dirty, 0xFF, sizeof(caches->tiles.dirty));
+  // never zero, so a plane row that was never drawn cannot match
+  caches->vram_generation = (caches->vram_generation + 1) | 1;
+  caches->objs.dirty_objs = (1ull << OBJ_COUNT) - 1;
+}
+
+static void tile_decode(ppu_caches_t* caches, uint16_t tile) {
+  const uint8_t* data = &caches->vram[(tile / TILE_COUNT) * PPU_VRAM_BYTES + (tile % TILE_COUNT) * TILE_BYTES];
+  for (uint8_t row = 0; row < TILE_SIZE; ++row) {
+    uint8_t lo = data[row * 2];
+    uint8_t hi = data[row * 2 + 1];
+    uint8_t* dots = caches->tiles.dots[tile][row];
+    for (uint8_t x = 0; x < TILE_SIZE; ++x) {
+      uint8_t shift = TILE_SIZE - 1 - x;
+      dots[x] = ((lo >> shift) & 1) | (((hi >> shift) & 1) << 1);
+    }
+  }
+}
+
+const uint8_t* ppu_tile_row(ppu_caches_t* caches, uint16_t tile, uint8_t row) {
+  uint64_t bit = 1ull << (tile % 64);
+  if (caches->tiles.dirty[tile / 64] & bit) {
+    tile_decode(caches, tile);
+    caches->tiles.version[tile] += 1;
+    caches->tiles.dirty[tile / 64] &= ~bit;
+  }
+  return caches->tiles.dots[tile][row];
+}
+
+/*
+ * Copies a decoded tile into the plane cell at `cell_row`, `column`, flipped
+ * and marked with its palette and priority as the CGB map attributes say
+ */
+static void bg_plane_copy_cell(ppu_bg_plane_t* plane, const uint8_t dots[TILE_SIZE][TILE_SIZE], uint8_t attribute, uint8_t cell_row, uint8_t column) {
+  uint8_t marks = (attribute & BG_ATTR_PALETTE) << PPU_BG_PALETTE_SHIFT | ((attribute & BG_ATTR_PRIORITY) ? PPU_BG_PRIORITY : 0);
+  for (uint8_t row = 0; row < TILE_SIZE; ++row) {
+    const uint8_t* source = dots[(attribute & BG_ATTR_Y_FLIP) ? TILE_SIZE - 1 - row : row];
+    uint8_t* dest = &plane->dots[cell_row * TILE_SIZE + row][column * TILE_SIZE];
+    if (attribute == 0) {
+      memcpy(dest, source, TILE_SIZE);
+      continue;
+    }
+    for (uint8_t x = 0; x < TILE_SIZE; ++x) {
+      dest[x] = source[(attribute & BG_ATTR_X_FLIP) ? TILE_SIZE - 1 - x : x] | marks;
+    }
+  }
+}
+
+static void bg_plane_sync_row(ppu_caches_t* caches, ppu_bg_plane_t* plane, uint8_t lcdc, uint8_t map, uint8_t cell_row) {
+  uint16_t map_offset = (map ? BG_DATA_2_START : BG_DATA_1_START) - CHAR_DATA_START + cell_row * MAP_WIDTH;
+  const uint8_t* codes = &caches->vram[map_offset];
+  // bank 1 holds the attributes at the same address
+  const uint8_t* attributes = &caches->vram[PPU_VRAM_BYTES + map_offset];
+  for (uint8_t column = 0; column < MAP_WIDTH; ++column) {
+    uint16_t cell = cell_row * MAP_WIDTH + column;
+    uint8_t attribute = caches->cgb ? attributes[column] : 0;
+    uint16_t tile = ppu_bg_tile_index(lcdc, codes[column]) + ((attribute & BG_ATTR_BANK) ? TILE_COUNT : 0);
+    // decodes the tile first if it is dirty, which moves its version on
+    ppu_tile_row(caches, tile, 0);
+    if (plane->tile[cell] == tile && plane->attributes[cell] == attribute && plane->version[cell] == caches->tiles.version[tile]) {
+      continue;
+    }
+    bg_plane_copy_cell(plane, caches->tiles.dots[tile], attribute, cell_row, column);
+    plane->tile[cell] = tile;
+    plane->attributes[cell] = attribute;
+    plane->version[cell] = caches->tiles.version[tile];
+  }
+}
+
+const uint8_t* ppu_bg_plane_row(ppu_caches_t* caches, uint8_t lcdc, uint8_t map, uint8_t map_y) {
+  ppu_bg_plane_t* plane = &caches->planes[map];
+  uint8_t cell_row = map_y / TILE_SIZE;
+  uint32_t key = caches->vram_generation << 1 | ((lcdc & LCDC_BG_CHAR_AREA) != 0);
+  if (plane->row_key[cell_row] != key) {
+    bg_plane_sync_row(caches, plane, lcdc, map, cell_row);
+    plane->row_key[cell_row] = key;
+  }
+  return plane->dots[map_y];
+}
+
+uint16_t ppu_bg_tile_index(uint8_t lcdc, uint8_t character_code) {
+  if (lcdc & LCDC_BG_CHAR_AREA) {
+    return character_code;
+  }
+  // 0x8800 - 0x97FF addressing treats the code as signed around 0x9000
+  return character_code < 128 ? 256 + character_code : character_code;
+}
+
+const uint8_t* ppu_obj_row(ppu_caches_t* caches, uint8_t lcdc, uint8_t ly, uint8_t index) {
+  const obj_display_data_t* obj = &((const obj_display_data_t*)caches->oam)[index];
+  uint8_t height = (lcdc & LCDC_OBJ_16) ? TILE_SIZE * 2 : TILE_SIZE;
+  uint8_t row = ly + OBJ_Y_OFFSET - obj->y;
+  if (obj->atribute_data & OBJ_ATTR_Y_FLIP) {
+    row = height - 1 - row;
+  }
+  uint16_t tile = obj->character_code;
+  if (height > TILE_SIZE) {
+    tile = (tile & 0xFE) + row / TILE_SIZE;
+  }
+  if (caches->cgb && (obj->atribute_data & OBJ_ATTR_BANK)) {
+    tile += TILE_COUNT;
+  }
+  return ppu_tile_row(caches, tile, row % TILE_SIZE);
+}
+
+static void obj_buckets_mark(ppu_obj_buckets_t* buckets, uint8_t index, int16_t top, bool insert, bool remove) {
+  int first = top < 0 ? 0 : top;
+  int last = top + (buckets->tall ? TILE_SIZE * 2 : TILE_SIZE);
+  if (last > SCREEN_HEIGHT) {
+    last = SCREEN_HEIGHT;
+  }
+  uint64_t bit = 1ull << index;
+  for (int ly = first; ly < last; ++ly) {
+    if (insert) {
+      buckets->lines[ly] |= bit;
+    }
+    if (remove) {
+      buckets->lines[ly] &= ~bit;
+    }
+    buckets->dirty_lines[ly / 64] |= 1ull << (ly % 64);
+  }
+}
+
+static void obj_buckets_update(ppu_caches_t* caches, uint8_t lcdc) {
+  ppu_obj_buckets_t* buckets = &caches->objs;
+  bool tall = lcdc & LCDC_OBJ_16;
+  bool resized = tall != buckets->tall;
+  if (resized) {
+    buckets->dirty_objs = (1ull << OBJ_COUNT) - 1;
+  }
+  uint64_t dirty = buckets->dirty_objs;
+  if (dirty == 0) {
+    return;
+  }
+  buckets->dirty_objs = 0;
+
+  // a write to the tile or attributes changes neither the selection nor its order
+  uint64_t moved = 0;
+  for (uint64_t pending = dirty; pending != 0; pending &= pending - 1) {
+    uint8_t index = __builtin_ctzll(pending);
+    const obj_display_data_t* obj = &((const obj_display_data_t*)caches->oam)[index];
+    int16_t top = obj->y - OBJ_Y_OFFSET;
+    bool inserted = buckets->inserted & (1ull << index);
+    if (!resized && inserted && top == buckets->top[index]) {
+      if (obj->x != buckets->x[index]) {
+        buckets->x[index] = obj->x;
+        obj_buckets_mark(buckets, index, top, false, false);
+      }
+      continue;
+    }
+    // entries leave with the size they were inserted with and come back with the current one
+    if (inserted) {
+      obj_buckets_mark(buckets, index, buckets->top[index], false, true);
+    }
+    buckets->top[index] = top;
+    buckets->x[index] = obj->x;
+    moved |= 1ull << index;
+  }
+  buckets->tall = tall;
+  for (uint64_t pending = moved; pending != 0; pending &= pending - 1) {
+    uint8_t index = __builtin_ctzll(pending);
+    obj_buckets_mark(buckets, index, buckets->top[index], true, false);
+  }
+  buckets->inserted |= moved;
+}
+
+/*
+ * The hardware takes the first ten entries in OAM order that cover the line,
+ * the list is then kept in drawing priority: lower x first, equal x stays in
+ * OAM order.
+ */
+static void obj_buckets_select(ppu_caches_t* caches, uint8_t ly) {
+  const obj_display_data_t* oam = (const obj_display_data_t*)caches->oam;
+  ppu_line_objs_t* objs = &caches->objs.selected[ly];
+  objs->count = 0;
+  for (uint64_t pending = caches->objs.lines[ly]; pending != 0 && objs->count < OBJ_PER_LINE; pending &= pending - 1) {
+    uint8_t index = __builtin_ctzll(pending);
+    uint8_t slot = objs->count++;
+    while (slot > 0 && oam[objs->index[slot - 1]].x > oam[index].x) {
+      objs->index[slot] = objs->index[slot - 1];
+      slot -= 1;
+    }
+    objs->index[slot] = index;
+  }
+}
+
+void ppu_oam_scan(ppu_caches_t* caches, uint8_t lcdc, uint8_t ly, ppu_line_objs_t* objs) {
+  if (ly >= SCREEN_HEIGHT) {
+    objs->count = 0;
+    return;
+  }
+  obj_buckets_update(caches, lcdc);
+  uint64_t bit = 1ull << (ly % 64);
+  if (caches->objs.dirty_lines[ly / 64] & bit) {
+    obj_buckets_select(caches, ly);
+    caches->objs.dirty_lines[ly / 64] &= ~bit;
+  }
+  *objs = caches->objs.selected[ly];
+}
+
+/*
+ * Estimate of mode 3 length for the scanline renderer, following the usual
+ * breakdown: 172 dots, plus the SCX fine scroll, plus 6 for the window, plus
+ * 6 per object and however long it waits for the background fetch to finish.
+ */
+uint16_t ppu_transfer_dots(const ppu_caches_t* caches, const ppu_registers_t* registers, const ppu_line_objs_t* objs, bool window) {
+  const obj_display_data_t* oam = (const obj_display_data_t*)caches->oam;
+  uint16_t dots = PPU_TRANSFER_MIN_DOTS + (registers->scx % TILE_SIZE);
+  if (window) {
+    dots += WINDOW_FETCH_DOTS;
+  }
+  if (!(registers->lcdc & LCDC_OBJ_ON)) {
+    return dots;
+  }
+  for (uint8_t i = 0; i < objs->count; ++i) {
+    uint8_t x = oam[objs->index[i]].x;
+    if (x >= OBJ_X_HIDDEN) {
+      continue;
+    }
+    int wait = 5 - ((x + registers->scx) % TILE_SIZE);
+    dots += OBJ_FETCH_DOTS + (x == 0 ? 5 : (wait > 0 ? wait : 0));
+  }
+  return dots;
+}
+
+pixel_shade_t ppu_mix_pixel(uint8_t lcdc, uint8_t bgp, uint8_t obp0, uint8_t obp1, uint8_t bg_color, ppu_fifo_obj_t obj) {
+  if (!(lcdc & LCDC_BG_ON)) {
+    // DMG blanks the background and window to white, objects still draw over it
+    bg_color = 0;
+  }
+  if ((lcdc & LCDC_OBJ_ON) && obj.color != 0 && !((obj.attributes & OBJ_ATTR_BG_PRIORITY) && bg_color != 0)) {
+    uint8_t palette = (obj.attributes & OBJ_ATTR_PALETTE) ? obp1 : obp0;
+    return (palette >> (obj.color * 2)) & 0x03;
+  }
+  if (!(lcdc & LCDC_BG_ON)) {
+    return 0;
+  }
+  return (bgp >> (bg_color * 2)) & 0x03;
+}
+
+/*
+ * On a CGB LCDC bit 0 no longer blanks the background. Cleared, it puts
+ * objects above everything, set, colors 1-3 of the background stay in front
+ * of an object when either the map attributes or the object ask for it.
+ */
+pixel_shade_t ppu_mix_cgb_pixel(uint8_t lcdc, uint8_t bg, ppu_fifo_obj_t obj) {
+  bool bg_above = (lcdc & LCDC_BG_ON) && (bg & PPU_BG_COLOR) != 0 && ((bg & PPU_BG_PRIORITY) || (obj.attributes & OBJ_ATTR_BG_PRIORITY));
+  if ((lcdc & LCDC_OBJ_ON) && obj.color != 0 && !bg_above) {
+    return CGB_PIXEL_OBJ | (obj.attributes & OBJ_ATTR_CGB_PALETTE) << PPU_BG_PALETTE_SHIFT | obj.color;
+  }
+  return bg & PPU_BG_PIXEL;
+}
+
+/*
+ * Copies `count` color numbers out of a plane row starting at `map_x`,
+ * wrapping around at 256 like the hardware does.
+ */
+static void copy_plane_span(const uint8_t* row, uint8_t map_x, uint8_t* out, int count) {
+  int first = SCREEN_DATA_WIDTH - map_x;
+  if (first >= count) {
+    memcpy(out, row + map_x, count);
+    return;
+  }
+  memcpy(out, row + map_x, first);
+  memcpy(out + first, row, count - first);
+}
+
+void ppu_render_scanline(ppu_caches_t* caches, const ppu_registers_t* registers, const ppu_line_objs_t* objs, bool window, uint8_t window_line,
+                         pixel_shade_t line[SCREEN_WIDTH]) {
+  uint8_t lcdc = registers->lcdc;
+  bool cgb = caches->cgb;
+  uint8_t bg[SCREEN_WIDTH];
+  ppu_fifo_obj_t obj[SCREEN_WIDTH] = {0};
+
+  int window_start = SCREEN_WIDTH;
+  if (window) {
+    window_start = registers->wx < WINDOW_X_OFFSET ? 0 : registers->wx - WINDOW_X_OFFSET;
+  }
+  if (cgb || (lcdc & LCDC_BG_ON)) {
+    uint8_t map_y = registers->ly + registers->scy;
+    copy_plane_span(ppu_bg_plane_row(caches, lcdc, (lcdc & LCDC_BG_CODE_AREA) != 0, map_y), registers->scx, bg, window_start);
+    if (window_start < SCREEN_WIDTH) {
+      uint8_t window_x = registers->wx < WINDOW_X_OFFSET ? WINDOW_X_OFFSET - registers->wx : 0;
+      const uint8_t* row = ppu_bg_plane_row(caches, lcdc, (lcdc & LCDC_WINDOW_CODE_AREA) != 0, window_line);
+      memcpy(bg + window_start, row + window_x, SCREEN_WIDTH - window_start);
+    }
+  } else {
+    // blanked, ppu_mix_pixel ignores the color anyway
+    memset(bg, 0, sizeof(bg));
+  }
+
+  if (lcdc & LCDC_OBJ_ON) {
+    const obj_display_data_t* oam = (const obj_display_data_t*)caches->oam;
+    for (uint8_t i = 0; i < objs->count; ++i) {
+      const obj_display_data_t* o = &oam[objs->index[i]];
+      const uint8_t* dots = ppu_obj_row(caches, lcdc, registers->ly, objs->index[i]);
+      bool flip = o->atribute_data & OBJ_ATTR_X_FLIP;
+      for (int px = 0; px < TILE_SIZE; ++px) {
+        int x = o->x - OBJ_X_OFFSET + px;
+        uint8_t color = dots[flip ? TILE_SIZE - 1 - px : px];
+        if (x < 0 || x >= SCREEN_WIDTH || color == 0) {
+          continue;
+        }
+        // earlier objects have priority, later ones only fill their gaps. A CGB goes by OAM order alone.
+        if (obj[x].color != 0 && !(cgb && objs->index[i] < obj[x].index)) {
+          continue;
+        }
+        obj[x] = (ppu_fifo_obj_t){
+            .color = color,
+            .attributes = o->atribute_data,
+            .index = objs->index[i],
+        };
+      }
+    }
+  }
+
+  if ((lcdc & LCDC_OBJ_ON) && objs->count > 0) {
+    for (int x = 0; x < SCREEN_WIDTH; ++x) {
+      line[x] = cgb ? ppu_mix_cgb_pixel(lcdc, bg[x], obj[x]) : ppu_mix_pixel(lcdc, registers->bgp, registers->obp0, registers->obp1, bg[x], obj[x]);
+    }
+    return;
+  }
+  if (cgb) {
+    for (int x = 0; x < SCREEN_WIDTH; ++x) {
+      line[x] = bg[x] & PPU_BG_PIXEL;
+    }
+    return;
+  }
+  // nothing to mix in, the line is just the background through BGP
+  pixel_shade_t shades[4] = {0};
+  if (lcdc & LCDC_BG_ON) {
+    for (uint8_t color = 0; color < 4; ++color) {
+      shades[color] = (registers->bgp >> (color * 2)) & 0x03;
+    }
+  }
+  for (int x = 0; x < SCREEN_WIDTH; ++x) {
+    line[x] = shades[bg[x]];
+  }
+}
+
+void ppu_init(gameboy_t* gb) {
+  memset(&gb->ppu, 0, sizeof(gb->ppu));
+  gb->ppu.renderer = PPU_RENDERER_SCANLINE;
+  ppu_caches_init(&gb->ppu.caches, gb->vram[0], &MEMORY_AT(OAM_START));
+  gb->ppu.caches.cgb = gb->model == GAMEBOY_MODEL_CGB;
+}
+
+/*
+ * Palette RAM as 15-bit colors, BG palettes first, in the order
+ * pixel_shade_t indexes them
+ */
+void ppu_palette_colors(const gameboy_t* gb, uint16_t colors[CGB_COLOR_COUNT]) {
+  for (uint8_t i = 0; i < CGB_COLOR_COUNT / 2; ++i) {
+    colors[i] = gb->bg_palettes[i * 2] | gb->bg_palettes[i * 2 + 1] << 8;
+    colors[CGB_COLOR_COUNT / 2 + i] = gb->obj_palettes[i * 2] | gb->obj_palettes[i * 2 + 1] << 8;
+  }
+}
+
+uint64_t ppu_frame_hash(const frame_t* frame) {
+  uint64_t hash = hash64(frame->pixels, sizeof(frame->pixels));
+  if (frame->cgb) {
+    // the same pixels in other colors are another frame
+    hash ^= hash64(frame->colors, sizeof(frame->colors));
+  }
+  return hash;
+}
+
+void ppu_set_renderer(gameboy_t* gb, ppu_renderer_t renderer) {
+  // picked up at the start of the next mode 3, a line is never split between renderers
+  gb->ppu.renderer = renderer;
+}
+
+void ppu_set_frame_skip(gameboy_t* gb, ppu_frame_skip_mode_t mode, uint8_t interval) {
+  ppu_frame_skip_t* frame_skip = &gb->ppu.frame_skip;
+  *frame_skip = (ppu_frame_skip_t){
+      .mode = mode,
+      .interval = interval < 1 ? 1 : interval,
+      .current = mode == PPU_FRAME_SKIP_FIXED ? interval : 1,
+      .target_ns = PPU_FRAME_NS,
+  };
+  if (frame_skip->current < 1) {
+    frame_skip->current = 1;
+  }
+}
+
+static uint64_t thread_cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void ppu_frame_begin(ppu_t* ppu) {
+  ppu_frame_skip_t* frame_skip = &ppu->frame_skip;
+  if (frame_skip->mode == PPU_FRAME_SKIP_OFF) {
+    ppu->skip_frame = false;
+    return;
+  }
+  if (frame_skip->countdown == 0) {
+    frame_skip->countdown = frame_skip->current;
+  }
+  frame_skip->countdown -= 1;
+  // the last frame of every interval is the one that gets drawn
+  ppu->skip_frame = frame_skip->countdown != 0;
+}
+
+static void ppu_frame_end(gameboy_t* gb) {
+  ppu_t* ppu = &gb->ppu;
+  ppu_frame_skip_t* frame_skip = &ppu->frame_skip;
+  ppu->frames += 1;
+  if (ppu->skip_frame) {
+    frame_skip->skipped += 1;
+  }
+  if (ppu->pipeline != NULL) {
+    // the workers publish it, skipped or not they still need its writes
+    ppu_pipeline_submit(gb);
+  } else if (!ppu->skip_frame) {
+    frame_t* frame = triple_buffer_back(&gb->frames);
+    frame->number = ppu->frames;
+    // palettes written while the frame was drawn show up as they were at its end
+    frame->cgb = ppu->caches.cgb;
+    if (frame->cgb) {
+      ppu_palette_colors(gb, frame->colors);
+    }
+    frame->hash = ppu_frame_hash(frame);
+    if (gb->frame_sink != NULL) {
+      gb->frame_sink(gb->frame_sink_data, frame);
+    }
+    triple_buffer_publish(&gb->frames);
+    gb->screen = triple_buffer_back(&gb->frames)->pixels;
+  }
+  if (frame_skip->mode != PPU_FRAME_SKIP_ADAPTIVE) {
+    return;
+  }
+
+  uint64_t now = thread_cpu_ns();
+  if (frame_skip->last_cpu_ns != 0) {
+    // moving average over roughly eight frames
+    frame_skip->load_ns = frame_skip->load_ns - frame_skip->load_ns / 8 + (now - frame_skip->last_cpu_ns) / 8;
+    if (frame_skip->load_ns > FRAME_SKIP_LOAD_HIGH(frame_skip->target_ns) && frame_skip->current < frame_skip->interval) {
+      frame_skip->current += 1;
+    } else if (frame_skip->load_ns < FRAME_SKIP_LOAD_LOW(frame_skip->target_ns) && frame_skip->current > 1) {
+      frame_skip->current -= 1;
+    }
+  }
+  frame_skip->last_cpu_ns = now;
+}
+
+static void ppu_latch_registers(gameboy_t* gb, ppu_registers_t* registers) {
+  *registers = (ppu_registers_t){
+      .lcdc = MEMORY_AT(LCDC),
+      .stat = MEMORY_AT(STAT),
+      .scy = MEMORY_AT(SCY),
+      .scx = MEMORY_AT(SCX),
+      .ly = gb->ppu.ly,
+      .lyc = MEMORY_AT(LYC),
+      .bgp = MEMORY_AT(BGP),
+      .obp0 = MEMORY_AT(OBP0),
+      .obp1 = MEMORY_AT(OBP1),
+      .wy = MEMORY_AT(WY),
+      .wx = MEMORY_AT(WX),
+  };
+}
+
+/*
+ * Publishes mode, LY and the coincidence flag, and raises the STAT
+ * interrupt on a rising edge of the combined interrupt line.
+ */
+static void ppu_update_stat(gameboy_t* gb) {
+  ppu_t* ppu = &gb->ppu;
+  uint8_t stat = (MEMORY_AT(STAT) & ~STAT_READ_ONLY) | ppu->mode;
+  if (ppu->ly == MEMORY_AT(LYC)) {
+    stat |= STAT_LYC_EQUAL;
+  }
+  MEMORY_AT(STAT) = stat;
+  MEMORY_AT(LY) = ppu->ly;
+
+  bool line = ((stat & STAT_LYC_EQUAL) && (stat & STAT_LYC_INT)) || (ppu->mode == PPU_MODE_HBLANK && (stat & STAT_HBLANK_INT)) ||
+              (ppu->mode == PPU_MODE_VBLANK && (stat & STAT_VBLANK_INT)) || (ppu->mode == PPU_MODE_OAM_SCAN && (stat & STAT_OAM_INT));
+  if (line && !ppu->stat_line) {
+    MEMORY_AT(INTERRUPT_FLAG) |= INTERRUPT_STAT;
+  }
+  ppu->stat_line = line;
+}
+
+static void ppu_enter_oam_scan(gameboy_t* gb) {
+  ppu_t* ppu = &gb->ppu;
+  ppu->mode = PPU_MODE_OAM_SCAN;
+  if (ppu->ly == MEMORY_AT(WY)) {
+    ppu->window_triggered = true;
+  }
+  ppu_update_stat(gb);
+}
+
+static void ppu_enter_transfer(gameboy_t* gb) {
+  ppu_t* ppu = &gb->ppu;
+  ppu->mode = PPU_MODE_TRANSFER;
+  ppu->line_renderer = ppu->renderer;
+  ppu_latch_registers(gb, &ppu->registers);
+  ppu_oam_scan(&ppu->caches, ppu->registers.lcdc, ppu->ly, &ppu->line_objs);
+
+  if (ppu->line_renderer == PPU_RENDERER_FIFO) {
+    // mode 3 lasts until the FIFO has pushed out the whole line
+    ppu->transfer_dots = 0;
+    ppu_fifo_begin_line(gb);
+  } else {
+    ppu_registers_t* registers = &ppu->registers;
+    ppu->window_drawn = (registers->lcdc & LCDC_WINDOW_ON) && ppu->window_triggered && registers->wx <= WINDOW_X_MAX;
+    ppu->transfer_dots = ppu_transfer_dots(&ppu->caches, registers, &ppu->line_objs, ppu->window_drawn);
+    if (ppu->skip_frame) {
+      // nothing to draw
+    } else if (ppu->log != NULL && !ppu->log->overflow) {
+      ppu->log->lines[ppu->ly] = (ppu_log_line_t){
+          .deferred = true,
+          .registers = *registers,
+          .objs = ppu->line_objs,
+          .window = ppu->window_drawn,
+          .window_line = ppu->window_line,
+          .writes = ppu->log->write_count,
+      };
+    } else {
+      ppu_render_scanline(&ppu->caches, registers, &ppu->line_objs, ppu->window_drawn, ppu->window_line, &gb->screen[ppu->ly * SCREEN_WIDTH]);
+    }
+  }
+  ppu_update_stat(gb);
+}
+
+static void ppu_enter_hblank(gameboy_t* gb) {
+  ppu_t* ppu = &gb->ppu;
+  ppu->mode = PPU_MODE_HBLANK;
+  if (ppu->window_drawn) {
+    ppu->window_line += 1;
+  }
+  ppu_update_stat(gb);
+}
+
+static void ppu_next_line(gameboy_t* gb) {
+  ppu_t* ppu = &gb->ppu;
+  ppu->dot = 0;
+  ppu->ly += 1;
+  if (ppu->ly == SCREEN_HEIGHT) {
+    ppu->mode = PPU_MODE_VBLANK;
+    ppu_frame_end(gb);
+    MEMORY_AT(INTERRUPT_FLAG) |= INTERRUPT_VBLANK;
+    ppu_update_stat(gb);
+    return;
+  }
+  if (ppu->ly == PPU_LINES_PER_FRAME) {
+    ppu->ly = 0;
+    ppu->window_line = 0;
+    ppu->window_triggered = false;
+    ppu_frame_begin(ppu);
+  }
+  if (ppu->ly < SCREEN_HEIGHT) {
+    ppu_enter_oam_scan(gb);
+  } else {
+    ppu_update_stat(gb);
+  }
+}
+
+static uint16_t ppu_mode_end(const ppu_t* ppu) {
+  switch (ppu->mode) {
+  case PPU_MODE_OAM_SCAN:
+    return PPU_OAM_SCAN_DOTS;
+  case PPU_MODE_TRANSFER:
+    return PPU_OAM_SCAN_DOTS + ppu->transfer_dots;
+  case PPU_MODE_HBLANK:
+  case PPU_MODE_VBLANK:
+  default:
+    return PPU_DOTS_PER_LINE;
+  }
+}
+
+static void ppu_advance_mode(gameboy_t* gb) {
+  switch (gb->ppu.mode) {
+  case PPU_MODE_OAM_SCAN:
+    ppu_enter_transfer(gb);
+    break;
+  case PPU_MODE_TRANSFER:
+    ppu_enter_hblank(gb);
+    break;
+  case PPU_MODE_HBLANK:
+  case PPU_MODE_VBLANK:
+    ppu_next_line(gb);
+    break;
+  }
+}
+
+/*
+ * Advances the PPU by `dots`. Outside of a FIFO mode 3 this jumps straight
+ * from one mode change to the next instead of walking every dot.
+ */
+void ppu_step(gameboy_t* gb, uint32_t dots) {
+  ppu_t* ppu = &gb->ppu;
+  if (!(MEMORY_AT(LCDC) & LCDC_ON)) {
+    if (ppu->enabled) {
+      ppu->enabled = false;
+      ppu->ly = 0;
+      ppu->dot = 0;
+      ppu->mode = PPU_MODE_HBLANK;
+      ppu_update_stat(gb);
+    }
+    return;
+  }
+  if (!ppu->enabled) {
+    ppu->enabled = true;
+    ppu->ly = 0;
+    ppu->dot = 0;
+    ppu->window_line = 0;
+    ppu->window_triggered = false;
+    if (ppu->log != NULL) {
+      // lines from before the LCD went off would replay out of order
+      for (uint8_t ly = 0; ly < SCREEN_HEIGHT; ++ly) {
+        ppu->log->lines[ly].deferred = false;
+      }
+    }
+    ppu_frame_begin(ppu);
+    ppu_enter_oam_scan(gb);
+  }
+
+  while (dots > 0) {
+    if (ppu->mode == PPU_MODE_TRANSFER && ppu->line_renderer == PPU_RENDERER_FIFO) {
+      ppu->dot += 1;
+      dots -= 1;
+      if (ppu_fifo_tick(gb, &gb->screen[ppu->ly * SCREEN_WIDTH])) {
+        ppu->transfer_dots = ppu->dot - PPU_OAM_SCAN_DOTS;
+        ppu_enter_hblank(gb);
+      }
+      continue;
+    }
+    uint16_t end = ppu_mode_end(ppu);
+    uint32_t step = end - ppu->dot;
+    if (step > dots) {
+      step = dots;
+    }
+    ppu->dot += step;
+    dots -= step;
+    if (ppu->dot == end) {
+      ppu_advance_mode(gb);
+    }
+  }
+}
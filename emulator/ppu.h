@@ -0,0 +1,367 @@
+#ifndef EMULATOR_PPU_H
+#define EMULATOR_PPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../display.h"
+#include "../events/thread_events.h"
+
+/*
+ * PPU timing is counted in dots. One machine cycle is four dots, a scanline
+ * is 456 dots and a frame is 154 scanlines, the last 10 of which are VBlank.
+ *
+ * Every visible line goes through three modes:
+ *
+ *   mode 2 (OAM scan)   80 dots
+ *   mode 3 (transfer)   172 to ~289 dots depending on SCX, the window and objects
+ *   mode 0 (HBlank)     whatever is left of the 456
+ *
+ * Lines 144-153 are spent entirely in mode 1 (VBlank).
+ */
+#define PPU_DOTS_PER_CYCLE 4
+#define PPU_DOTS_PER_LINE 456
+#define PPU_LINES_PER_FRAME 154
+#define PPU_DOTS_PER_FRAME ((PPU_DOTS_PER_LINE) * (PPU_LINES_PER_FRAME))
+#define PPU_OAM_SCAN_DOTS 80
+#define PPU_TRANSFER_MIN_DOTS 172
+#define PPU_CLOCK_HZ 4194304
+#define PPU_FRAME_NS (((uint64_t)PPU_DOTS_PER_FRAME * 1000000000) / (PPU_CLOCK_HZ))
+
+// per VRAM bank, a CGB has two
+#define TILE_COUNT 384
+#define TILE_SIZE 8
+#define TILE_BYTES 16
+
+#define MAP_COUNT 2
+#define MAP_WIDTH 32
+#define MAP_CELLS ((MAP_WIDTH) * (MAP_WIDTH))
+
+#define OBJ_COUNT 40
+#define OBJ_BYTES 4
+#define OBJ_PER_LINE 10
+
+#define PPU_VRAM_BYTES 0x2000
+#define PPU_VRAM_BANKS 2
+#define PPU_OAM_BYTES ((OBJ_COUNT) * (OBJ_BYTES))
+#define PPU_PIPELINE_DEPTH 2
+#define PPU_PIPELINE_MAX_WORKERS 4
+#define PPU_LOG_WRITES 0x10000
+
+typedef enum {
+  PPU_MODE_HBLANK = 0,
+  PPU_MODE_VBLANK = 1,
+  PPU_MODE_OAM_SCAN = 2,
+  PPU_MODE_TRANSFER = 3,
+} ppu_mode_t;
+
+/*
+ * SCANLINE renders a whole line at the start of mode 3 from the registers as
+ * they are at that moment, and estimates the length of mode 3. It is the fast
+ * path and is correct for anything that only changes registers between lines.
+ *
+ * FIFO steps the background/object pixel FIFOs one dot at a time, so writes to
+ * SCX, palettes or LCDC in the middle of mode 3 land on the right pixel and
+ * mode 3 is exactly as long as the fetches make it.
+ */
+typedef enum {
+  PPU_RENDERER_SCANLINE,
+  PPU_RENDERER_FIFO,
+} ppu_renderer_t;
+
+typedef enum {
+  PPU_FRAME_SKIP_OFF,
+  PPU_FRAME_SKIP_FIXED,
+  PPU_FRAME_SKIP_ADAPTIVE,
+} ppu_frame_skip_mode_t;
+
+/*
+ * A skipped frame still goes through every mode change, interrupt, OAM scan
+ * and window line, so nothing the CPU can observe changes. It just never
+ * fetches tile data, mixes pixels or touches the screen.
+ *
+ * FIXED draws one frame out of every `interval`. ADAPTIVE moves `current`
+ * between 1 and `interval`, skipping more while the thread running the PPU
+ * spends more than 95% of `target_ns` of CPU time per frame and less again
+ * once it drops under 70%.
+ */
+typedef struct {
+  ppu_frame_skip_mode_t mode;
+  uint8_t interval;
+  uint8_t current;
+  uint8_t countdown;
+  uint64_t target_ns;
+  uint64_t last_cpu_ns;
+  uint64_t load_ns;
+  uint64_t skipped;
+} ppu_frame_skip_t;
+
+/*
+ * The LCD registers as seen by a renderer, LCDC through WX
+ */
+typedef struct {
+  uint8_t lcdc;
+  uint8_t stat;
+  uint8_t scy;
+  uint8_t scx;
+  uint8_t ly;
+  uint8_t lyc;
+  uint8_t bgp;
+  uint8_t obp0;
+  uint8_t obp1;
+  uint8_t wy;
+  uint8_t wx;
+} ppu_registers_t;
+
+/*
+ * Character data decoded to one color number (0-3) per dot, the tiles of
+ * bank 1 following those of bank 0. VRAM writes only mark a tile dirty, it is
+ * decoded again the next time a renderer touches it. `version` counts decodes
+ * so that copies of a tile can tell they are stale.
+ */
+typedef struct {
+  uint8_t dots[TILE_COUNT * PPU_VRAM_BANKS][TILE_SIZE][TILE_SIZE];
+  uint32_t version[TILE_COUNT * PPU_VRAM_BANKS];
+  uint64_t dirty[TILE_COUNT * PPU_VRAM_BANKS / 64];
+} tile_cache_t;
+
+/*
+ * What a CGB keeps of the background for every dot, in the planes, the
+ * background FIFO and the line being drawn: the color number, the palette
+ * from the map attributes and whether the attributes put it over objects.
+ * The low five bits are the pixel as pixel_shade_t has it.
+ */
+#define PPU_BG_COLOR 0x03
+#define PPU_BG_PALETTE_SHIFT 2
+#define PPU_BG_PIXEL 0x1F
+#define PPU_BG_PRIORITY (1 << 7)
+
+/*
+ * One tile map (0x9800 or 0x9C00) rendered out to its full 256x256 plane of
+ * color numbers, used by both the background and the window. On a CGB the
+ * map attributes in bank 1 are applied on the way in, see PPU_BG_COLOR.
+ *
+ * A row of cells is only looked at again when VRAM has been written or the
+ * character area in LCDC has flipped since it was last drawn from, and then
+ * only cells whose tile changed, either because the map entry points at a
+ * different tile or attributes or the tile was decoded again, are copied in.
+ */
+typedef struct {
+  uint8_t dots[SCREEN_DATA_HEIGHT][SCREEN_DATA_WIDTH];
+  uint16_t tile[MAP_CELLS];
+  uint8_t attributes[MAP_CELLS];
+  uint32_t version[MAP_CELLS];
+  uint32_t row_key[MAP_WIDTH];
+} ppu_bg_plane_t;
+
+/*
+ * Objects selected for one line by the OAM scan, as OAM indices sorted into
+ * drawing priority: lower x first, ties broken by the lower OAM index.
+ */
+typedef struct {
+  uint8_t count;
+  uint8_t index[OBJ_PER_LINE];
+} ppu_line_objs_t;
+
+/*
+ * OAM bucketed by line. `lines` has a bit per OAM entry covering each visible
+ * line. OAM writes only mark their entry dirty: on the next scan dirty entries
+ * that changed y are moved between buckets, and only the lines they left or
+ * joined (or, for a change of x, the lines they sit on) have their object list
+ * selected again. Changing the object size moves every entry.
+ */
+typedef struct {
+  uint64_t lines[SCREEN_HEIGHT];
+  int16_t top[OBJ_COUNT];
+  uint8_t x[OBJ_COUNT];
+  uint64_t inserted;
+  uint64_t dirty_objs;
+  uint64_t dirty_lines[(SCREEN_HEIGHT + 63) / 64];
+  bool tall;
+  ppu_line_objs_t selected[SCREEN_HEIGHT];
+} ppu_obj_buckets_t;
+
+/*
+ * State that belongs to the data rather than to either renderer
+ */
+typedef struct {
+  const uint8_t* vram; // 0x8000 - 0x9FFF of bank 0, then of bank 1
+  const uint8_t* oam;  // 0xFE00 - 0xFE9F
+  // draw with the CGB's attributes, palettes and priorities
+  bool cgb;
+  tile_cache_t tiles;
+  ppu_obj_buckets_t objs;
+  // bumped by every VRAM write
+  uint32_t vram_generation;
+  ppu_bg_plane_t planes[MAP_COUNT];
+} ppu_caches_t;
+
+/*
+ * Parallel pipeline. While it runs, the thread stepping the PPU does not draw
+ * the scanline renderer's lines. It latches each line's registers and object
+ * list into a frame log, next to every VRAM/OAM write made in between, and
+ * at VBlank hands the log to the workers.
+ *
+ * Each worker keeps its own copy of VRAM/OAM and its own caches, replays the
+ * writes in order up to each line and draws its band of lines with
+ * ppu_render_scanline, so the frame comes out exactly as it would inline.
+ * Lines the FIFO renderer draws are still drawn on the PPU thread, straight
+ * into the log.
+ *
+ * A log that fills up stops recording, the rest of its lines are drawn on the
+ * PPU thread and the next log carries a full copy of VRAM/OAM to resync the
+ * workers from. With PPU_PIPELINE_DEPTH logs the PPU waits at VBlank while the
+ * workers still hold the one it needs next, so they never fall further than
+ * one frame behind.
+ */
+typedef struct {
+  uint16_t address;
+  uint8_t bank;
+  uint8_t value;
+} ppu_log_write_t;
+
+typedef struct {
+  // left for the workers, lines drawn on the PPU thread are not
+  bool deferred;
+  ppu_registers_t registers;
+  ppu_line_objs_t objs;
+  bool window;
+  uint8_t window_line;
+  // writes made before this line's mode 3
+  uint32_t writes;
+} ppu_log_line_t;
+
+typedef struct {
+  uint64_t number;
+  uint64_t submitted_ns;
+  bool skipped;
+  bool overflow;
+  bool resync;
+  uint8_t vram[PPU_VRAM_BANKS][PPU_VRAM_BYTES];
+  uint8_t oam[PPU_OAM_BYTES];
+  // palette RAM when the frame ended, see frame_t
+  bool cgb;
+  uint16_t colors[CGB_COLOR_COUNT];
+  uint32_t write_count;
+  ppu_log_write_t writes[PPU_LOG_WRITES];
+  ppu_log_line_t lines[SCREEN_HEIGHT];
+  pixel_shade_t pixels[SCREEN_SIZE];
+  // workers that have not finished with this log yet
+  uint8_t pending;
+} ppu_frame_log_t;
+
+typedef struct {
+  pthread_t thread;
+  uint8_t first_line;
+  uint8_t last_line;
+  uint64_t done;
+  uint8_t vram[PPU_VRAM_BANKS][PPU_VRAM_BYTES];
+  uint8_t oam[PPU_OAM_BYTES];
+  ppu_caches_t caches;
+} ppu_worker_t;
+
+typedef struct {
+  uint64_t frames;
+  // times the PPU had to wait at VBlank for a free log
+  uint64_t stalls;
+  uint64_t overflows;
+  // from the end of a frame's last line to its publication
+  uint64_t latency_total_ns;
+  uint64_t latency_max_ns;
+} ppu_pipeline_stats_t;
+
+typedef struct {
+  thread_event_t event;
+  bool stopping;
+  uint8_t worker_count;
+  ppu_worker_t workers[PPU_PIPELINE_MAX_WORKERS];
+  // frames handed to the workers, and frames every worker has finished
+  uint64_t submitted;
+  uint64_t completed;
+  ppu_frame_log_t logs[PPU_PIPELINE_DEPTH];
+  ppu_pipeline_stats_t stats;
+} ppu_pipeline_t;
+
+static inline void ppu_log_write(ppu_frame_log_t* log, uint8_t bank, uint16_t address, uint8_t value) {
+  if (log->write_count == PPU_LOG_WRITES) {
+    log->overflow = true;
+    return;
+  }
+  log->writes[log->write_count++] = (ppu_log_write_t){
+      .address = address,
+      .bank = bank,
+      .value = value,
+  };
+}
+
+typedef struct {
+  uint8_t color;
+  uint8_t attributes;
+  // OAM index, which decides between overlapping objects on a CGB
+  uint8_t index;
+} ppu_fifo_obj_t;
+
+typedef struct {
+  // background/window FIFO, color numbers or on a CGB see PPU_BG_COLOR
+  uint8_t bg[TILE_SIZE * 2];
+  uint8_t bg_head;
+  uint8_t bg_count;
+  // object FIFO, lined up with the next pixels to leave the background FIFO
+  ppu_fifo_obj_t obj[TILE_SIZE];
+  uint8_t obj_head;
+  uint8_t obj_count;
+
+  // fetcher
+  uint8_t startup_dots;
+  uint8_t fetch_step;
+  uint8_t fetch_x;
+  uint16_t fetch_tile;
+  uint8_t fetch_attributes;
+  uint8_t fetch_row[TILE_SIZE];
+
+  // pixel output
+  uint8_t x;
+  uint8_t discard;
+  bool window_active;
+  uint8_t next_obj;
+  uint8_t obj_stall;
+} ppu_fifo_t;
+
+typedef struct {
+  ppu_renderer_t renderer;
+  ppu_renderer_t line_renderer;
+  bool enabled;
+  ppu_mode_t mode;
+  uint8_t ly;
+  uint16_t dot;
+  uint16_t transfer_dots;
+  uint8_t window_line;
+  bool window_triggered;
+  bool window_drawn;
+  bool stat_line;
+  bool skip_frame;
+  uint64_t frames;
+  ppu_frame_skip_t frame_skip;
+  ppu_registers_t registers;
+  ppu_line_objs_t line_objs;
+  ppu_fifo_t fifo;
+  ppu_caches_t caches;
+  // both NULL unless the pipeline is running
+  ppu_pipeline_t* pipeline;
+  ppu_frame_log_t* log;
+} ppu_t;
+
+void ppu_caches_init(ppu_caches_t* caches, const uint8_t* vram, const uint8_t* oam);
+void ppu_caches_invalidate(ppu_caches_t* caches);
+const uint8_t* ppu_tile_row(ppu_caches_t* caches, uint16_t tile, uint8_t row);
+const uint8_t* ppu_bg_plane_row(ppu_caches_t* caches, uint8_t lcdc, uint8_t map, uint8_t map_y);
+uint16_t ppu_bg_tile_index(uint8_t lcdc, uint8_t character_code);
+const uint8_t* ppu_obj_row(ppu_caches_t* caches, uint8_t lcdc, uint8_t ly, uint8_t index);
+void ppu_oam_scan(ppu_caches_t* caches, uint8_t lcdc, uint8_t ly, ppu_line_objs_t* objs);
+uint16_t ppu_transfer_dots(const ppu_caches_t* caches, const ppu_registers_t* registers, const ppu_line_objs_t* objs, bool window);
+pixel_shade_t ppu_mix_pixel(uint8_t lcdc, uint8_t bgp, uint8_t obp0, uint8_t obp1, uint8_t bg_color, ppu_fifo_obj_t obj);
+pixel_shade_t ppu_mix_cgb_pixel(uint8_t lcdc, uint8_t bg, ppu_fifo_obj_t obj);
+void ppu_render_scanline(ppu_caches_t* caches, const ppu_registers_t* registers, const ppu_line_objs_t* objs, bool window, uint8_t window_line,
+                         pixel_shade_t line[SCREEN_WIDTH]);
+
+#endif // !DEBUG
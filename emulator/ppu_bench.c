@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../hash.h"
+#include "gameboy.h"
+
+/*
+ * Renders the same scenes with both PPU renderers and reports the cost of a
+ * frame for each. The CPU core cannot run cartridges yet, so the scenes are
+ * written straight into VRAM/OAM and raster effects are poked in between
+ * lines the way a STAT handler would.
+ */
+
+#define BENCH_FRAMES 300
+#define BENCH_REPEATS 5
+
+typedef struct {
+  const char* name;
+  void (*setup)(gameboy_t* gb);
+  void (*per_line)(gameboy_t* gb, uint8_t ly);
+} bench_scene_t;
+
+static uint32_t bench_seed;
+
+static uint8_t bench_random(void) {
+  bench_seed = bench_seed * 1103515245 + 12345;
+  return bench_seed >> 16;
+}
+
+static void scene_background(gameboy_t* gb) {
+  for (uint16_t address = CHAR_DATA_START; address <= BG_DATA_2_END; ++address) {
+    memory_write(gb, address, bench_random());
+  }
+  memory_write(gb, BGP, 0xE4);
+  memory_write(gb, LCDC, LCDC_ON | LCDC_BG_ON | LCDC_BG_CHAR_AREA);
+}
+
+static void scene_window(gameboy_t* gb) {
+  scene_background(gb);
+  memory_write(gb, WY, 40);
+  memory_write(gb, WX, 87);
+  memory_write(gb, LCDC, MEMORY_AT(LCDC) | LCDC_WINDOW_ON | LCDC_WINDOW_CODE_AREA);
+}
+
+static void scene_objects(gameboy_t* gb) {
+  scene_background(gb);
+  for (uint8_t i = 0; i < OBJ_COUNT; ++i) {
+    // four bands of ten 8x16 objects, every line of a band is full
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 0, 16 + (i / OBJ_PER_LINE) * 36);
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 1, 8 + bench_random() % SCREEN_WIDTH);
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 2, bench_random());
+    memory_write(gb, OAM_START + i * OBJ_BYTES + 3, bench_random() & 0xF0);
+  }
+  memory_write(gb, OBP0, 0xD2);
+  memory_write(gb, OBP1, 0x1B);
+  memory_write(gb, LCDC, MEMORY_AT(LCDC) | LCDC_OBJ_ON | LCDC_OBJ_16);
+}
+
+#define BENCH_OAM_SOURCE 0xC000
+
+static void scene_moving_objects(gameboy_t* gb) {
+  scene_objects(gb);
+  for (uint16_t i = 0; i < OBJ_COUNT * OBJ_BYTES; ++i) {
+    memory_write(gb, BENCH_OAM_SOURCE + i, MEMORY_AT(OAM_START + i));
+  }
+}
+
+static void moving_objects_per_line(gameboy_t* gb, uint8_t ly) {
+  if (ly != SCREEN_HEIGHT) {
+    return;
+  }
+  // the usual game loop: shuffle a shadow OAM around and DMA it in during VBlank
+  for (uint8_t i = 0; i < OBJ_COUNT; ++i) {
+    uint16_t y = BENCH_OAM_SOURCE + i * OBJ_BYTES;
+    memory_write(gb, y, MEMORY_AT(y) % (SCREEN_HEIGHT + 16) + 1);
+    memory_write(gb, y + 1, MEMORY_AT(y + 1) + (i % 3) + 1);
+  }
+  memory_write(gb, DMA, BENCH_OAM_SOURCE >> 8);
+}
+
+static void raster_per_line(gameboy_t* gb, uint8_t ly) {
+  memory_write(gb, SCX, ly * 3);
+  memory_write(gb, BGP, ly & 0x10 ? 0xE4 : 0x1B);
+}
+
+static void streaming_per_line(gameboy_t* gb, uint8_t ly) {
+  // a tile row and a few map entries change every line, plus a character area swap once a frame
+  memory_write(gb, CHAR_DATA_START + bench_random() % (TILE_COUNT * TILE_BYTES), bench_random());
+  memory_write(gb, BG_DATA_1_START + bench_random() % (MAP_WIDTH * MAP_WIDTH), bench_random());
+  memory_write(gb, BG_DATA_2_START + bench_random() % (MAP_WIDTH * MAP_WIDTH), bench_random());
+  if (ly == SCREEN_HEIGHT) {
+    memory_write(gb, LCDC, MEMORY_AT(LCDC) ^ LCDC_BG_CHAR_AREA);
+  }
+}
+
+static const bench_scene_t scenes[] = {
+    {"background", scene_background, NULL},
+    {    "window",     scene_window, NULL},
+    {   "objects",    scene_objects, NULL},
+    {    "moving", scene_moving_objects, moving_objects_per_line},
+    {    "raster", scene_background, raster_per_line},
+    { "streaming",     scene_window, streaming_per_line},
+};
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// best of BENCH_REPEATS runs, the scene is rebuilt from the same seed every time
+static double bench_run(gameboy_t* gb, const bench_scene_t* scene, ppu_renderer_t renderer) {
+  double best = 0;
+  for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+    gameboy_init(gb);
+    bench_seed = 1;
+    scene->setup(gb);
+    ppu_set_renderer(gb, renderer);
+
+    double start = bench_now_ns();
+    for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+      for (uint8_t ly = 0; ly < PPU_LINES_PER_FRAME; ++ly) {
+        if (scene->per_line != NULL) {
+          scene->per_line(gb, ly);
+        }
+        ppu_step(gb, PPU_DOTS_PER_LINE);
+      }
+    }
+    double ns = (bench_now_ns() - start) / BENCH_FRAMES;
+    if (repeat == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+/*
+ * What the OAM scan costs without buckets: walk all 40 entries on every line
+ */
+static void naive_oam_scan(const uint8_t* oam, uint8_t lcdc, uint8_t ly, ppu_line_objs_t* objs) {
+  int height = (lcdc & LCDC_OBJ_16) ? 16 : 8;
+  objs->count = 0;
+  for (uint8_t i = 0; i < OBJ_COUNT && objs->count < OBJ_PER_LINE; ++i) {
+    int row = ly + 16 - oam[i * OBJ_BYTES];
+    if (row < 0 || row >= height) {
+      continue;
+    }
+    uint8_t slot = objs->count++;
+    while (slot > 0 && oam[objs->index[slot - 1] * OBJ_BYTES + 1] > oam[i * OBJ_BYTES + 1]) {
+      objs->index[slot] = objs->index[slot - 1];
+      slot -= 1;
+    }
+    objs->index[slot] = i;
+  }
+}
+
+static void bench_oam_scan(gameboy_t* gb, const bench_scene_t* scene) {
+  double naive_ns = 0;
+  double bucket_ns = 0;
+  size_t mismatched = 0;
+  gameboy_init(gb);
+  bench_seed = 1;
+  scene->setup(gb);
+  uint8_t lcdc = MEMORY_AT(LCDC);
+
+  for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+    static ppu_line_objs_t naive[SCREEN_HEIGHT];
+    static ppu_line_objs_t bucketed[SCREEN_HEIGHT];
+    if (scene->per_line != NULL) {
+      scene->per_line(gb, SCREEN_HEIGHT);
+    }
+
+    double start = bench_now_ns();
+    for (uint8_t ly = 0; ly < SCREEN_HEIGHT; ++ly) {
+      naive_oam_scan(&MEMORY_AT(OAM_START), lcdc, ly, &naive[ly]);
+    }
+    double middle = bench_now_ns();
+    for (uint8_t ly = 0; ly < SCREEN_HEIGHT; ++ly) {
+      ppu_oam_scan(&gb->ppu.caches, lcdc, ly, &bucketed[ly]);
+    }
+    bucket_ns += bench_now_ns() - middle;
+    naive_ns += middle - start;
+
+    for (uint8_t ly = 0; ly < SCREEN_HEIGHT; ++ly) {
+      mismatched += naive[ly].count != bucketed[ly].count || memcmp(naive[ly].index, bucketed[ly].index, naive[ly].count) != 0;
+    }
+  }
+  printf("%-12s %-10s %12.0f %10s %10s\n", scene->name, "oam naive", naive_ns / BENCH_FRAMES, "-", "-");
+  printf("%-12s %-10s %12.0f %9.1fx %10zu\n", scene->name, "oam bucket", bucket_ns / BENCH_FRAMES, naive_ns / bucket_ns, mismatched);
+}
+
+/*
+ * Runs a scene with and without frame skipping, recording mode 3 length and
+ * the interrupt flags of every line so timing differences show up as mismatches
+ */
+static double bench_frame_skip(gameboy_t* gb, const bench_scene_t* scene, ppu_renderer_t renderer, uint8_t interval, uint32_t* timing) {
+  gameboy_init(gb);
+  bench_seed = 1;
+  scene->setup(gb);
+  ppu_set_renderer(gb, renderer);
+  ppu_set_frame_skip(gb, PPU_FRAME_SKIP_FIXED, interval);
+
+  double start = bench_now_ns();
+  for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+    for (uint8_t ly = 0; ly < PPU_LINES_PER_FRAME; ++ly) {
+      if (scene->per_line != NULL) {
+        scene->per_line(gb, ly);
+      }
+      ppu_step(gb, PPU_DOTS_PER_LINE);
+      timing[frame * PPU_LINES_PER_FRAME + ly] = gb->ppu.transfer_dots << 8 | MEMORY_AT(INTERRUPT_FLAG);
+      MEMORY_AT(INTERRUPT_FLAG) = 0;
+    }
+  }
+  return (bench_now_ns() - start) / BENCH_FRAMES;
+}
+
+/*
+ * Steps one frame at a time, either keeping every frame in `frames` or
+ * checking every frame against them. The pipeline is flushed after each frame
+ * when checking so the frame it published is the one that just ended.
+ */
+static double bench_pipeline_run(gameboy_t* gb, const bench_scene_t* scene, uint8_t workers, pixel_shade_t* frames, size_t* mismatched) {
+  gameboy_init(gb);
+  bench_seed = 1;
+  scene->setup(gb);
+  if (workers > 0) {
+    ppu_pipeline_start(gb, workers);
+  }
+
+  double start = bench_now_ns();
+  for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+    for (uint8_t ly = 0; ly < PPU_LINES_PER_FRAME; ++ly) {
+      if (scene->per_line != NULL) {
+        scene->per_line(gb, ly);
+      }
+      ppu_step(gb, PPU_DOTS_PER_LINE);
+    }
+    if (mismatched == NULL) {
+      if (frames != NULL) {
+        memcpy(&frames[frame * SCREEN_SIZE], triple_buffer_acquire(&gb->frames, NULL)->pixels, SCREEN_SIZE);
+      }
+      continue;
+    }
+    ppu_pipeline_flush(gb);
+    const pixel_shade_t* screen = triple_buffer_acquire(&gb->frames, NULL)->pixels;
+    for (size_t p = 0; p < SCREEN_SIZE; ++p) {
+      *mismatched += frames[frame * SCREEN_SIZE + p] != screen[p];
+    }
+  }
+  ppu_pipeline_flush(gb);
+  return (bench_now_ns() - start) / BENCH_FRAMES;
+}
+
+static void bench_pipeline(gameboy_t* gb, const bench_scene_t* scene) {
+  static pixel_shade_t frames[BENCH_FRAMES * SCREEN_SIZE];
+  double inline_ns = bench_pipeline_run(gb, scene, 0, frames, NULL);
+  printf("%-12s %-8s %12.0f %10s %10s %10s %10s\n", scene->name, "inline", inline_ns, "-", "-", "-", "-");
+
+  static const uint8_t workers[] = {1, 2, 4};
+  for (size_t i = 0; i < sizeof(workers); ++i) {
+    size_t mismatched = 0;
+    bench_pipeline_run(gb, scene, workers[i], frames, &mismatched);
+    ppu_pipeline_stop(gb);
+
+    double ns = bench_pipeline_run(gb, scene, workers[i], NULL, NULL);
+    ppu_pipeline_stats_t stats = ppu_pipeline_stats(gb);
+    ppu_pipeline_stop(gb);
+    double latency_us = stats.frames > 0 ? stats.latency_total_ns / 1e3 / stats.frames : 0;
+    printf("%-12s %-6s %u %12.0f %10.1f %10.1f %10lu %10zu\n", scene->name, "pipe", workers[i], ns, latency_us, stats.latency_max_ns / 1e3,
+           (unsigned long)stats.stalls, mismatched);
+  }
+}
+
+static void bench_hash(const pixel_shade_t* screen) {
+  enum { HASH_RUNS = 10000 };
+  uint64_t sink = 0;
+  double start = bench_now_ns();
+  for (int i = 0; i < HASH_RUNS; ++i) {
+    sink += hash64(screen, SCREEN_SIZE);
+  }
+  double ns = (bench_now_ns() - start) / HASH_RUNS;
+  printf("\n%-12s %12.0f ns/frame %8.4f%% of a frame (%016llx)\n", "hash64", ns, ns * 100 / PPU_FRAME_NS, (unsigned long long)sink);
+}
+
+int main(void) {
+  static pixel_shade_t reference[SCREEN_SIZE];
+  gameboy_t* gb = malloc(sizeof(gameboy_t));
+  if (gb == NULL) {
+    return 1;
+  }
+
+  printf("%-12s %-10s %12s %10s %10s\n", "scene", "renderer", "ns/frame", "fifo/scan", "mismatch");
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+    double scanline_ns = bench_run(gb, &scenes[i], PPU_RENDERER_SCANLINE);
+    memcpy(reference, triple_buffer_acquire(&gb->frames, NULL)->pixels, sizeof(reference));
+    double fifo_ns = bench_run(gb, &scenes[i], PPU_RENDERER_FIFO);
+
+    const pixel_shade_t* screen = triple_buffer_acquire(&gb->frames, NULL)->pixels;
+    size_t mismatched = 0;
+    for (size_t p = 0; p < SCREEN_SIZE; ++p) {
+      mismatched += reference[p] != screen[p];
+    }
+    printf("%-12s %-10s %12.0f %9.1fx %10s\n", scenes[i].name, "scanline", scanline_ns, fifo_ns / scanline_ns, "-");
+    printf("%-12s %-10s %12.0f %10s %10zu\n", scenes[i].name, "fifo", fifo_ns, "-", mismatched);
+  }
+
+  printf("\n%-12s %-10s %12s %10s %10s\n", "scene", "scan", "ns/frame", "speedup", "mismatch");
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+    if (scenes[i].setup == scene_objects || scenes[i].setup == scene_moving_objects) {
+      bench_oam_scan(gb, &scenes[i]);
+    }
+  }
+
+  printf("\n%-12s %-10s %12s %10s %10s\n", "scene", "skip", "ns/frame", "speedup", "timing");
+  static uint32_t reference_timing[BENCH_FRAMES * PPU_LINES_PER_FRAME];
+  static uint32_t timing[BENCH_FRAMES * PPU_LINES_PER_FRAME];
+  static const uint8_t intervals[] = {2, 4};
+  for (ppu_renderer_t renderer = PPU_RENDERER_SCANLINE; renderer <= PPU_RENDERER_FIFO; ++renderer) {
+    // moving objects: the scene with the most work per frame
+    const bench_scene_t* scene = &scenes[3];
+    double full_ns = bench_frame_skip(gb, scene, renderer, 1, reference_timing);
+    const char* name = renderer == PPU_RENDERER_FIFO ? "fifo" : "scanline";
+    printf("%-12s %-8s 1 %12.0f %10s %10s\n", scene->name, name, full_ns, "-", "-");
+    for (size_t i = 0; i < sizeof(intervals); ++i) {
+      double skip_ns = bench_frame_skip(gb, scene, renderer, intervals[i], timing);
+      size_t mismatched = 0;
+      for (size_t line = 0; line < BENCH_FRAMES * PPU_LINES_PER_FRAME; ++line) {
+        mismatched += timing[line] != reference_timing[line];
+      }
+      printf("%-12s %-8s %u %12.0f %9.1fx %10zu\n", scene->name, name, intervals[i], skip_ns, full_ns / skip_ns, mismatched);
+    }
+  }
+
+  bench_hash(reference);
+
+  printf("\n%-12s %-8s %12s %10s %10s %10s %10s\n", "scene", "renderer", "ns/frame", "latency us", "max us", "stalls", "mismatch");
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+    if (scenes[i].per_line != NULL) {
+      bench_pipeline(gb, &scenes[i]);
+    }
+  }
+
+  free(gb);
+  return 0;
+}
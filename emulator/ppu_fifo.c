@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "gameboy.h"
+
+/*
+ * Dot-stepped mode 3. The fetcher spends two dots each on the tile number,
+ * the low byte and the high byte, then waits until the background FIFO is
+ * empty to push eight more pixels. One pixel leaves the FIFO per dot unless
+ * an object fetch has stalled output.
+ *
+ * On a skipped frame the fetcher and FIFOs still count out every dot so mode 3
+ * is just as long, but no tile data is read and no pixel is mixed.
+ */
+
+#define FETCH_STARTUP_DOTS 6
+#define FETCH_TILE_NUMBER 1
+#define FETCH_TILE_HIGH 5
+#define FETCH_PUSH 6
+#define OBJ_FETCH_DOTS 6
+#define WINDOW_X_OFFSET 7
+#define OBJ_X_OFFSET 8
+
+void ppu_fifo_begin_line(gameboy_t* gb) {
+  ppu_fifo_t* fifo = &gb->ppu.fifo;
+  memset(fifo, 0, sizeof(*fifo));
+  // the first fetch of every line is thrown away
+  fifo->startup_dots = FETCH_STARTUP_DOTS;
+  fifo->discard = MEMORY_AT(SCX) % TILE_SIZE;
+  gb->ppu.window_drawn = false;
+}
+
+static void fifo_fetch(gameboy_t* gb, ppu_fifo_t* fifo) {
+  ppu_t* ppu = &gb->ppu;
+  if (ppu->skip_frame) {
+    return;
+  }
+  uint8_t lcdc = MEMORY_AT(LCDC);
+  uint8_t map_y = fifo->window_active ? ppu->window_line : (uint8_t)(ppu->ly + MEMORY_AT(SCY));
+
+  switch (fifo->fetch_step) {
+  case FETCH_TILE_NUMBER: {
+    uint16_t map;
+    uint8_t map_x = fifo->fetch_x * TILE_SIZE;
+    if (fifo->window_active) {
+      map = (lcdc & LCDC_WINDOW_CODE_AREA) ? BG_DATA_2_START : BG_DATA_1_START;
+    } else {
+      map = (lcdc & LCDC_BG_CODE_AREA) ? BG_DATA_2_START : BG_DATA_1_START;
+      map_x += MEMORY_AT(SCX);
+    }
+    uint16_t map_offset = map - CHAR_DATA_START + (map_y / TILE_SIZE) * MAP_WIDTH + map_x / TILE_SIZE;
+    // a CGB fetches the attributes from bank 1 along with the tile number
+    fifo->fetch_attributes = ppu->caches.cgb ? ppu->caches.vram[PPU_VRAM_BYTES + map_offset] : 0;
+    fifo->fetch_tile = ppu_bg_tile_index(lcdc, ppu->caches.vram[map_offset]);
+    if (fifo->fetch_attributes & BG_ATTR_BANK) {
+      fifo->fetch_tile += TILE_COUNT;
+    }
+    break;
+  }
+  case FETCH_TILE_HIGH: {
+    uint8_t attributes = fifo->fetch_attributes;
+    uint8_t row = (attributes & BG_ATTR_Y_FLIP) ? TILE_SIZE - 1 - map_y % TILE_SIZE : map_y % TILE_SIZE;
+    const uint8_t* dots = ppu_tile_row(&ppu->caches, fifo->fetch_tile, row);
+    uint8_t marks = (attributes & BG_ATTR_PALETTE) << PPU_BG_PALETTE_SHIFT | ((attributes & BG_ATTR_PRIORITY) ? PPU_BG_PRIORITY : 0);
+    for (uint8_t x = 0; x < TILE_SIZE; ++x) {
+      fifo->fetch_row[x] = dots[(attributes & BG_ATTR_X_FLIP) ? TILE_SIZE - 1 - x : x] | marks;
+    }
+    break;
+  }
+  }
+}
+
+static void fifo_fetcher_tick(gameboy_t* gb, ppu_fifo_t* fifo) {
+  if (fifo->fetch_step < FETCH_PUSH) {
+    fifo_fetch(gb, fifo);
+    fifo->fetch_step += 1;
+    return;
+  }
+  if (fifo->bg_count > 0) {
+    return;
+  }
+  memcpy(fifo->bg, fifo->fetch_row, TILE_SIZE);
+  fifo->bg_head = 0;
+  fifo->bg_count = TILE_SIZE;
+  fifo->fetch_step = 0;
+  fifo->fetch_x += 1;
+}
+
+static void fifo_merge_obj(gameboy_t* gb, ppu_fifo_t* fifo, uint8_t index) {
+  ppu_t* ppu = &gb->ppu;
+  const obj_display_data_t* obj = &((const obj_display_data_t*)ppu->caches.oam)[index];
+  const uint8_t* dots = ppu_obj_row(&ppu->caches, MEMORY_AT(LCDC), ppu->ly, index);
+  bool flip = obj->atribute_data & OBJ_ATTR_X_FLIP;
+
+  while (fifo->obj_count < TILE_SIZE) {
+    fifo->obj[(fifo->obj_head + fifo->obj_count) % TILE_SIZE] = (ppu_fifo_obj_t){0};
+    fifo->obj_count += 1;
+  }
+  for (int px = 0; px < TILE_SIZE; ++px) {
+    int slot = obj->x - OBJ_X_OFFSET + px - fifo->x;
+    if (slot < 0) {
+      continue;
+    }
+    uint8_t color = dots[flip ? TILE_SIZE - 1 - px : px];
+    ppu_fifo_obj_t* dest = &fifo->obj[(fifo->obj_head + slot) % TILE_SIZE];
+    // pixels already in the FIFO belong to objects with higher priority, except on a CGB where OAM order decides
+    if (color != 0 && (dest->color == 0 || (ppu->caches.cgb && index < dest->index))) {
+      *dest = (ppu_fifo_obj_t){
+          .color = color,
+          .attributes = obj->atribute_data,
+          .index = index,
+      };
+    }
+  }
+}
+
+/*
+ * Returns true when the object at the front of the line's list has reached
+ * the output position and the FIFO has to stall for it.
+ */
+static bool fifo_obj_pending(gameboy_t* gb, ppu_fifo_t* fifo, uint8_t lcdc) {
+  const ppu_line_objs_t* objs = &gb->ppu.line_objs;
+  if (!(lcdc & LCDC_OBJ_ON) || fifo->next_obj >= objs->count) {
+    return false;
+  }
+  const obj_display_data_t* oam = (const obj_display_data_t*)gb->ppu.caches.oam;
+  return oam[objs->index[fifo->next_obj]].x <= fifo->x + OBJ_X_OFFSET;
+}
+
+bool ppu_fifo_tick(gameboy_t* gb, pixel_shade_t line[SCREEN_WIDTH]) {
+  ppu_t* ppu = &gb->ppu;
+  ppu_fifo_t* fifo = &ppu->fifo;
+  if (fifo->startup_dots > 0) {
+    fifo->startup_dots -= 1;
+    return false;
+  }
+  uint8_t lcdc = MEMORY_AT(LCDC);
+
+  uint8_t wx = MEMORY_AT(WX);
+  if (!fifo->window_active && (lcdc & LCDC_WINDOW_ON) && ppu->window_triggered && fifo->x + WINDOW_X_OFFSET >= wx) {
+    // the background pixels still queued are dropped and the fetcher starts over on the window
+    fifo->window_active = true;
+    ppu->window_drawn = true;
+    fifo->bg_count = 0;
+    fifo->fetch_step = 0;
+    fifo->fetch_x = 0;
+    fifo->discard = wx < WINDOW_X_OFFSET ? WINDOW_X_OFFSET - wx : 0;
+  }
+
+  if (fifo_obj_pending(gb, fifo, lcdc)) {
+    if (fifo->obj_stall == 0) {
+      // the background fetch in flight has to finish before the object fetch can start
+      if (fifo->fetch_step < FETCH_PUSH || fifo->bg_count == 0) {
+        fifo_fetcher_tick(gb, fifo);
+        return false;
+      }
+      fifo->obj_stall = OBJ_FETCH_DOTS;
+    }
+    fifo->obj_stall -= 1;
+    if (fifo->obj_stall == 0) {
+      if (!ppu->skip_frame) {
+        fifo_merge_obj(gb, fifo, ppu->line_objs.index[fifo->next_obj]);
+      }
+      fifo->next_obj += 1;
+    }
+    return false;
+  }
+
+  fifo_fetcher_tick(gb, fifo);
+  if (fifo->bg_count == 0) {
+    return false;
+  }
+  uint8_t bg_color = fifo->bg[fifo->bg_head];
+  fifo->bg_head = (fifo->bg_head + 1) % (TILE_SIZE * 2);
+  fifo->bg_count -= 1;
+  if (fifo->discard > 0) {
+    fifo->discard -= 1;
+    return false;
+  }
+
+  ppu_fifo_obj_t obj = {0};
+  if (fifo->obj_count > 0) {
+    obj = fifo->obj[fifo->obj_head];
+    fifo->obj_head = (fifo->obj_head + 1) % TILE_SIZE;
+    fifo->obj_count -= 1;
+  }
+  if (!ppu->skip_frame) {
+    line[fifo->x] = ppu->caches.cgb ? ppu_mix_cgb_pixel(lcdc, bg_color, obj)
+                                    : ppu_mix_pixel(lcdc, MEMORY_AT(BGP), MEMORY_AT(OBP0), MEMORY_AT(OBP1), bg_color, obj);
+  }
+  fifo->x += 1;
+  return fifo->x == SCREEN_WIDTH;
+}
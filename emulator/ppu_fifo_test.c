@@ -0,0 +1,70 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+#define LCDC_SCENE (LCDC_ON | LCDC_BG_ON | LCDC_BG_CHAR_AREA)
+
+/*
+ * The background is tile 1 everywhere, solid color 1
+ */
+static gameboy_t* scene_init(void) {
+  static gameboy_t machine;
+  gameboy_t* gb = &machine;
+  memset(gb, 0, sizeof(*gb));
+  triple_buffer_init(&gb->frames);
+  gb->screen = triple_buffer_back(&gb->frames)->pixels;
+  ppu_init(gb);
+  ppu_set_renderer(gb, PPU_RENDERER_FIFO);
+  for (uint8_t i = 0; i < TILE_BYTES; i += 2) {
+    memory_write(gb, CHAR_DATA_START + TILE_BYTES + i, 0xFF);
+  }
+  for (uint16_t cell = 0; cell < MAP_CELLS; ++cell) {
+    memory_write(gb, BG_DATA_1_START + cell, 1);
+  }
+  memory_write(gb, BGP, 0xE4);
+  return gb;
+}
+
+// mode 3 of the first line
+static uint16_t first_transfer_dots(gameboy_t* gb) {
+  memory_write(gb, LCDC, LCDC_SCENE);
+  ppu_step(gb, PPU_DOTS_PER_LINE);
+  return gb->ppu.transfer_dots;
+}
+
+Test(ppu_fifo, fine_scroll_lengthens_mode_3) {
+  gameboy_t* gb = scene_init();
+  uint16_t unscrolled = first_transfer_dots(gb);
+  cr_assert(ge(u16, unscrolled, PPU_TRANSFER_MIN_DOTS));
+
+  gb = scene_init();
+  memory_write(gb, SCX, 5);
+  cr_assert(eq(u16, first_transfer_dots(gb), unscrolled + 5));
+}
+
+/*
+ * A palette written half way through mode 3 only reaches the pixels pushed
+ * after it
+ */
+Test(ppu_fifo, mid_line_write_lands_mid_line) {
+  gameboy_t* gb = scene_init();
+  memory_write(gb, LCDC, LCDC_SCENE);
+  ppu_step(gb, PPU_OAM_SCAN_DOTS + PPU_TRANSFER_MIN_DOTS / 2);
+  cr_assert(eq(u8, gb->ppu.mode, PPU_MODE_TRANSFER));
+  // color 1 goes from shade 1 to shade 2
+  memory_write(gb, BGP, 0x1B);
+  ppu_step(gb, PPU_DOTS_PER_FRAME - PPU_OAM_SCAN_DOTS - PPU_TRANSFER_MIN_DOTS / 2);
+
+  bool is_new;
+  const pixel_shade_t* pixels = triple_buffer_acquire(&gb->frames, &is_new)->pixels;
+  cr_assert(eq(u8, pixels[0], 1));
+  cr_assert(eq(u8, pixels[SCREEN_WIDTH - 1], 2));
+  uint8_t changes = 0;
+  for (uint8_t x = 1; x < SCREEN_WIDTH; ++x) {
+    changes += pixels[x] != pixels[x - 1];
+  }
+  cr_assert(eq(u8, changes, 1));
+  cr_assert(eq(u8, pixels[SCREEN_WIDTH], 2));
+}
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gameboy.h"
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void worker_replay(ppu_worker_t* worker, const ppu_frame_log_t* log, uint32_t* next, uint32_t until) {
+  for (; *next < until; *next += 1) {
+    const ppu_log_write_t* write = &log->writes[*next];
+    if (write->address >= OAM_START) {
+      worker->oam[write->address - OAM_START] = write->value;
+    } else {
+      worker->vram[write->bank][write->address - CHAR_DATA_START] = write->value;
+    }
+    ppu_caches_written(&worker->caches, write->bank, write->address);
+  }
+}
+
+/*
+ * Brings the worker's VRAM/OAM through the whole log, drawing the deferred
+ * lines of its band on the way
+ */
+static void worker_run(ppu_worker_t* worker, ppu_frame_log_t* log, uint8_t first_line, uint8_t last_line) {
+  if (log->resync) {
+    memcpy(worker->vram, log->vram, sizeof(worker->vram));
+    memcpy(worker->oam, log->oam, sizeof(worker->oam));
+    ppu_caches_invalidate(&worker->caches);
+  }
+  uint32_t next = 0;
+  for (uint8_t ly = first_line; ly < last_line && !log->skipped; ++ly) {
+    const ppu_log_line_t* line = &log->lines[ly];
+    if (!line->deferred) {
+      continue;
+    }
+    worker_replay(worker, log, &next, line->writes);
+    ppu_render_scanline(&worker->caches, &line->registers, &line->objs, line->window, line->window_line, &log->pixels[ly * SCREEN_WIDTH]);
+  }
+  worker_replay(worker, log, &next, log->write_count);
+}
+
+/*
+ * Called with the pipeline's lock held by the last worker to finish a log
+ */
+static void pipeline_publish(gameboy_t* gb, ppu_frame_log_t* log) {
+  ppu_pipeline_t* pipeline = gb->ppu.pipeline;
+  pipeline->completed += 1;
+  if (log->skipped) {
+    return;
+  }
+  frame_t* frame = triple_buffer_back(&gb->frames);
+  memcpy(frame->pixels, log->pixels, sizeof(frame->pixels));
+  frame->number = log->number;
+  frame->cgb = log->cgb;
+  memcpy(frame->colors, log->colors, sizeof(frame->colors));
+  frame->hash = ppu_frame_hash(frame);
+  if (gb->frame_sink != NULL) {
+    gb->frame_sink(gb->frame_sink_data, frame);
+  }
+  triple_buffer_publish(&gb->frames);
+
+  uint64_t latency = monotonic_ns() - log->submitted_ns;
+  pipeline->stats.frames += 1;
+  pipeline->stats.latency_total_ns += latency;
+  if (latency > pipeline->stats.latency_max_ns) {
+    pipeline->stats.latency_max_ns = latency;
+  }
+}
+
+typedef struct {
+  gameboy_t* gb;
+  ppu_worker_t* worker;
+} ppu_worker_args_t;
+
+static void* ppu_worker_thread(void* args) {
+  ppu_worker_args_t wargs = *(ppu_worker_args_t*)args;
+  free(args);
+  gameboy_t* gb = wargs.gb;
+  ppu_worker_t* worker = wargs.worker;
+  ppu_pipeline_t* pipeline = gb->ppu.pipeline;
+
+  thread_event_register(&pipeline->event);
+  while (true) {
+    while (worker->done == pipeline->submitted && !pipeline->stopping) {
+      thread_event_wait(&pipeline->event);
+    }
+    if (worker->done == pipeline->submitted) {
+      break;
+    }
+    ppu_frame_log_t* log = &pipeline->logs[worker->done % PPU_PIPELINE_DEPTH];
+    thread_event_finish(&pipeline->event);
+
+    worker_run(worker, log, worker->first_line, worker->last_line);
+
+    thread_event_register(&pipeline->event);
+    worker->done += 1;
+    log->pending -= 1;
+    if (log->pending == 0) {
+      pipeline_publish(gb, log);
+      // without the lock, or it would also end this worker's own next wait
+      thread_event_finish(&pipeline->event);
+      thread_event_trigger(&pipeline->event);
+      thread_event_register(&pipeline->event);
+    }
+  }
+  thread_event_finish(&pipeline->event);
+  return NULL;
+}
+
+/*
+ * Gets `log` ready to record a new frame. A log that is not the continuation
+ * of the previous one carries a copy of VRAM/OAM for the workers to start from.
+ */
+static void pipeline_begin_log(gameboy_t* gb, ppu_frame_log_t* log, bool resync) {
+  log->write_count = 0;
+  log->overflow = false;
+  log->resync = resync;
+  if (resync) {
+    memcpy(log->vram, gb->vram, sizeof(log->vram));
+    memcpy(log->oam, &MEMORY_AT(OAM_START), sizeof(log->oam));
+  }
+  for (uint8_t ly = 0; ly < SCREEN_HEIGHT; ++ly) {
+    log->lines[ly].deferred = false;
+  }
+  gb->ppu.log = log;
+  gb->screen = log->pixels;
+}
+
+bool ppu_pipeline_start(gameboy_t* gb, uint8_t workers) {
+  if (gb->ppu.pipeline != NULL || workers < 1 || workers > PPU_PIPELINE_MAX_WORKERS) {
+    return false;
+  }
+  ppu_pipeline_t* pipeline = calloc(1, sizeof(ppu_pipeline_t));
+  if (pipeline == NULL) {
+    return false;
+  }
+  pipeline->event = thread_event_create();
+  pipeline->worker_count = workers;
+  gb->ppu.pipeline = pipeline;
+
+  // lines already drawn this frame carry over
+  memcpy(pipeline->logs[0].pixels, gb->screen, sizeof(pipeline->logs[0].pixels));
+  pipeline_begin_log(gb, &pipeline->logs[0], true);
+
+  for (uint8_t i = 0; i < workers; ++i) {
+    ppu_worker_t* worker = &pipeline->workers[i];
+    worker->first_line = i * SCREEN_HEIGHT / workers;
+    worker->last_line = (i + 1) * SCREEN_HEIGHT / workers;
+    ppu_caches_init(&worker->caches, worker->vram[0], worker->oam);
+    worker->caches.cgb = gb->ppu.caches.cgb;
+
+    ppu_worker_args_t* args = malloc(sizeof(ppu_worker_args_t));
+    if (args == NULL) {
+      pipeline->worker_count = i;
+      ppu_pipeline_stop(gb);
+      return false;
+    }
+    *args = (ppu_worker_args_t){
+        .gb = gb,
+        .worker = worker,
+    };
+    if (pthread_create(&worker->thread, NULL, ppu_worker_thread, args) != 0) {
+      free(args);
+      pipeline->worker_count = i;
+      ppu_pipeline_stop(gb);
+      return false;
+    }
+  }
+  return true;
+}
+
+void ppu_pipeline_flush(gameboy_t* gb) {
+  ppu_pipeline_t* pipeline = gb->ppu.pipeline;
+  if (pipeline == NULL) {
+    return;
+  }
+  thread_event_register(&pipeline->event);
+  while (pipeline->completed < pipeline->submitted) {
+    thread_event_wait(&pipeline->event);
+  }
+  thread_event_finish(&pipeline->event);
+}
+
+/*
+ * Waits for every submitted frame, then draws what the frame in progress has
+ * deferred so far on this thread and goes back to drawing inline.
+ */
+void ppu_pipeline_stop(gameboy_t* gb) {
+  ppu_pipeline_t* pipeline = gb->ppu.pipeline;
+  if (pipeline == NULL) {
+    return;
+  }
+  ppu_pipeline_flush(gb);
+  thread_event_register(&pipeline->event);
+  pipeline->stopping = true;
+  thread_event_trigger(&pipeline->event);
+  thread_event_finish(&pipeline->event);
+  for (uint8_t i = 0; i < pipeline->worker_count; ++i) {
+    pthread_join(pipeline->workers[i].thread, NULL);
+  }
+
+  ppu_frame_log_t* log = gb->ppu.log;
+  gb->screen = triple_buffer_back(&gb->frames)->pixels;
+  // only set on submit, until then it is whatever the frame that last used this log was
+  log->skipped = gb->ppu.skip_frame;
+  if (pipeline->worker_count > 0) {
+    // the first worker has replayed everything submitted, so it can pick up from here
+    worker_run(&pipeline->workers[0], log, 0, SCREEN_HEIGHT);
+  }
+  memcpy(gb->screen, log->pixels, sizeof(log->pixels));
+
+  gb->ppu.pipeline = NULL;
+  gb->ppu.log = NULL;
+  free(pipeline);
+}
+
+/*
+ * Hands the log of the frame that just ended to the workers and moves on to
+ * the next one, waiting for the workers to let go of it first if they have to.
+ */
+void ppu_pipeline_submit(gameboy_t* gb) {
+  ppu_pipeline_t* pipeline = gb->ppu.pipeline;
+  ppu_frame_log_t* log = gb->ppu.log;
+  log->number = gb->ppu.frames;
+  log->skipped = gb->ppu.skip_frame;
+  // palettes as they are at the end of the frame, like an inline frame gets them
+  log->cgb = gb->ppu.caches.cgb;
+  if (log->cgb) {
+    ppu_palette_colors(gb, log->colors);
+  }
+  log->pending = pipeline->worker_count;
+  log->submitted_ns = monotonic_ns();
+  bool resync = log->overflow;
+
+  thread_event_register(&pipeline->event);
+  pipeline->submitted += 1;
+  if (resync) {
+    pipeline->stats.overflows += 1;
+  }
+  // without the lock, or it would also end the wait below at once
+  thread_event_finish(&pipeline->event);
+  thread_event_trigger(&pipeline->event);
+  thread_event_register(&pipeline->event);
+  if (pipeline->completed + PPU_PIPELINE_DEPTH <= pipeline->submitted) {
+    pipeline->stats.stalls += 1;
+    while (pipeline->completed + PPU_PIPELINE_DEPTH <= pipeline->submitted) {
+      thread_event_wait(&pipeline->event);
+    }
+  }
+  thread_event_finish(&pipeline->event);
+
+  pipeline_begin_log(gb, &pipeline->logs[pipeline->submitted % PPU_PIPELINE_DEPTH], resync);
+}
+
+ppu_pipeline_stats_t ppu_pipeline_stats(gameboy_t* gb) {
+  ppu_pipeline_stats_t stats = {0};
+  ppu_pipeline_t* pipeline = gb->ppu.pipeline;
+  if (pipeline == NULL) {
+    return stats;
+  }
+  thread_event_register(&pipeline->event);
+  stats = pipeline->stats;
+  thread_event_finish(&pipeline->event);
+  return stats;
+}
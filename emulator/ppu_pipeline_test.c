@@ -0,0 +1,110 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+#define TEST_FRAMES 4
+// more VRAM writes per line than a frame log holds over a whole frame
+#define TEST_FLOOD_WRITES ((PPU_LOG_WRITES) / (SCREEN_HEIGHT) + 64)
+
+typedef struct {
+  uint64_t hashes[TEST_FRAMES + 1];
+  uint32_t count;
+} frame_record_t;
+
+static void record_frame(void* data, const frame_t* frame) {
+  frame_record_t* record = data;
+  if (frame->number <= TEST_FRAMES) {
+    record->hashes[frame->number] = frame->hash;
+  }
+  record->count += 1;
+}
+
+static uint32_t test_seed;
+
+static uint8_t test_random(void) {
+  test_seed = test_seed * 1103515245 + 12345;
+  return test_seed >> 16;
+}
+
+/*
+ * Random tiles and maps, a window and objects, with the scroll, a palette
+ * and some VRAM changed on every line. `flood` writes enough VRAM to
+ * overflow the frame log. `cgb` fills both VRAM banks and the palettes, and
+ * switches banks between lines.
+ */
+static void run_scene(gameboy_t* gb, frame_record_t* record, uint8_t workers, bool flood, bool cgb) {
+  memset(gb, 0, sizeof(*gb));
+  triple_buffer_init(&gb->frames);
+  gb->screen = triple_buffer_back(&gb->frames)->pixels;
+  gb->frame_sink = record_frame;
+  gb->frame_sink_data = record;
+  gb->model = cgb ? GAMEBOY_MODEL_CGB : GAMEBOY_MODEL_DMG;
+  ppu_init(gb);
+  test_seed = 1;
+  for (uint8_t bank = 0; bank < (cgb ? VRAM_BANK_COUNT : 1); ++bank) {
+    memory_write(gb, VBK, bank);
+    for (uint16_t address = CHAR_DATA_START; address <= BG_DATA_2_END; ++address) {
+      memory_write(gb, address, test_random());
+    }
+  }
+  for (uint16_t i = 0; i < PPU_OAM_BYTES; ++i) {
+    memory_write(gb, OAM_START + i, test_random());
+  }
+  memory_write(gb, WY, 30);
+  memory_write(gb, WX, 60);
+  memory_write(gb, OBP0, 0xD2);
+  memory_write(gb, OBP1, 0x1B);
+  memory_write(gb, LCDC, LCDC_ON | LCDC_BG_ON | LCDC_OBJ_ON | LCDC_WINDOW_ON | LCDC_WINDOW_CODE_AREA);
+  if (workers > 0) {
+    cr_assert(ppu_pipeline_start(gb, workers));
+  }
+
+  for (uint32_t frame = 0; frame < TEST_FRAMES; ++frame) {
+    for (uint8_t ly = 0; ly < PPU_LINES_PER_FRAME; ++ly) {
+      memory_write(gb, SCX, ly * 3 + frame);
+      memory_write(gb, BGP, ly & 0x10 ? 0xE4 : 0x1B);
+      memory_write(gb, VBK, ly & 1);
+      memory_write(gb, BCPS, test_random());
+      memory_write(gb, BCPD, test_random());
+      uint16_t writes = flood && frame == 1 ? TEST_FLOOD_WRITES : 4;
+      for (uint16_t i = 0; i < writes; ++i) {
+        memory_write(gb, CHAR_DATA_START + test_random() % (TILE_COUNT * TILE_BYTES), test_random());
+      }
+      memory_write(gb, BG_DATA_1_START + test_random() % MAP_CELLS, test_random());
+      ppu_step(gb, PPU_DOTS_PER_LINE);
+    }
+  }
+  ppu_pipeline_stop(gb);
+}
+
+static void check_matches_inline(uint8_t workers, bool flood, bool cgb) {
+  static gameboy_t machine;
+  static frame_record_t inline_frames, piped_frames;
+  memset(&inline_frames, 0, sizeof(inline_frames));
+  memset(&piped_frames, 0, sizeof(piped_frames));
+
+  run_scene(&machine, &inline_frames, 0, flood, cgb);
+  run_scene(&machine, &piped_frames, workers, flood, cgb);
+  cr_assert(eq(u32, inline_frames.count, TEST_FRAMES));
+  cr_assert(eq(u32, piped_frames.count, TEST_FRAMES));
+  for (uint32_t frame = 1; frame <= TEST_FRAMES; ++frame) {
+    cr_assert(eq(u64, piped_frames.hashes[frame], inline_frames.hashes[frame]));
+  }
+}
+
+Test(ppu_pipeline, frames_match_inline) {
+  check_matches_inline(1, false, false);
+  check_matches_inline(3, false, false);
+}
+
+Test(ppu_pipeline, cgb_frames_match_inline) {
+  //
+  check_matches_inline(2, false, true);
+}
+
+Test(ppu_pipeline, overflowing_log_resyncs) {
+  //
+  check_matches_inline(2, true, false);
+}
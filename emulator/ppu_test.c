@@ -0,0 +1,309 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+/*
+ * Scenes are written straight into VRAM/OAM, run for a frame and checked
+ * pixel by pixel. BGP and OBP0 are the identity, so every shade is the color
+ * number that was drawn. Each scene goes through both renderers.
+ */
+
+#define LCDC_SCENE (LCDC_ON | LCDC_BG_ON | LCDC_BG_CHAR_AREA)
+
+static const ppu_renderer_t renderers[] = {PPU_RENDERER_SCANLINE, PPU_RENDERER_FIFO};
+
+static gameboy_t* scene_init(ppu_renderer_t renderer) {
+  static gameboy_t machine;
+  gameboy_t* gb = &machine;
+  memset(gb, 0, sizeof(*gb));
+  triple_buffer_init(&gb->frames);
+  gb->screen = triple_buffer_back(&gb->frames)->pixels;
+  ppu_init(gb);
+  ppu_set_renderer(gb, renderer);
+  memory_write(gb, BGP, 0xE4);
+  memory_write(gb, OBP0, 0xE4);
+  return gb;
+}
+
+/*
+ * As the machine would be after gameboy_set_model, which is not linked here
+ */
+static gameboy_t* cgb_scene_init(ppu_renderer_t renderer) {
+  gameboy_t* gb = scene_init(renderer);
+  gb->model = GAMEBOY_MODEL_CGB;
+  gb->ppu.caches.cgb = true;
+  ppu_caches_invalidate(&gb->ppu.caches);
+  return gb;
+}
+
+static void write_tile_row(gameboy_t* gb, uint16_t tile, uint8_t row, const uint8_t colors[TILE_SIZE]) {
+  uint8_t lo = 0, hi = 0;
+  for (uint8_t x = 0; x < TILE_SIZE; ++x) {
+    lo |= (colors[x] & 1) << (TILE_SIZE - 1 - x);
+    hi |= (colors[x] >> 1) << (TILE_SIZE - 1 - x);
+  }
+  memory_write(gb, CHAR_DATA_START + tile * TILE_BYTES + row * 2, lo);
+  memory_write(gb, CHAR_DATA_START + tile * TILE_BYTES + row * 2 + 1, hi);
+}
+
+static void write_solid_tile(gameboy_t* gb, uint16_t tile, uint8_t color) {
+  const uint8_t colors[TILE_SIZE] = {color, color, color, color, color, color, color, color};
+  for (uint8_t row = 0; row < TILE_SIZE; ++row) {
+    write_tile_row(gb, tile, row, colors);
+  }
+}
+
+static void write_obj(gameboy_t* gb, uint8_t index, uint8_t y, uint8_t x, uint8_t tile) {
+  memory_write(gb, OAM_START + index * OBJ_BYTES + 0, y);
+  memory_write(gb, OAM_START + index * OBJ_BYTES + 1, x);
+  memory_write(gb, OAM_START + index * OBJ_BYTES + 2, tile);
+  memory_write(gb, OAM_START + index * OBJ_BYTES + 3, 0);
+}
+
+static void write_obj_attributes(gameboy_t* gb, uint8_t index, uint8_t attributes) {
+  //
+  memory_write(gb, OAM_START + index * OBJ_BYTES + 3, attributes);
+}
+
+static const pixel_shade_t* run_frame(gameboy_t* gb, uint8_t lcdc) {
+  memory_write(gb, LCDC, lcdc);
+  ppu_step(gb, PPU_DOTS_PER_FRAME);
+  bool is_new;
+  return triple_buffer_acquire(&gb->frames, &is_new)->pixels;
+}
+
+/*
+ * Twelve objects share a line. The two left out are the last in OAM, even
+ * though they are the leftmost on screen.
+ */
+Test(ppu, ten_objects_per_line) {
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    gameboy_t* gb = scene_init(renderers[r]);
+    write_solid_tile(gb, 1, 3);
+    for (uint8_t i = 0; i < 12; ++i) {
+      write_obj(gb, i, 16, 8 + (11 - i) * 12, 1);
+    }
+    const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE | LCDC_OBJ_ON);
+
+    for (uint8_t i = 0; i < 12; ++i) {
+      uint8_t x = (11 - i) * 12;
+      uint8_t expected = i < OBJ_PER_LINE ? 3 : 0;
+      cr_assert(eq(u8, pixels[x], expected));
+      cr_assert(eq(u8, pixels[7 * SCREEN_WIDTH + x + 7], expected));
+    }
+    // below the objects
+    cr_assert(eq(u8, pixels[8 * SCREEN_WIDTH + 132], 0));
+  }
+}
+
+/*
+ * Where objects overlap the one further left wins, on equal x the one
+ * earlier in OAM
+ */
+Test(ppu, lower_x_draws_on_top) {
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    gameboy_t* gb = scene_init(renderers[r]);
+    write_solid_tile(gb, 1, 1);
+    write_solid_tile(gb, 2, 2);
+    // screen x 12-19 and 8-15
+    write_obj(gb, 0, 16, 20, 1);
+    write_obj(gb, 1, 16, 16, 2);
+    // on line 16, both at screen x 52-59
+    write_obj(gb, 2, 32, 60, 2);
+    write_obj(gb, 3, 32, 60, 1);
+    const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE | LCDC_OBJ_ON);
+
+    cr_assert(eq(u8, pixels[8], 2));
+    cr_assert(eq(u8, pixels[12], 2));
+    cr_assert(eq(u8, pixels[15], 2));
+    cr_assert(eq(u8, pixels[16], 1));
+    cr_assert(eq(u8, pixels[19], 1));
+    cr_assert(eq(u8, pixels[20], 0));
+    for (uint8_t x = 52; x < 60; ++x) {
+      cr_assert(eq(u8, pixels[16 * SCREEN_WIDTH + x], 2));
+    }
+  }
+}
+
+/*
+ * The window starts on the line LY first equals WY, and that line shows the
+ * window's first row whatever WY is
+ */
+Test(ppu, window_starts_at_wy) {
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    gameboy_t* gb = scene_init(renderers[r]);
+    // rows of color 1, 2, 3, 1, ...
+    for (uint8_t row = 0; row < TILE_SIZE; ++row) {
+      uint8_t color = row % 3 + 1;
+      const uint8_t colors[TILE_SIZE] = {color, color, color, color, color, color, color, color};
+      write_tile_row(gb, 1, row, colors);
+    }
+    for (uint16_t cell = 0; cell < MAP_CELLS; ++cell) {
+      memory_write(gb, BG_DATA_2_START + cell, 1);
+    }
+    memory_write(gb, WY, 40);
+    memory_write(gb, WX, 80 + 7);
+    const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE | LCDC_WINDOW_ON | LCDC_WINDOW_CODE_AREA);
+
+    cr_assert(eq(u8, pixels[39 * SCREEN_WIDTH + 100], 0));
+    cr_assert(eq(u8, pixels[40 * SCREEN_WIDTH + 79], 0));
+    cr_assert(eq(u8, pixels[40 * SCREEN_WIDTH + 80], 1));
+    cr_assert(eq(u8, pixels[41 * SCREEN_WIDTH + 80], 2));
+    cr_assert(eq(u8, pixels[42 * SCREEN_WIDTH + 159], 3));
+    cr_assert(eq(u8, pixels[48 * SCREEN_WIDTH + 80], 1));
+  }
+}
+
+/*
+ * With SCX not a multiple of 8 the line starts part way into a tile, and it
+ * wraps around the right edge of the map
+ */
+Test(ppu, scx_fine_scroll) {
+  static const uint8_t patterns[2][TILE_SIZE] = {
+      {0, 1, 2, 3, 0, 1, 2, 3},
+      {3, 3, 2, 2, 1, 1, 0, 0},
+  };
+  static const uint8_t scrolls[] = {0, 3, 7, 253};
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    for (size_t s = 0; s < sizeof(scrolls); ++s) {
+      gameboy_t* gb = scene_init(renderers[r]);
+      for (uint8_t row = 0; row < TILE_SIZE; ++row) {
+        write_tile_row(gb, 1, row, patterns[0]);
+        write_tile_row(gb, 2, row, patterns[1]);
+      }
+      for (uint16_t cell = 0; cell < MAP_CELLS; ++cell) {
+        memory_write(gb, BG_DATA_1_START + cell, cell % 2 + 1);
+      }
+      memory_write(gb, SCX, scrolls[s]);
+      const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE);
+
+      for (uint8_t x = 0; x < SCREEN_WIDTH; ++x) {
+        uint8_t map_x = x + scrolls[s];
+        uint8_t expected = patterns[(map_x / TILE_SIZE) % 2][map_x % TILE_SIZE];
+        cr_assert(eq(u8, pixels[x], expected));
+        cr_assert(eq(u8, pixels[143 * SCREEN_WIDTH + x], expected));
+      }
+    }
+  }
+}
+
+static pixel_shade_t cgb_pixel(uint8_t palette, uint8_t color) {
+  //
+  return palette << 2 | color;
+}
+
+/*
+ * The map attributes in bank 1 pick each cell's palette, flip it and fetch
+ * its tile from either bank
+ */
+Test(ppu, cgb_map_attributes) {
+  static const uint8_t first_row[TILE_SIZE] = {0, 1, 2, 3, 0, 1, 2, 3};
+  static const uint8_t other_rows[TILE_SIZE] = {2, 2, 2, 2, 2, 2, 2, 2};
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    gameboy_t* gb = cgb_scene_init(renderers[r]);
+    memory_write(gb, VBK, 1);
+    write_solid_tile(gb, 1, 3);
+    memory_write(gb, BG_DATA_1_START + 0, BG_ATTR_X_FLIP | 5);
+    memory_write(gb, BG_DATA_1_START + 1, BG_ATTR_Y_FLIP);
+    memory_write(gb, BG_DATA_1_START + 2, BG_ATTR_BANK | 2);
+    memory_write(gb, VBK, 0);
+    write_tile_row(gb, 1, 0, first_row);
+    for (uint8_t row = 1; row < TILE_SIZE; ++row) {
+      write_tile_row(gb, 1, row, other_rows);
+    }
+    for (uint16_t cell = 0; cell < MAP_CELLS; ++cell) {
+      memory_write(gb, BG_DATA_1_START + cell, 1);
+    }
+    const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE);
+
+    for (uint8_t x = 0; x < TILE_SIZE; ++x) {
+      cr_assert(eq(u8, pixels[x], cgb_pixel(5, first_row[TILE_SIZE - 1 - x])));
+      cr_assert(eq(u8, pixels[x + 8], cgb_pixel(0, 2)));
+      cr_assert(eq(u8, pixels[7 * SCREEN_WIDTH + x + 8], cgb_pixel(0, first_row[x])));
+      cr_assert(eq(u8, pixels[x + 16], cgb_pixel(2, 3)));
+      cr_assert(eq(u8, pixels[x + 24], cgb_pixel(0, first_row[x])));
+    }
+  }
+}
+
+/*
+ * Objects draw through their own palettes and where they overlap the lower
+ * OAM index wins, whatever their x
+ */
+Test(ppu, cgb_objects_go_by_oam_order) {
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    gameboy_t* gb = cgb_scene_init(renderers[r]);
+    write_solid_tile(gb, 2, 1);
+    write_solid_tile(gb, 3, 2);
+    // screen x 12-19 and 8-15
+    write_obj(gb, 0, 16, 20, 2);
+    write_obj_attributes(gb, 0, 3);
+    write_obj(gb, 1, 16, 16, 3);
+    write_obj_attributes(gb, 1, 6);
+    const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE | LCDC_OBJ_ON);
+
+    cr_assert(eq(u8, pixels[8], CGB_PIXEL_OBJ | cgb_pixel(6, 2)));
+    cr_assert(eq(u8, pixels[12], CGB_PIXEL_OBJ | cgb_pixel(3, 1)));
+    cr_assert(eq(u8, pixels[19], CGB_PIXEL_OBJ | cgb_pixel(3, 1)));
+    cr_assert(eq(u8, pixels[20], 0));
+  }
+}
+
+/*
+ * Background colors 1-3 cover objects when the map attributes or the object
+ * ask for it, unless LCDC bit 0 hands everything to the objects. It never
+ * blanks the background on a CGB.
+ */
+Test(ppu, cgb_background_priority) {
+  for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); ++r) {
+    gameboy_t* gb = cgb_scene_init(renderers[r]);
+    write_solid_tile(gb, 1, 1);
+    write_solid_tile(gb, 2, 2);
+    memory_write(gb, VBK, 1);
+    memory_write(gb, BG_DATA_1_START + 0, BG_ATTR_PRIORITY);
+    memory_write(gb, VBK, 0);
+    for (uint16_t cell = 0; cell < MAP_CELLS; ++cell) {
+      memory_write(gb, BG_DATA_1_START + cell, 1);
+    }
+    // screen x 0-7, 8-15 and 16-23
+    for (uint8_t i = 0; i < 3; ++i) {
+      write_obj(gb, i, 16, 8 + i * 8, 2);
+    }
+    write_obj_attributes(gb, 2, OBJ_ATTR_BG_PRIORITY);
+
+    const pixel_shade_t* pixels = run_frame(gb, LCDC_SCENE | LCDC_OBJ_ON);
+    cr_assert(eq(u8, pixels[0], 1));
+    cr_assert(eq(u8, pixels[8], CGB_PIXEL_OBJ | 2));
+    cr_assert(eq(u8, pixels[16], 1));
+
+    pixels = run_frame(gb, (LCDC_SCENE & ~LCDC_BG_ON) | LCDC_OBJ_ON);
+    cr_assert(eq(u8, pixels[0], CGB_PIXEL_OBJ | 2));
+    cr_assert(eq(u8, pixels[8], CGB_PIXEL_OBJ | 2));
+    cr_assert(eq(u8, pixels[16], CGB_PIXEL_OBJ | 2));
+    cr_assert(eq(u8, pixels[40], 1));
+  }
+}
+
+/*
+ * The frame carries palette RAM as it was when the frame ended
+ */
+Test(ppu, cgb_frame_carries_the_palettes) {
+  gameboy_t* gb = cgb_scene_init(PPU_RENDERER_SCANLINE);
+  // BG palette 1 color 2, then OBJ palette 7 color 3
+  memory_write(gb, BCPS, PALETTE_AUTO_INCREMENT | (1 * 4 + 2) * 2);
+  memory_write(gb, BCPD, 0x1F);
+  memory_write(gb, BCPD, 0x7C);
+  memory_write(gb, OCPS, (7 * 4 + 3) * 2 + 1);
+  memory_write(gb, OCPD, 0x03);
+  memory_write(gb, LCDC, LCDC_SCENE);
+  ppu_step(gb, PPU_DOTS_PER_FRAME);
+
+  bool is_new;
+  const frame_t* frame = triple_buffer_acquire(&gb->frames, &is_new);
+  cr_assert(frame->cgb);
+  cr_assert(eq(u16, frame->colors[1 * 4 + 2], 0x7C1F));
+  cr_assert(eq(u16, frame->colors[CGB_COLOR_COUNT / 2 + 7 * 4 + 3], 0x0300));
+  cr_assert(eq(u16, frame->colors[0], 0));
+}
@@ -0,0 +1,56 @@
+#include "command_queue.h"
+#include <time.h>
+
+#define SLOT_MASK (COMMAND_QUEUE_SIZE - 1)
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void command_queue_init(command_queue_t* queue) {
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->dropped, 0);
+  queue->head = 0;
+  // slot i is free for the push at position i
+  for (uint64_t i = 0; i < COMMAND_QUEUE_SIZE; ++i) {
+    atomic_init(&queue->slots[i].sequence, i);
+  }
+}
+
+bool command_queue_push(command_queue_t* queue, command_t command) {
+  command.time_ns = now_ns();
+  uint64_t position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  command_slot_t* slot;
+  while (true) {
+    slot = &queue->slots[position & SLOT_MASK];
+    int64_t turn = (int64_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - position);
+    if (turn == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->tail, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (turn < 0) {
+      // still holds the command from a lap ago
+      atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+      return false;
+    } else {
+      // another producer got there first
+      position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    }
+  }
+  slot->command = command;
+  atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+  return true;
+}
+
+bool command_queue_pop(command_queue_t* queue, command_t* command) {
+  command_slot_t* slot = &queue->slots[queue->head & SLOT_MASK];
+  if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != queue->head + 1) {
+    return false;
+  }
+  *command = slot->command;
+  atomic_store_explicit(&slot->sequence, queue->head + COMMAND_QUEUE_SIZE, memory_order_release);
+  queue->head += 1;
+  return true;
+}
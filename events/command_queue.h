@@ -0,0 +1,54 @@
+#ifndef EVENTS_COMMAND_QUEUE_H
+#define EVENTS_COMMAND_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Bounded queue of small timestamped commands that any number of threads push
+ * to and a single thread pops from, without locks on either side.
+ *
+ * Every slot carries a sequence number telling whose turn it is. A producer
+ * claims the slot at `tail` with a compare and swap, fills it and then hands
+ * it over by moving its sequence on. The consumer takes slots in order, and
+ * once it has copied one out moves the sequence on a lap so the slot is free
+ * to claim again. A slot claimed but not yet handed over holds the consumer
+ * up until it is, commands never overtake each other.
+ */
+
+// a power of two
+#define COMMAND_QUEUE_SIZE 256
+
+typedef struct {
+  uint32_t type;
+  // CLOCK_MONOTONIC when it was pushed
+  uint64_t time_ns;
+  union {
+    uint32_t value;
+    double ratio;
+    void* data;
+  };
+} command_t;
+
+typedef struct {
+  _Atomic uint64_t sequence;
+  command_t command;
+} command_slot_t;
+
+typedef struct {
+  _Alignas(64) _Atomic uint64_t tail;
+  // pushes that found the queue full
+  _Atomic uint64_t dropped;
+  // only the consumer touches it
+  _Alignas(64) uint64_t head;
+  command_slot_t slots[COMMAND_QUEUE_SIZE];
+} command_queue_t;
+
+void command_queue_init(command_queue_t* queue);
+// any thread, stamps `command` and returns false when the queue is full
+bool command_queue_push(command_queue_t* queue, command_t command);
+// the consumer only, false when there is nothing to pop
+bool command_queue_pop(command_queue_t* queue, command_t* command);
+
+#endif // !DEBUG
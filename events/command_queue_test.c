@@ -0,0 +1,92 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <pthread.h>
+
+#include "command_queue.h"
+
+#define STRESS_PRODUCERS 4
+#define STRESS_COMMANDS 50000
+
+Test(command_queue, pops_in_push_order) {
+  static command_queue_t queue;
+  command_queue_init(&queue);
+  command_t command;
+  cr_assert(not(command_queue_pop(&queue, &command)));
+
+  // a few laps round the slots
+  for (uint32_t i = 0; i < COMMAND_QUEUE_SIZE * 3; ++i) {
+    cr_assert(command_queue_push(&queue, (command_t){.type = 1, .value = i}));
+    cr_assert(command_queue_push(&queue, (command_t){.type = 2, .value = i}));
+    cr_assert(command_queue_pop(&queue, &command));
+    cr_assert(eq(u32, command.type, 1));
+    cr_assert(eq(u32, command.value, i));
+    cr_assert(ne(u64, command.time_ns, 0));
+    cr_assert(command_queue_pop(&queue, &command));
+    cr_assert(eq(u32, command.type, 2));
+  }
+  cr_assert(not(command_queue_pop(&queue, &command)));
+}
+
+Test(command_queue, full_queue_drops) {
+  static command_queue_t queue;
+  command_queue_init(&queue);
+  for (uint32_t i = 0; i < COMMAND_QUEUE_SIZE; ++i) {
+    cr_assert(command_queue_push(&queue, (command_t){.value = i}));
+  }
+  cr_assert(not(command_queue_push(&queue, (command_t){.value = COMMAND_QUEUE_SIZE})));
+  cr_assert(eq(u64, atomic_load(&queue.dropped), 1));
+
+  // one pop makes room for exactly one more
+  command_t command;
+  cr_assert(command_queue_pop(&queue, &command));
+  cr_assert(eq(u32, command.value, 0));
+  cr_assert(command_queue_push(&queue, (command_t){.value = COMMAND_QUEUE_SIZE}));
+  cr_assert(not(command_queue_push(&queue, (command_t){.value = COMMAND_QUEUE_SIZE + 1})));
+}
+
+typedef struct {
+  command_queue_t* queue;
+  uint32_t producer;
+} stress_args_t;
+
+static void* stress_producer(void* args) {
+  stress_args_t* stress = args;
+  for (uint32_t i = 0; i < STRESS_COMMANDS; ++i) {
+    while (!command_queue_push(stress->queue, (command_t){.type = stress->producer, .value = i})) {
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Every command arrives exactly once, and each producer's in the order it
+ * pushed them
+ */
+Test(command_queue, producers_race) {
+  static command_queue_t queue;
+  command_queue_init(&queue);
+  pthread_t threads[STRESS_PRODUCERS];
+  stress_args_t args[STRESS_PRODUCERS];
+  for (uint32_t i = 0; i < STRESS_PRODUCERS; ++i) {
+    args[i] = (stress_args_t){.queue = &queue, .producer = i};
+    pthread_create(&threads[i], NULL, stress_producer, &args[i]);
+  }
+
+  uint32_t next[STRESS_PRODUCERS] = {0};
+  uint32_t popped = 0;
+  while (popped < STRESS_PRODUCERS * STRESS_COMMANDS) {
+    command_t command;
+    if (!command_queue_pop(&queue, &command)) {
+      continue;
+    }
+    cr_assert(lt(u32, command.type, STRESS_PRODUCERS));
+    cr_assert(eq(u32, command.value, next[command.type]));
+    next[command.type] += 1;
+    popped += 1;
+  }
+  for (uint32_t i = 0; i < STRESS_PRODUCERS; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  command_t command;
+  cr_assert(not(command_queue_pop(&queue, &command)));
+}
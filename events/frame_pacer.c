@@ -0,0 +1,118 @@
+#include <errno.h>
+#include <sys/prctl.h>
+#include <time.h>
+
+#include "frame_pacer.h"
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline) {
+  struct timespec ts = {
+      .tv_sec = deadline / 1000000000,
+      .tv_nsec = deadline % 1000000000,
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static void record_error(frame_pacer_stats_t* stats, uint64_t error) {
+  uint8_t bucket = 0;
+  for (uint64_t us = error / 1000; us > 0 && bucket < FRAME_PACER_BUCKETS - 1; us >>= 1) {
+    bucket += 1;
+  }
+  stats->histogram[bucket] += 1;
+  if (error > stats->error_max_ns) {
+    stats->error_max_ns = error;
+  }
+}
+
+/*
+ * Quick to grow so the next sleep does not overshoot again, slow to shrink so
+ * one lucky wakeup does not undo it. A sleep that overshot by more than the
+ * longest spin was the thread not getting the CPU, spinning would not help.
+ */
+static void adapt_spin(frame_pacer_t* pacer, uint64_t oversleep) {
+  uint64_t wanted = oversleep + oversleep / 2;
+  if (wanted > pacer->spin_ns && oversleep <= FRAME_PACER_MAX_SPIN_NS) {
+    pacer->spin_ns = wanted;
+  } else {
+    pacer->spin_ns -= pacer->spin_ns / 64;
+  }
+  if (pacer->spin_ns < FRAME_PACER_MIN_SPIN_NS) {
+    pacer->spin_ns = FRAME_PACER_MIN_SPIN_NS;
+  } else if (pacer->spin_ns > FRAME_PACER_MAX_SPIN_NS) {
+    pacer->spin_ns = FRAME_PACER_MAX_SPIN_NS;
+  }
+}
+
+void frame_pacer_init(frame_pacer_t* pacer, uint64_t interval_ns) {
+  // the default 50us of slack would all be spent spinning
+  prctl(PR_SET_TIMERSLACK, 1);
+  pacer->interval_ns = interval_ns;
+  pacer->deadline_ns = now_ns() + interval_ns;
+  pacer->spin_ns = FRAME_PACER_MIN_SPIN_NS;
+  pacer->stats = (frame_pacer_stats_t){0};
+}
+
+void frame_pacer_set_interval(frame_pacer_t* pacer, uint64_t interval_ns) {
+  //
+  pacer->interval_ns = interval_ns;
+}
+
+uint64_t frame_pacer_wait(frame_pacer_t* pacer) {
+  frame_pacer_stats_t* stats = &pacer->stats;
+  uint64_t deadline = pacer->deadline_ns;
+  uint64_t now = now_ns();
+  stats->frames += 1;
+
+  if (now >= deadline) {
+    stats->late += 1;
+    if (now - deadline > FRAME_PACER_MAX_LAG * pacer->interval_ns) {
+      stats->resyncs += 1;
+      deadline = now;
+    }
+  } else {
+    if (deadline - now > pacer->spin_ns) {
+      uint64_t wake = deadline - pacer->spin_ns;
+      sleep_until_ns(wake);
+      now = now_ns();
+      adapt_spin(pacer, now - wake);
+    }
+    uint64_t spin_start = now;
+    while (now < deadline) {
+      cpu_relax();
+      now = now_ns();
+    }
+    stats->spin_total_ns += now - spin_start;
+  }
+
+  uint64_t error = now - deadline;
+  record_error(stats, error);
+  pacer->deadline_ns = deadline + pacer->interval_ns;
+  return error;
+}
+
+uint64_t frame_pacer_percentile_ns(const frame_pacer_stats_t* stats, double fraction) {
+  uint64_t total = 0;
+  for (uint8_t i = 0; i < FRAME_PACER_BUCKETS; ++i) {
+    total += stats->histogram[i];
+  }
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < FRAME_PACER_BUCKETS - 1; ++i) {
+    seen += stats->histogram[i];
+    if (total > 0 && seen >= fraction * total) {
+      return (1000ull << i);
+    }
+  }
+  return stats->error_max_ns;
+}
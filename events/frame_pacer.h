@@ -0,0 +1,60 @@
+#ifndef EVENTS_FRAME_PACER_H
+#define EVENTS_FRAME_PACER_H
+
+#include <stdint.h>
+
+/*
+ * Paces a loop to one iteration per interval against absolute
+ * CLOCK_MONOTONIC deadlines. Each deadline is the previous one plus the
+ * interval, so neither the work done in between nor how late a wakeup was
+ * adds up to drift.
+ *
+ * Waiting sleeps with clock_nanosleep until `spin_ns` before the deadline and
+ * spins the rest of the way. The spin follows how late sleeps wake up: it
+ * jumps to half again the latest oversleep when that comes close to it and
+ * otherwise decays slowly, so the pacer spins just long enough to be on time.
+ * Oversleeps longer than the longest spin are the scheduler's doing and are
+ * left out.
+ *
+ * A loop that falls more than FRAME_PACER_MAX_LAG intervals behind, stopped
+ * in a debugger or starved of CPU, starts a new grid from where it is instead
+ * of running flat out until it has caught up.
+ */
+
+#define FRAME_PACER_MAX_LAG 4
+#define FRAME_PACER_MIN_SPIN_NS 20000
+#define FRAME_PACER_MAX_SPIN_NS 500000
+// wakeup error in power of two microseconds: < 1us, 1-2us, 2-4us ... the last one >= 1024us
+#define FRAME_PACER_BUCKETS 12
+
+typedef struct {
+  uint64_t frames;
+  // frames whose deadline had already passed when the loop got to it
+  uint64_t late;
+  uint64_t resyncs;
+  uint64_t histogram[FRAME_PACER_BUCKETS];
+  uint64_t error_max_ns;
+  // time spent spinning instead of sleeping
+  uint64_t spin_total_ns;
+} frame_pacer_stats_t;
+
+typedef struct {
+  uint64_t interval_ns;
+  uint64_t deadline_ns;
+  uint64_t spin_ns;
+  frame_pacer_stats_t stats;
+} frame_pacer_t;
+
+/*
+ * Call on the thread that waits, the first deadline is an interval from now.
+ * Also turns that thread's timer slack down so its sleeps end on time.
+ */
+void frame_pacer_init(frame_pacer_t* pacer, uint64_t interval_ns);
+// takes effect from the next deadline on
+void frame_pacer_set_interval(frame_pacer_t* pacer, uint64_t interval_ns);
+// returns how far past the deadline it returned
+uint64_t frame_pacer_wait(frame_pacer_t* pacer);
+// the top of the histogram bucket the `fraction` of frames at or below falls in
+uint64_t frame_pacer_percentile_ns(const frame_pacer_stats_t* stats, double fraction);
+
+#endif // !DEBUG
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_pacer.h"
+
+/*
+ * Paces BENCH_FRAMES Game Boy frames, each with BENCH_WORK_NS of busy work
+ * standing in for emulation, once with a relative usleep per frame the way
+ * the CPU clock thread used to and once with the frame pacer. Reports how far
+ * the achieved frame rate is off, how late frames came, and how much CPU the
+ * waits themselves took, as a share of the time spent waiting.
+ */
+
+#define BENCH_FRAMES 300
+// a 70224 dot frame at 4 MiHz
+#define BENCH_INTERVAL_NS 16742706
+#define BENCH_WORK_NS 4000000
+
+static uint64_t bench_clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_work(void) {
+  uint64_t end = bench_clock_ns(CLOCK_MONOTONIC) + BENCH_WORK_NS;
+  while (bench_clock_ns(CLOCK_MONOTONIC) < end) {
+  }
+}
+
+static void bench_report(const char* name, uint64_t wall_ns, uint64_t wait_ns, uint64_t wait_cpu_ns, const frame_pacer_stats_t* stats) {
+  double rate_error = ((double)wall_ns / BENCH_FRAMES / BENCH_INTERVAL_NS - 1) * 100;
+  double wait_cpu = (double)wait_cpu_ns / wait_ns * 100;
+  printf("%-10s %+11.4f%% %10.0f %10.0f %10.0f %9.2f%% %8lu\n", name, rate_error, frame_pacer_percentile_ns(stats, 0.5) / 1e3,
+         frame_pacer_percentile_ns(stats, 0.99) / 1e3, stats->error_max_ns / 1e3, wait_cpu, (unsigned long)stats->late);
+}
+
+int main(void) {
+  printf("%-10s %12s %10s %10s %10s %10s %8s\n", "pacing", "rate error", "p50 <us", "p99 <us", "max us", "wait cpu", "late");
+
+  // relative: whatever the frame took is added to every interval
+  frame_pacer_stats_t relative = {0};
+  uint64_t wait_ns = 0, wait_cpu_ns = 0;
+  uint64_t start = bench_clock_ns(CLOCK_MONOTONIC);
+  for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+    bench_work();
+    uint64_t wait_start = bench_clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu_start = bench_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    usleep(BENCH_INTERVAL_NS / 1000);
+    wait_cpu_ns += bench_clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    wait_ns += bench_clock_ns(CLOCK_MONOTONIC) - wait_start;
+    uint64_t deadline = start + (uint64_t)(frame + 1) * BENCH_INTERVAL_NS;
+    uint64_t error = bench_clock_ns(CLOCK_MONOTONIC) - deadline;
+    relative.error_max_ns = error > relative.error_max_ns ? error : relative.error_max_ns;
+    relative.late += 1;
+    // off the end of the histogram
+    relative.histogram[FRAME_PACER_BUCKETS - 1] += 1;
+  }
+  bench_report("usleep", bench_clock_ns(CLOCK_MONOTONIC) - start, wait_ns, wait_cpu_ns, &relative);
+
+  frame_pacer_t pacer;
+  wait_ns = 0;
+  wait_cpu_ns = 0;
+  start = bench_clock_ns(CLOCK_MONOTONIC);
+  frame_pacer_init(&pacer, BENCH_INTERVAL_NS);
+  for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+    bench_work();
+    uint64_t wait_start = bench_clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu_start = bench_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    frame_pacer_wait(&pacer);
+    wait_cpu_ns += bench_clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    wait_ns += bench_clock_ns(CLOCK_MONOTONIC) - wait_start;
+  }
+  bench_report("pacer", bench_clock_ns(CLOCK_MONOTONIC) - start, wait_ns, wait_cpu_ns, &pacer.stats);
+  printf("pacer spun %.1fms in all, %.1fus a frame, last spin margin %.0fus\n", pacer.stats.spin_total_ns / 1e6,
+         pacer.stats.spin_total_ns / 1e3 / BENCH_FRAMES, pacer.spin_ns / 1e3);
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <time.h>
+
+#include "frame_pacer.h"
+
+#define TEST_INTERVAL_NS 10000000
+#define TEST_FRAMES 30
+
+static uint64_t test_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void test_sleep_ns(uint64_t ns) {
+  struct timespec ts = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+  nanosleep(&ts, NULL);
+}
+
+/*
+ * Work that takes up part of every frame does not stretch the frames, the
+ * deadlines stay on their grid
+ */
+Test(frame_pacer, work_between_waits_does_not_drift) {
+  frame_pacer_t pacer;
+  uint64_t start = test_now_ns();
+  frame_pacer_init(&pacer, TEST_INTERVAL_NS);
+  uint64_t first = pacer.deadline_ns;
+  for (int i = 0; i < TEST_FRAMES; ++i) {
+    test_sleep_ns(TEST_INTERVAL_NS / 2);
+    frame_pacer_wait(&pacer);
+  }
+  cr_assert(ge(u64, test_now_ns() - start, (uint64_t)TEST_FRAMES * TEST_INTERVAL_NS));
+  cr_assert(eq(u64, pacer.stats.resyncs, 0));
+  cr_assert(eq(u64, pacer.deadline_ns, first + (uint64_t)TEST_FRAMES * TEST_INTERVAL_NS));
+}
+
+Test(frame_pacer, every_frame_is_in_the_histogram) {
+  frame_pacer_t pacer;
+  frame_pacer_init(&pacer, TEST_INTERVAL_NS);
+  for (int i = 0; i < 10; ++i) {
+    frame_pacer_wait(&pacer);
+  }
+  uint64_t total = 0;
+  for (int i = 0; i < FRAME_PACER_BUCKETS; ++i) {
+    total += pacer.stats.histogram[i];
+  }
+  cr_assert(eq(u64, total, 10));
+  cr_assert(eq(u64, pacer.stats.frames, 10));
+}
+
+Test(frame_pacer, a_long_stall_starts_a_new_grid) {
+  frame_pacer_t pacer;
+  frame_pacer_init(&pacer, TEST_INTERVAL_NS);
+  frame_pacer_wait(&pacer);
+  test_sleep_ns((FRAME_PACER_MAX_LAG + 4) * TEST_INTERVAL_NS);
+  frame_pacer_wait(&pacer);
+  cr_assert(eq(u64, pacer.stats.resyncs, 1));
+
+  // the frames after it are paced again rather than rushed through
+  uint64_t start = test_now_ns();
+  for (int i = 0; i < 5; ++i) {
+    frame_pacer_wait(&pacer);
+  }
+  cr_assert(ge(u64, test_now_ns() - start, 4 * TEST_INTERVAL_NS));
+}
+
+Test(frame_pacer, a_short_stall_is_caught_up) {
+  frame_pacer_t pacer;
+  frame_pacer_init(&pacer, TEST_INTERVAL_NS);
+  frame_pacer_wait(&pacer);
+  test_sleep_ns(2 * TEST_INTERVAL_NS + TEST_INTERVAL_NS / 2);
+  frame_pacer_wait(&pacer);
+  frame_pacer_wait(&pacer);
+  cr_assert(eq(u64, pacer.stats.resyncs, 0));
+  cr_assert(ge(u64, pacer.stats.late, 2));
+}
+
+Test(frame_pacer, percentiles_come_from_the_histogram) {
+  frame_pacer_stats_t stats = {0};
+  // 90 frames under 1us, 9 at 8-16us, 1 way out
+  stats.histogram[0] = 90;
+  stats.histogram[4] = 9;
+  stats.histogram[FRAME_PACER_BUCKETS - 1] = 1;
+  stats.error_max_ns = 5000000;
+  cr_assert(eq(u64, frame_pacer_percentile_ns(&stats, 0.5), 1000));
+  cr_assert(eq(u64, frame_pacer_percentile_ns(&stats, 0.99), 16000));
+  cr_assert(eq(u64, frame_pacer_percentile_ns(&stats, 1), 5000000));
+}
@@ -1,31 +1,118 @@
 #include "thread_events.h"
-#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-thread_event_t thread_event_create() {
-  thread_event_t te = {0};
+/*
+ * Spinning only pays off when the thread being waited on can run meanwhile,
+ * on a single CPU it just delays the sleep that lets it
+ */
+static int spin_limit(void) {
+  static _Atomic int spins = -1;
+  int limit = atomic_load_explicit(&spins, memory_order_relaxed);
+  if (limit < 0) {
+    limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? THREAD_EVENT_SPINS : 0;
+    atomic_store_explicit(&spins, limit, memory_order_relaxed);
+  }
+  return limit;
+}
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// absolute CLOCK_MONOTONIC deadline, NULL for none
+static long futex_wait(_Atomic uint32_t* word, uint32_t expected, const struct timespec* deadline) {
+  //
+  return syscall(SYS_futex, word, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, expected, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+static void futex_wake(_Atomic uint32_t* word, int count) {
+  //
+  syscall(SYS_futex, word, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, NULL, NULL, 0);
+}
 
-  pthread_mutex_init(&te.mut, NULL);
-  pthread_cond_init(&te.cond, NULL);
+static void lock_acquire(thread_event_t* te) {
+  uint32_t state = 0;
+  if (atomic_compare_exchange_strong_explicit(&te->lock, &state, 1, memory_order_acquire, memory_order_relaxed)) {
+    return;
+  }
+  for (int i = spin_limit(); i > 0; --i) {
+    cpu_relax();
+    state = 0;
+    if (atomic_compare_exchange_weak_explicit(&te->lock, &state, 1, memory_order_acquire, memory_order_relaxed)) {
+      return;
+    }
+  }
+  // from here on the lock is marked as having sleepers, whoever lets it go wakes one
+  if (state != 2) {
+    state = atomic_exchange_explicit(&te->lock, 2, memory_order_acquire);
+  }
+  while (state != 0) {
+    futex_wait(&te->lock, 2, NULL);
+    state = atomic_exchange_explicit(&te->lock, 2, memory_order_acquire);
+  }
+}
+
+static void lock_release(thread_event_t* te) {
+  if (atomic_exchange_explicit(&te->lock, 0, memory_order_release) == 2) {
+    futex_wake(&te->lock, 1);
+  }
+}
 
+thread_event_t thread_event_create() {
+  thread_event_t te = {0};
   return te;
 }
 
 void thread_event_register(thread_event_t* te) {
-  //
-  pthread_mutex_lock(&te->mut);
+  lock_acquire(te);
+  te->seen = atomic_load_explicit(&te->sequence, memory_order_acquire);
 }
 
 void thread_event_wait(thread_event_t* te) {
   //
-  pthread_cond_wait(&te->cond, &te->mut);
+  thread_event_wait_until(te, NULL);
+}
+
+bool thread_event_wait_until(thread_event_t* te, const struct timespec* deadline) {
+  uint32_t seen = te->seen;
+  lock_release(te);
+
+  bool triggered = false;
+  for (int i = spin_limit(); i > 0 && !triggered; --i) {
+    triggered = atomic_load_explicit(&te->sequence, memory_order_acquire) != seen;
+    cpu_relax();
+  }
+  if (!triggered) {
+    // a trigger either sees this sleeper or has already moved `sequence` on, which the futex checks
+    atomic_fetch_add_explicit(&te->sleepers, 1, memory_order_seq_cst);
+    while (!(triggered = atomic_load_explicit(&te->sequence, memory_order_seq_cst) != seen)) {
+      if (futex_wait(&te->sequence, seen, deadline) == -1 && errno == ETIMEDOUT) {
+        triggered = atomic_load_explicit(&te->sequence, memory_order_acquire) != seen;
+        break;
+      }
+    }
+    atomic_fetch_sub_explicit(&te->sleepers, 1, memory_order_relaxed);
+  }
+
+  lock_acquire(te);
+  te->seen = atomic_load_explicit(&te->sequence, memory_order_acquire);
+  return triggered;
 }
 
 void thread_event_trigger(thread_event_t* te) {
-  //
-  pthread_cond_broadcast(&te->cond);
+  atomic_fetch_add_explicit(&te->sequence, 1, memory_order_seq_cst);
+  if (atomic_load_explicit(&te->sleepers, memory_order_seq_cst) > 0) {
+    futex_wake(&te->sequence, INT_MAX);
+  }
 }
 
 void thread_event_finish(thread_event_t* te) {
   //
-  pthread_mutex_unlock(&te->mut);
+  lock_release(te);
 }
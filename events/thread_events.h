@@ -2,20 +2,44 @@
 #define EVENTS_THREAD_EVENTS_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
 /*
- * This is THIN wrapper around condition variables from the pthreads library.
- * The intention is to aid in code readability.
+ * A lock and a wakeup in one, built straight on Linux futexes. It is used
+ * like a mutex and condition variable: register takes the lock, wait gives it
+ * up while asleep and has it again on return, finish lets it go.
+ *
+ * Waiters sleep on `sequence`, which every trigger bumps. A waiter compares
+ * it with the value from when it took the lock, so a trigger made after that,
+ * with or without the lock, is never lost. With more than one CPU both the
+ * lock and the wait spin for a short while before going to sleep, and a
+ * trigger nobody sleeps on makes no system call. A zeroed event is ready to
+ * use.
+ *
+ * That includes the lock holder's own triggers: one made while holding the
+ * lock ends the holder's next wait too. A thread that triggers and then waits
+ * triggers first and registers after.
  */
 
+#define THREAD_EVENT_SPINS 128
+
 typedef struct {
-  pthread_mutex_t mut;
-  pthread_cond_t cond;
+  // 0 free, 1 held, 2 held with threads asleep on it
+  _Atomic uint32_t lock;
+  _Atomic uint32_t sequence;
+  _Atomic uint32_t sleepers;
+  // `sequence` as the lock's holder last saw it
+  uint32_t seen;
 } thread_event_t;
 
 thread_event_t thread_event_create();
 void thread_event_register(thread_event_t* te);
 void thread_event_wait(thread_event_t* te);
+// like thread_event_wait, false once CLOCK_MONOTONIC passes `deadline` without a trigger
+bool thread_event_wait_until(thread_event_t* te, const struct timespec* deadline);
 void thread_event_trigger(thread_event_t* te);
 void thread_event_finish(thread_event_t* te);
 
@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "thread_events.h"
+
+/*
+ * Compares thread_event_t with the mutex and condition variable it replaced,
+ * kept here as `condvar_event_t`:
+ *
+ *   trigger      register, trigger, finish with nobody waiting, what a
+ *                producer pays every frame while its consumer keeps up
+ *   wake         from a trigger to the sleeping thread running again
+ *   ping pong    two threads taking turns, the time and CPU per hand-over
+ */
+
+#define BENCH_TRIGGERS 2000000
+#define BENCH_WAKES 2000
+// long enough for the waiter to be asleep in the kernel, not spinning
+#define BENCH_WAKE_GAP_US 200
+#define BENCH_ROUNDS 50000
+
+typedef struct {
+  pthread_mutex_t mut;
+  pthread_cond_t cond;
+} condvar_event_t;
+
+static void condvar_register(void* te) {
+  //
+  pthread_mutex_lock(&((condvar_event_t*)te)->mut);
+}
+
+static void condvar_wait(void* te) {
+  //
+  pthread_cond_wait(&((condvar_event_t*)te)->cond, &((condvar_event_t*)te)->mut);
+}
+
+static void condvar_trigger(void* te) {
+  //
+  pthread_cond_broadcast(&((condvar_event_t*)te)->cond);
+}
+
+static void condvar_finish(void* te) {
+  //
+  pthread_mutex_unlock(&((condvar_event_t*)te)->mut);
+}
+
+static void futex_register(void* te) {
+  //
+  thread_event_register(te);
+}
+
+static void futex_wait(void* te) {
+  //
+  thread_event_wait(te);
+}
+
+static void futex_trigger(void* te) {
+  //
+  thread_event_trigger(te);
+}
+
+static void futex_finish(void* te) {
+  //
+  thread_event_finish(te);
+}
+
+typedef struct {
+  const char* name;
+  void (*register_)(void* te);
+  void (*wait)(void* te);
+  void (*trigger)(void* te);
+  void (*finish)(void* te);
+} bench_impl_t;
+
+static const bench_impl_t impls[] = {
+    {"condvar", condvar_register, condvar_wait, condvar_trigger, condvar_finish},
+    {  "futex",   futex_register,   futex_wait,   futex_trigger,   futex_finish},
+};
+
+typedef struct {
+  const bench_impl_t* impl;
+  void* te;
+  // a counter that only changes with the lock held, and when it changed
+  uint64_t sequence;
+  double triggered_ns;
+  double wake_total_ns;
+  double wake_max_ns;
+  int turn;
+} bench_shared_t;
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_trigger(const bench_impl_t* impl, void* te) {
+  double start = bench_now_ns();
+  for (int i = 0; i < BENCH_TRIGGERS; ++i) {
+    impl->register_(te);
+    impl->trigger(te);
+    impl->finish(te);
+  }
+  return (bench_now_ns() - start) / BENCH_TRIGGERS;
+}
+
+static void* wake_thread(void* args) {
+  bench_shared_t* shared = args;
+  const bench_impl_t* impl = shared->impl;
+  impl->register_(shared->te);
+  for (uint64_t seen = 0; seen < BENCH_WAKES; seen += 1) {
+    while (shared->sequence == seen) {
+      impl->wait(shared->te);
+    }
+    double latency = bench_now_ns() - shared->triggered_ns;
+    shared->wake_total_ns += latency;
+    shared->wake_max_ns = latency > shared->wake_max_ns ? latency : shared->wake_max_ns;
+  }
+  impl->finish(shared->te);
+  return NULL;
+}
+
+static void bench_wake(bench_shared_t* shared) {
+  pthread_t thread;
+  pthread_create(&thread, NULL, wake_thread, shared);
+  for (int i = 0; i < BENCH_WAKES; ++i) {
+    usleep(BENCH_WAKE_GAP_US);
+    shared->impl->register_(shared->te);
+    shared->sequence += 1;
+    shared->triggered_ns = bench_now_ns();
+    shared->impl->trigger(shared->te);
+    shared->impl->finish(shared->te);
+  }
+  pthread_join(thread, NULL);
+}
+
+static void ping_pong(bench_shared_t* shared, int player) {
+  const bench_impl_t* impl = shared->impl;
+  impl->register_(shared->te);
+  for (int i = 0; i < BENCH_ROUNDS; ++i) {
+    while (shared->turn != player) {
+      impl->wait(shared->te);
+    }
+    shared->turn = 1 - player;
+    impl->trigger(shared->te);
+  }
+  impl->finish(shared->te);
+}
+
+static void* ping_pong_thread(void* args) {
+  ping_pong(args, 1);
+  return NULL;
+}
+
+// returns ns per hand-over, and the CPU time it took in `cpu_ns`
+static double bench_ping_pong(bench_shared_t* shared, double* cpu_ns) {
+  double start = bench_now_ns();
+  double cpu_start = bench_cpu_ns();
+  pthread_t thread;
+  pthread_create(&thread, NULL, ping_pong_thread, shared);
+  ping_pong(shared, 0);
+  pthread_join(thread, NULL);
+  *cpu_ns = (bench_cpu_ns() - cpu_start) / (2 * BENCH_ROUNDS);
+  return (bench_now_ns() - start) / (2 * BENCH_ROUNDS);
+}
+
+int main(void) {
+  printf("%-8s %12s %12s %12s %14s %14s\n", "event", "trigger ns", "wake us", "max wake us", "hand-over us", "cpu/hand-over");
+  for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i) {
+    condvar_event_t condvar = {.mut = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+    thread_event_t futex = thread_event_create();
+    void* te = i == 0 ? (void*)&condvar : (void*)&futex;
+
+    double trigger_ns = bench_trigger(&impls[i], te);
+    bench_shared_t shared = {.impl = &impls[i], .te = te};
+    bench_wake(&shared);
+    double wake_us = shared.wake_total_ns / BENCH_WAKES / 1e3;
+    double wake_max_us = shared.wake_max_ns / 1e3;
+    shared = (bench_shared_t){.impl = &impls[i], .te = te};
+    double cpu_ns;
+    double hand_over_ns = bench_ping_pong(&shared, &cpu_ns);
+    printf("%-8s %12.1f %12.2f %12.2f %14.2f %13.2fus\n", impls[i].name, trigger_ns, wake_us, wake_max_us, hand_over_ns / 1e3, cpu_ns / 1e3);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <pthread.h>
+
+#include "thread_events.h"
+
+#define CONTENDED_INCREMENTS 200000
+#define PING_PONG_ROUNDS 2000
+
+static struct timespec deadline_in(long ms) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec += 1;
+    ts.tv_nsec -= 1000000000;
+  }
+  return ts;
+}
+
+static double elapsed_ms(const struct timespec* since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) * 1e3 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+Test(thread_events, a_trigger_before_the_wait_is_not_lost) {
+  thread_event_t te = thread_event_create();
+  thread_event_register(&te);
+  thread_event_trigger(&te);
+  struct timespec deadline = deadline_in(1000);
+  cr_assert(thread_event_wait_until(&te, &deadline));
+  thread_event_finish(&te);
+}
+
+Test(thread_events, a_trigger_before_registering_does_not_end_the_wait) {
+  thread_event_t te = thread_event_create();
+  thread_event_trigger(&te);
+  thread_event_register(&te);
+  struct timespec deadline = deadline_in(20);
+  cr_assert(not(thread_event_wait_until(&te, &deadline)));
+  thread_event_finish(&te);
+}
+
+typedef struct {
+  thread_event_t event;
+  _Atomic uint64_t tail;
+  uint64_t head;
+  bool stopping;
+} idle_pipeline_t;
+
+/*
+ * The consumer loop of the APU pipeline: sleep until there is something
+ * logged, play it, then wake whoever waits for room or for a flush
+ */
+static void* idle_pipeline_thread(void* args) {
+  idle_pipeline_t* pipeline = args;
+  while (true) {
+    thread_event_register(&pipeline->event);
+    uint64_t tail;
+    while ((tail = atomic_load(&pipeline->tail)) == pipeline->head && !pipeline->stopping) {
+      thread_event_wait(&pipeline->event);
+    }
+    thread_event_finish(&pipeline->event);
+    if (tail == pipeline->head) {
+      break;
+    }
+    pipeline->head = tail;
+    thread_event_trigger(&pipeline->event);
+  }
+  return NULL;
+}
+
+Test(thread_events, an_idle_pipeline_sleeps) {
+  static idle_pipeline_t pipeline;
+  pipeline = (idle_pipeline_t){.event = thread_event_create()};
+  pthread_t thread;
+  pthread_create(&thread, NULL, idle_pipeline_thread, &pipeline);
+  // one round through so the consumer has triggered at least once
+  atomic_store(&pipeline.tail, 1);
+  thread_event_trigger(&pipeline.event);
+
+  clockid_t clock;
+  pthread_getcpuclockid(thread, &clock);
+  struct timespec before, after;
+  struct timespec pause = {.tv_nsec = 200000000};
+  nanosleep(&pause, NULL);
+  clock_gettime(clock, &before);
+  nanosleep(&pause, NULL);
+  clock_gettime(clock, &after);
+
+  thread_event_register(&pipeline.event);
+  pipeline.stopping = true;
+  thread_event_trigger(&pipeline.event);
+  thread_event_finish(&pipeline.event);
+  pthread_join(thread, NULL);
+  cr_assert(eq(u64, pipeline.head, 1));
+  double cpu_ms = (after.tv_sec - before.tv_sec) * 1e3 + (after.tv_nsec - before.tv_nsec) / 1e6;
+  cr_assert(lt(dbl, cpu_ms, 20));
+}
+
+Test(thread_events, a_wait_gives_up_at_its_deadline) {
+  thread_event_t te = thread_event_create();
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct timespec deadline = deadline_in(20);
+  thread_event_register(&te);
+  cr_assert(not(thread_event_wait_until(&te, &deadline)));
+  thread_event_finish(&te);
+  cr_assert(ge(dbl, elapsed_ms(&start), 19.5));
+}
+
+typedef struct {
+  thread_event_t event;
+  uint64_t counter;
+  // whose turn it is in the ping pong, 0 or 1
+  int turn;
+  bool timed_out;
+} shared_t;
+
+static void* contended_increments(void* args) {
+  shared_t* shared = args;
+  for (int i = 0; i < CONTENDED_INCREMENTS; ++i) {
+    thread_event_register(&shared->event);
+    shared->counter += 1;
+    thread_event_finish(&shared->event);
+  }
+  return NULL;
+}
+
+Test(thread_events, the_lock_excludes) {
+  static shared_t shared;
+  shared = (shared_t){.event = thread_event_create()};
+  pthread_t other;
+  pthread_create(&other, NULL, contended_increments, &shared);
+  contended_increments(&shared);
+  pthread_join(other, NULL);
+  cr_assert(eq(u64, shared.counter, 2 * CONTENDED_INCREMENTS));
+}
+
+static void ping_pong(shared_t* shared, int player) {
+  thread_event_register(&shared->event);
+  for (int i = 0; i < PING_PONG_ROUNDS; ++i) {
+    while (shared->turn != player && !shared->timed_out) {
+      struct timespec deadline = deadline_in(5000);
+      shared->timed_out |= !thread_event_wait_until(&shared->event, &deadline) && shared->turn != player;
+    }
+    shared->turn = 1 - player;
+    thread_event_trigger(&shared->event);
+  }
+  thread_event_finish(&shared->event);
+}
+
+static void* ping_pong_thread(void* args) {
+  ping_pong(args, 1);
+  return NULL;
+}
+
+Test(thread_events, every_trigger_wakes_a_sleeping_thread) {
+  static shared_t shared;
+  shared = (shared_t){.event = thread_event_create()};
+  pthread_t other;
+  pthread_create(&other, NULL, ping_pong_thread, &shared);
+  ping_pong(&shared, 0);
+  pthread_join(other, NULL);
+  cr_assert(not(shared.timed_out));
+}
@@ -0,0 +1,61 @@
+#include "triple_buffer.h"
+
+#define MIDDLE_FRESH 0x80
+#define MIDDLE_INDEX 0x03
+
+void triple_buffer_init(triple_buffer_t* tb) {
+  tb->back = 0;
+  atomic_init(&tb->middle, 1);
+  tb->front = 2;
+  atomic_init(&tb->published, 0);
+  atomic_init(&tb->dropped, 0);
+  atomic_init(&tb->duplicated, 0);
+  tb->notify = NULL;
+  tb->notify_data = NULL;
+}
+
+// set before the producer starts publishing
+void triple_buffer_set_notify(triple_buffer_t* tb, triple_buffer_notify_f notify, void* data) {
+  tb->notify = notify;
+  tb->notify_data = data;
+}
+
+frame_t* triple_buffer_back(triple_buffer_t* tb) {
+  //
+  return &tb->frames[tb->back];
+}
+
+void triple_buffer_publish(triple_buffer_t* tb) {
+  // release: the pixels written into the back buffer are visible to whoever swaps it out
+  uint8_t previous = atomic_exchange_explicit(&tb->middle, tb->back | MIDDLE_FRESH, memory_order_acq_rel);
+  tb->back = previous & MIDDLE_INDEX;
+  atomic_fetch_add_explicit(&tb->published, 1, memory_order_relaxed);
+  if (previous & MIDDLE_FRESH) {
+    // the consumer has not been to pick up the last one, it still has that notification coming
+    atomic_fetch_add_explicit(&tb->dropped, 1, memory_order_relaxed);
+  } else if (tb->notify != NULL) {
+    tb->notify(tb->notify_data);
+  }
+}
+
+const frame_t* triple_buffer_acquire(triple_buffer_t* tb, bool* is_new) {
+  bool fresh = atomic_load_explicit(&tb->middle, memory_order_relaxed) & MIDDLE_FRESH;
+  if (fresh) {
+    uint8_t previous = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+    tb->front = previous & MIDDLE_INDEX;
+  } else {
+    atomic_fetch_add_explicit(&tb->duplicated, 1, memory_order_relaxed);
+  }
+  if (is_new != NULL) {
+    *is_new = fresh;
+  }
+  return &tb->frames[tb->front];
+}
+
+triple_buffer_stats_t triple_buffer_stats(triple_buffer_t* tb) {
+  return (triple_buffer_stats_t){
+      .published = atomic_load_explicit(&tb->published, memory_order_relaxed),
+      .dropped = atomic_load_explicit(&tb->dropped, memory_order_relaxed),
+      .duplicated = atomic_load_explicit(&tb->duplicated, memory_order_relaxed),
+  };
+}
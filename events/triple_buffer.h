@@ -0,0 +1,64 @@
+#ifndef EVENTS_TRIPLE_BUFFER_H
+#define EVENTS_TRIPLE_BUFFER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../display.h"
+
+/*
+ * Hands finished frames from the emulator thread to a consumer without
+ * either side ever waiting on the other.
+ *
+ * The producer owns the back buffer and the consumer owns the front buffer.
+ * The third one sits in `middle` together with a flag saying whether it holds
+ * a frame the consumer has not picked up yet. Publishing swaps back and middle,
+ * acquiring swaps front and middle, each with a single atomic exchange.
+ */
+
+typedef struct {
+  pixel_shade_t pixels[SCREEN_SIZE];
+  // a CGB frame's palette RAM as it was when the frame ended, see pixel_shade_t
+  bool cgb;
+  uint16_t colors[CGB_COLOR_COUNT];
+  uint64_t number;
+  // of `pixels` and on a CGB `colors`, equal hashes mean the frame did not change
+  uint64_t hash;
+} frame_t;
+
+typedef struct {
+  uint64_t published;
+  // published frames overwritten before the consumer got to them
+  uint64_t dropped;
+  // acquires that found no new frame and handed back the previous one
+  uint64_t duplicated;
+} triple_buffer_stats_t;
+
+/*
+ * Called on the producer's thread when a publish makes a new frame available
+ * and the consumer has picked up every earlier one, so there is at most one
+ * notification outstanding however fast frames come in.
+ */
+typedef void (*triple_buffer_notify_f)(void* data);
+
+typedef struct {
+  frame_t frames[3];
+  _Atomic uint8_t middle;
+  uint8_t back;
+  uint8_t front;
+  _Atomic uint64_t published;
+  _Atomic uint64_t dropped;
+  _Atomic uint64_t duplicated;
+  triple_buffer_notify_f notify;
+  void* notify_data;
+} triple_buffer_t;
+
+void triple_buffer_init(triple_buffer_t* tb);
+void triple_buffer_set_notify(triple_buffer_t* tb, triple_buffer_notify_f notify, void* data);
+frame_t* triple_buffer_back(triple_buffer_t* tb);
+void triple_buffer_publish(triple_buffer_t* tb);
+const frame_t* triple_buffer_acquire(triple_buffer_t* tb, bool* is_new);
+triple_buffer_stats_t triple_buffer_stats(triple_buffer_t* tb);
+
+#endif // !DEBUG
@@ -0,0 +1,83 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "triple_buffer.h"
+
+#define STRESS_FRAMES 20000
+
+Test(triple_buffer, newest_frame_wins) {
+  static triple_buffer_t tb;
+  triple_buffer_init(&tb);
+  bool is_new;
+
+  triple_buffer_back(&tb)->number = 1;
+  triple_buffer_publish(&tb);
+  triple_buffer_back(&tb)->number = 2;
+  triple_buffer_publish(&tb);
+
+  cr_assert(eq(u64, triple_buffer_acquire(&tb, &is_new)->number, 2));
+  cr_assert(is_new);
+  cr_assert(eq(u64, triple_buffer_acquire(&tb, &is_new)->number, 2));
+  cr_assert(not(is_new));
+
+  triple_buffer_stats_t stats = triple_buffer_stats(&tb);
+  cr_assert(eq(u64, stats.published, 2));
+  cr_assert(eq(u64, stats.dropped, 1));
+  cr_assert(eq(u64, stats.duplicated, 1));
+}
+
+static void* stress_producer(void* args) {
+  triple_buffer_t* tb = args;
+  for (uint64_t n = 1; n <= STRESS_FRAMES; ++n) {
+    frame_t* frame = triple_buffer_back(tb);
+    memset(frame->pixels, n & 0xFF, sizeof(frame->pixels));
+    frame->number = n;
+    triple_buffer_publish(tb);
+  }
+  return NULL;
+}
+
+Test(triple_buffer, frames_are_never_torn) {
+  static triple_buffer_t tb;
+  triple_buffer_init(&tb);
+  pthread_t producer;
+  pthread_create(&producer, NULL, stress_producer, &tb);
+
+  uint64_t last = 0;
+  bool torn = false;
+  bool backwards = false;
+  while (last < STRESS_FRAMES) {
+    const frame_t* frame = triple_buffer_acquire(&tb, NULL);
+    backwards |= frame->number < last;
+    last = frame->number;
+    for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+      torn |= frame->pixels[i] != (frame->number & 0xFF);
+    }
+  }
+  pthread_join(producer, NULL);
+
+  cr_assert(not(torn));
+  cr_assert(not(backwards));
+}
+
+static void count_notify(void* data) {
+  *(int*)data += 1;
+}
+
+Test(triple_buffer, notifies_once_per_pickup) {
+  static triple_buffer_t tb;
+  int notified = 0;
+  triple_buffer_init(&tb);
+  triple_buffer_set_notify(&tb, count_notify, &notified);
+
+  triple_buffer_publish(&tb);
+  triple_buffer_publish(&tb);
+  triple_buffer_publish(&tb);
+  cr_assert(eq(int, notified, 1));
+
+  triple_buffer_acquire(&tb, NULL);
+  triple_buffer_publish(&tb);
+  cr_assert(eq(int, notified, 2));
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash.h"
+
+#define HASH_STRIPES_PER_BLOCK 16
+#define HASH_PRIME32 0x9E3779B1u
+#define HASH_PRIME64 0x9E3779B97F4A7C15ull
+#define HASH_AVALANCHE 0x165667919E3779F9ull
+
+static const uint64_t HASH_KEYS[HASH_LANES * 2] = {
+    0x6E789E6AA1B965F4ull, 0x06C45D188009454Full, 0xF88BB8A8724C81ECull, 0x1B39896A51A8749Bull,
+    0x53CB9F0C747EA2EAull, 0x2C829ABE1F4532E1ull, 0xC584133AC916AB3Cull, 0x3EE5789041C98AC3ull,
+    0xF3B8488C368CB0A6ull, 0x657EECDD3CB13D09ull, 0xC2D326E0055BDEF6ull, 0x8621A03FE0BBDB7Bull,
+    0x8E1F7555983AA92Full, 0xB54E0F1600CC4D19ull, 0x84BB3F97971D80ABull, 0x7D29825C75521255ull,
+};
+
+#if defined(__SSE2__)
+
+static void hash_accumulate(uint64_t acc[HASH_LANES], const uint8_t* data, size_t stripes) {
+  __m128i* lanes = (__m128i*)acc;
+  const __m128i* keys = (const __m128i*)HASH_KEYS;
+  for (size_t stripe = 0; stripe < stripes; ++stripe) {
+    const __m128i* input = (const __m128i*)(data + stripe * HASH_STRIPE_BYTES);
+    for (int i = 0; i < HASH_LANES / 2; ++i) {
+      __m128i value = _mm_loadu_si128(&input[i]);
+      __m128i keyed = _mm_xor_si128(value, _mm_loadu_si128(&keys[i]));
+      // low half times high half of every 64-bit lane
+      __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+      __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+      lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+    }
+  }
+}
+
+static void hash_scramble(uint64_t acc[HASH_LANES]) {
+  __m128i* lanes = (__m128i*)acc;
+  const __m128i* keys = (const __m128i*)&HASH_KEYS[HASH_LANES];
+  const __m128i prime = _mm_set1_epi32(HASH_PRIME32);
+  for (int i = 0; i < HASH_LANES / 2; ++i) {
+    __m128i lane = _mm_xor_si128(lanes[i], _mm_srli_epi64(lanes[i], 47));
+    lane = _mm_xor_si128(lane, _mm_loadu_si128(&keys[i]));
+    // 64x32 multiply out of two 32x32->64 ones
+    __m128i low = _mm_mul_epu32(lane, prime);
+    __m128i high = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(lane, 32), prime), 32);
+    lanes[i] = _mm_add_epi64(low, high);
+  }
+}
+
+#else
+
+static uint64_t read64(const uint8_t* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+static void hash_accumulate(uint64_t acc[HASH_LANES], const uint8_t* data, size_t stripes) {
+  for (size_t stripe = 0; stripe < stripes; ++stripe) {
+    const uint8_t* input = data + stripe * HASH_STRIPE_BYTES;
+    for (int i = 0; i < HASH_LANES; ++i) {
+      uint64_t value = read64(input + i * 8);
+      uint64_t keyed = value ^ HASH_KEYS[i];
+      acc[i ^ 1] += value;
+      acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+    }
+  }
+}
+
+static void hash_scramble(uint64_t acc[HASH_LANES]) {
+  for (int i = 0; i < HASH_LANES; ++i) {
+    uint64_t lane = acc[i] ^ (acc[i] >> 47);
+    lane ^= HASH_KEYS[HASH_LANES + i];
+    acc[i] = lane * HASH_PRIME32;
+  }
+}
+
+#endif
+
+static uint64_t hash_fold(uint64_t a, uint64_t b) {
+  unsigned __int128 product = (unsigned __int128)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static uint64_t hash_avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= HASH_AVALANCHE;
+  return h ^ (h >> 32);
+}
+
+uint64_t hash64(const void* data, size_t length) {
+  const uint8_t* bytes = data;
+  _Alignas(16) uint64_t acc[HASH_LANES];
+  for (int i = 0; i < HASH_LANES; ++i) {
+    acc[i] = HASH_KEYS[i] * (i + 1);
+  }
+
+  size_t stripes = length / HASH_STRIPE_BYTES;
+  while (stripes >= HASH_STRIPES_PER_BLOCK) {
+    hash_accumulate(acc, bytes, HASH_STRIPES_PER_BLOCK);
+    hash_scramble(acc);
+    bytes += HASH_STRIPES_PER_BLOCK * HASH_STRIPE_BYTES;
+    stripes -= HASH_STRIPES_PER_BLOCK;
+  }
+  hash_accumulate(acc, bytes, stripes);
+  bytes += stripes * HASH_STRIPE_BYTES;
+
+  // the tail goes through as a zero padded stripe, the length tells it apart from real zeros
+  size_t tail = length % HASH_STRIPE_BYTES;
+  if (tail > 0) {
+    uint8_t last[HASH_STRIPE_BYTES] = {0};
+    memcpy(last, bytes, tail);
+    hash_accumulate(acc, last, 1);
+  }
+
+  uint64_t h = length * HASH_PRIME64;
+  for (int i = 0; i < HASH_LANES; i += 2) {
+    h += hash_fold(acc[i] ^ HASH_KEYS[HASH_LANES + i], acc[i + 1] ^ HASH_KEYS[HASH_LANES + i + 1]);
+  }
+  return hash_avalanche(h);
+}
@@ -0,0 +1,21 @@
+#ifndef EMULATOR_HASH_H
+#define EMULATOR_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 64-bit non-cryptographic hash in the style of XXH3: eight 64-bit lanes
+ * accumulate 64-byte stripes with a 32x32->64 multiply, get scrambled every
+ * 1 KiB and are folded together at the end.
+ *
+ * The SSE2 and scalar paths give the same value for the same bytes, so hashes
+ * recorded on one machine can be compared on another.
+ */
+
+#define HASH_STRIPE_BYTES 64
+#define HASH_LANES 8
+
+uint64_t hash64(const void* data, size_t length);
+
+#endif // !DEBUG
@@ -0,0 +1,40 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <string.h>
+
+#include "hash.h"
+
+static void fill_pattern(uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    data[i] = i * 7 + (i >> 8);
+  }
+}
+
+Test(hash, known_values) {
+  static uint8_t data[23040];
+  fill_pattern(data, sizeof(data));
+
+  // recorded hashes are only worth anything if these never move
+  cr_assert(eq(u64, hash64(data, 0), 0x4779a5365d4370f2));
+  cr_assert(eq(u64, hash64(data, 65), 0x3ef383b60ea46e88));
+  cr_assert(eq(u64, hash64(data, sizeof(data)), 0x395b2cdbbc012b54));
+}
+
+Test(hash, every_bit_matters) {
+  static uint8_t data[23040];
+  fill_pattern(data, sizeof(data));
+  uint64_t reference = hash64(data, sizeof(data));
+
+  for (size_t byte = 0; byte < sizeof(data); byte += 997) {
+    data[byte] ^= 1 << (byte % 8);
+    cr_assert(ne(u64, hash64(data, sizeof(data)), reference));
+    data[byte] ^= 1 << (byte % 8);
+  }
+}
+
+Test(hash, trailing_zeros_change_the_hash) {
+  uint8_t data[HASH_STRIPE_BYTES] = {1, 2, 3};
+
+  cr_assert(ne(u64, hash64(data, 3), hash64(data, 4)));
+  cr_assert(ne(u64, hash64(data, 3), hash64(data, HASH_STRIPE_BYTES)));
+}
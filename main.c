@@ -2,22 +2,366 @@
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
 
+#include "audio/output.h"
+#include "capture/capture.h"
+#include "capture/wav.h"
 #include "emulator/gameboy.h"
 #include "render/render.h"
 
 #define TEST_ROM "./test.gb"
 #define ROM_PATH TEST_ROM
 
+// how far off 59.73 Hz a display can be and still have the emulator run at its rate
+#define REFRESH_MATCH_RANGE 0.02
+// how many times as fast the emulator runs while tab is held
+#define TURBO_SPEED 4
+// --frame-skip auto draws no fewer than one frame out of this many
+#define FRAME_SKIP_AUTO_MAX 4
+
 typedef struct {
   pthread_t gb_thread;
   gameboy_thread_args_t gb_thread_args;
+  // only joined once started, SDL_AppQuit also runs after a failed SDL_AppInit
+  bool gb_thread_started;
   gameboy_t* gb;
   render_state_t* rs;
+  // hash of the frame on screen, identical frames are not drawn again
+  uint64_t drawn_hash;
+  // with --ghosting, whether that frame has been drawn twice in a row and the screen shows it unblended
+  bool ghost_settled;
+  // pushed by the emulator thread when it has a frame waiting
+  Uint32 frame_event;
+  // --capture/--capture-rgb <path>, NULL when not capturing
+  capture_t* capture;
+  // --headless <frames>: no window, quit once that many frames are out
+  uint64_t headless_frames;
+  // --mosaic <count>: `gb` and count - 1 more instances, shown side by side
+  uint16_t instance_count;
+  gameboy_t* instances[MOSAIC_MAX_INSTANCES];
+  pthread_t instance_threads[MOSAIC_MAX_INSTANCES];
+  bool instance_thread_started[MOSAIC_MAX_INSTANCES];
+  gameboy_thread_args_t instance_args[MOSAIC_MAX_INSTANCES];
+  mosaic_t* mosaic;
+  // --color-correction, --ghosting
+  bool correct_colors;
+  bool ghosting;
+  // NULL when there is no audio device
+  audio_output_t* audio;
+  // --stats: latency and rate control over the screen
+  bool show_stats;
+  // --audio-dump <file.wav>, --audio-dump-channels, --audio-hashes <file>
+  const char* audio_dump_path;
+  bool audio_dump_channels;
+  const char* audio_hashes_path;
+  wav_capture_t* audio_dump;
+  blip_t* channel_outputs;
+  // --audio-thread: synthesize on a thread of its own
+  bool audio_thread;
+  // --cooperative: no emulator threads, SDL_AppIterate runs the emulators itself
+  bool cooperative;
+  // --cgb: every instance runs as a Game Boy Color
+  bool cgb;
+  // --frame-skip <n | auto>: every instance draws one frame out of n, or as many as the host keeps up with
+  ppu_frame_skip_mode_t frame_skip;
+  uint8_t frame_skip_interval;
+  // --ppu-workers <n>: every instance draws its frames on n threads of its own, 0 draws on the emulator thread
+  uint8_t ppu_workers;
+  // --filter <nearest | epx | lcd-grid | xbr>: how the screen is scaled up to the window
+  scale_filter_t filter;
+  // what the keyboard has asked of the emulators so far, see SDL_AppEvent
+  double speed;
+  uint8_t buttons;
+  bool paused;
+  // F5 saves `gb` into it, F9 loads it back, NULL until the first save
+  gameboy_state_t* saved_state;
 } appstate_t;
 
+static void capture_frame(void* data, const frame_t* frame) {
+  //
+  capture_submit((capture_t*)data, frame);
+}
+
+/*
+ * The device's clock paces the emulator from here, and the APU makes the next
+ * frame's samples at whatever ratio rate control asks for, the emulator's
+ * speed divided out of it. With --audio-thread this runs on the APU thread,
+ * which is the one that owns `gb->apu` then.
+ *
+ * A dump keeps the APU at APU_SAMPLE_RATE, the rate its header promises and
+ * the one its hashes were taken at. The device then only has the push's wait
+ * and the ring to absorb the drift, the odd underrun is the price.
+ */
+static void handle_audio(void* data, const gameboy_audio_frame_t* frame) {
+  appstate_t* as = (appstate_t*)data;
+  if (as->audio_dump != NULL) {
+    const int16_t* const* channels = frame->channels[0] != NULL ? frame->channels : NULL;
+    wav_capture_submit(as->audio_dump, frame->number, frame->hash, frame->samples, channels, frame->frames);
+  }
+  if (as->audio != NULL) {
+    double ratio = audio_output_push(as->audio, frame->samples, frame->frames);
+    if (as->audio_dump == NULL) {
+      apu_set_sample_rate(&as->gb->apu, APU_SAMPLE_RATE * ratio);
+    }
+  }
+}
+
+/*
+ * Records what `gb` plays, false when a file cannot be created
+ */
+static bool start_audio_dump(appstate_t* as) {
+  if (as->audio_dump_channels) {
+    as->channel_outputs = SDL_malloc(sizeof(blip_t) * APU_CHANNEL_COUNT);
+    if (as->channel_outputs == NULL || !apu_set_channel_outputs(&as->gb->apu, as->channel_outputs)) {
+      return false;
+    }
+  }
+  as->audio_dump = SDL_aligned_alloc(64, sizeof(wav_capture_t));
+  if (as->audio_dump == NULL ||
+      !wav_capture_start(as->audio_dump, as->audio_dump_path, APU_SAMPLE_RATE, as->audio_dump_channels, as->audio_hashes_path)) {
+    SDL_Log("Could not record audio to %s", as->audio_dump_path);
+    SDL_aligned_free(as->audio_dump);
+    as->audio_dump = NULL;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Plays `gb` on the default device, the emulator goes on silently if there is
+ * none
+ */
+static void start_audio(appstate_t* as) {
+  as->audio = SDL_aligned_alloc(64, sizeof(audio_output_t));
+  if (as->audio == NULL || !audio_output_open(as->audio, APU_SAMPLE_RATE)) {
+    SDL_Log("No audio: %s", SDL_GetError());
+    SDL_aligned_free(as->audio);
+    as->audio = NULL;
+  }
+}
+
+/*
+ * Scales by the largest factor `filter` supports that still fits the window.
+ * A filter that fits none leaves the screen on nearest.
+ */
+static void select_filter(appstate_t* as) {
+  uint8_t factor = as->rs->pixel_stamp.w < SCALE_MAX_FACTOR ? as->rs->pixel_stamp.w : SCALE_MAX_FACTOR;
+  while (factor > 0 && !scaler_supports(as->filter, factor)) {
+    factor -= 1;
+  }
+  if (factor == 0 || !render_set_filter(as->rs, as->filter, factor)) {
+    SDL_Log("Filter does not fit the window, keeping nearest: filter=%d, stamp=%.0f", as->filter, as->rs->pixel_stamp.w);
+  }
+}
+
+/*
+ * Starts the capture and reads the remaining options, false on anything it
+ * does not understand
+ */
+static bool parse_options(appstate_t* as, int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if ((SDL_strcmp(argv[i], "--capture") == 0 || SDL_strcmp(argv[i], "--capture-rgb") == 0) && has_value && as->capture == NULL) {
+      capture_format_t format = SDL_strcmp(argv[i], "--capture") == 0 ? CAPTURE_FORMAT_Y4M : CAPTURE_FORMAT_RGB24;
+      as->capture = SDL_malloc(sizeof(capture_t));
+      if (as->capture == NULL || !capture_start(as->capture, argv[i + 1], format, DISPLAY_DMG_SHADES)) {
+        SDL_Log("Could not capture to %s", argv[i + 1]);
+        SDL_free(as->capture);
+        as->capture = NULL;
+        return false;
+      }
+      gameboy_set_frame_sink(as->gb, capture_frame, as->capture);
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--mosaic") == 0 && has_value) {
+      as->instance_count = SDL_atoi(argv[i + 1]);
+      if (as->instance_count < 1 || as->instance_count > MOSAIC_MAX_INSTANCES) {
+        SDL_Log("Mosaic instance count out of range: min=1, max=%d, got=%s", MOSAIC_MAX_INSTANCES, argv[i + 1]);
+        return false;
+      }
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--color-correction") == 0) {
+      as->correct_colors = true;
+    } else if (SDL_strcmp(argv[i], "--ghosting") == 0) {
+      as->ghosting = true;
+    } else if (SDL_strcmp(argv[i], "--stats") == 0) {
+      as->show_stats = true;
+    } else if (SDL_strcmp(argv[i], "--audio-dump") == 0 && has_value) {
+      as->audio_dump_path = argv[i + 1];
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--audio-dump-channels") == 0) {
+      as->audio_dump_channels = true;
+    } else if (SDL_strcmp(argv[i], "--audio-hashes") == 0 && has_value) {
+      as->audio_hashes_path = argv[i + 1];
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--audio-thread") == 0) {
+      as->audio_thread = true;
+    } else if (SDL_strcmp(argv[i], "--cooperative") == 0) {
+      as->cooperative = true;
+    } else if (SDL_strcmp(argv[i], "--cgb") == 0) {
+      as->cgb = true;
+    } else if (SDL_strcmp(argv[i], "--frame-skip") == 0 && has_value) {
+      if (SDL_strcmp(argv[i + 1], "auto") == 0) {
+        as->frame_skip = PPU_FRAME_SKIP_ADAPTIVE;
+        as->frame_skip_interval = FRAME_SKIP_AUTO_MAX;
+      } else {
+        int interval = SDL_atoi(argv[i + 1]);
+        if (interval < 1 || interval > UINT8_MAX) {
+          SDL_Log("Frame skip out of range: min=1, max=%d or auto, got=%s", UINT8_MAX, argv[i + 1]);
+          return false;
+        }
+        as->frame_skip = PPU_FRAME_SKIP_FIXED;
+        as->frame_skip_interval = interval;
+      }
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--audio-quality") == 0 && has_value) {
+      const char* names[] = {"low", "medium", "high"};
+      size_t quality = 0;
+      while (quality < sizeof(names) / sizeof(names[0]) && SDL_strcmp(argv[i + 1], names[quality]) != 0) {
+        quality += 1;
+      }
+      if (quality == sizeof(names) / sizeof(names[0])) {
+        SDL_Log("Unknown audio quality, expected low, medium or high, got=%s", argv[i + 1]);
+        return false;
+      }
+      apu_set_quality(&as->gb->apu, (blip_quality_t)quality);
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--filter") == 0 && has_value) {
+      // in scale_filter_t order
+      const char* names[] = {"nearest", "epx", "lcd-grid", "xbr"};
+      size_t filter = 0;
+      while (filter < sizeof(names) / sizeof(names[0]) && SDL_strcmp(argv[i + 1], names[filter]) != 0) {
+        filter += 1;
+      }
+      if (filter == sizeof(names) / sizeof(names[0])) {
+        SDL_Log("Unknown filter, expected nearest, epx, lcd-grid or xbr, got=%s", argv[i + 1]);
+        return false;
+      }
+      as->filter = (scale_filter_t)filter;
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--ppu-workers") == 0 && has_value) {
+      int workers = SDL_atoi(argv[i + 1]);
+      if (workers < 0 || workers > PPU_PIPELINE_MAX_WORKERS) {
+        SDL_Log("PPU worker count out of range: min=0, max=%d, got=%s", PPU_PIPELINE_MAX_WORKERS, argv[i + 1]);
+        return false;
+      }
+      as->ppu_workers = workers;
+      i += 1;
+    } else if (SDL_strcmp(argv[i], "--headless") == 0 && has_value) {
+      as->headless_frames = strtoull(argv[i + 1], NULL, 10);
+      i += 1;
+    } else {
+      SDL_Log("usage: %s [--capture <file.y4m | ->] [--capture-rgb <file | ->] [--headless <frames>] [--mosaic <count>]"
+              " [--color-correction] [--ghosting] [--stats] [--audio-quality <low | medium | high>] [--audio-thread] [--cooperative]"
+              " [--cgb] [--frame-skip <n | auto>] [--ppu-workers <n>] [--filter <nearest | epx | lcd-grid | xbr>]"
+              " [--audio-dump <file.wav> [--audio-dump-channels] [--audio-hashes <file>]]",
+              argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+static void push_frame_event(void* data) {
+  appstate_t* as = (appstate_t*)data;
+  SDL_Event event = {0};
+  event.type = as->frame_event;
+  SDL_PushEvent(&event);
+}
+
+/*
+ * Every running emulator gets it, the mosaic instances play along with `gb`
+ */
+static void send_all(appstate_t* as, command_t command) {
+  if (!gameboy_send(as->gb, command)) {
+    SDL_Log("The emulator is not taking commands, dropped one");
+  }
+  // by instance rather than by mosaic, the refresh rate is matched before the mosaic is up
+  for (uint16_t i = 1; i < as->instance_count && as->instances[i] != NULL; ++i) {
+    gameboy_send(as->instances[i], command);
+  }
+}
+
+/*
+ * Rather than showing some frames twice or skipping some to fit ~59.73 Hz
+ * onto the display, run the emulator that little bit faster or slower so it
+ * produces exactly one frame per refresh.
+ */
+static void match_refresh_rate(appstate_t* as) {
+  const SDL_DisplayMode* mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(as->rs->window));
+  if (mode == NULL) {
+    return;
+  }
+  double refresh = mode->refresh_rate;
+  if (mode->refresh_rate_denominator != 0) {
+    refresh = (double)mode->refresh_rate_numerator / mode->refresh_rate_denominator;
+  }
+  double ratio = refresh / GAMEBOY_FRAME_HZ;
+  if (ratio > 1 - REFRESH_MATCH_RANGE && ratio < 1 + REFRESH_MATCH_RANGE) {
+    as->speed = ratio;
+    send_all(as, (command_t){.type = GAMEBOY_COMMAND_SPEED, .ratio = ratio});
+    if (as->audio != NULL) {
+      audio_output_set_speed(as->audio, ratio);
+    }
+    SDL_Log("Matching the emulator to %.3f Hz (%.4fx)", refresh, ratio);
+  }
+}
+
+/*
+ * With nobody pushing frame events SDL_AppIterate has to run on a clock, once
+ * for every frame at the speed `gb` runs at
+ */
+static void set_cooperative_rate(appstate_t* as) {
+  char rate[32];
+  SDL_snprintf(rate, sizeof(rate), "%.3f", GAMEBOY_FRAME_HZ * as->speed);
+  SDL_SetHint(SDL_HINT_MAIN_CALLBACK_RATE, rate);
+}
+
+/*
+ * What the options ask of every instance, before its emulator starts
+ */
+static void configure_instance(appstate_t* as, gameboy_t* gb) {
+  if (as->cgb) {
+    gameboy_set_model(gb, GAMEBOY_MODEL_CGB);
+  }
+  ppu_set_frame_skip(gb, as->frame_skip, as->frame_skip_interval);
+  if (as->ppu_workers > 0 && !ppu_pipeline_start(gb, as->ppu_workers)) {
+    SDL_Log("Could not start the PPU workers, drawing on the emulator thread");
+  }
+}
+
+/*
+ * Boots the extra mosaic instances, each on its own emulator thread like `gb`
+ * unless SDL_AppIterate runs them
+ */
+static bool start_instances(appstate_t* as) {
+  as->instances[0] = as->gb;
+  for (uint16_t i = 1; i < as->instance_count; ++i) {
+    gameboy_t* gb = SDL_malloc(sizeof(gameboy_t));
+    if (gb == NULL || !gameboy_init(gb) || !gameboy_load_rom(gb, ROM_PATH)) {
+      SDL_free(gb);
+      return false;
+    }
+    configure_instance(as, gb);
+    as->instances[i] = gb;
+    if (as->cooperative) {
+      continue;
+    }
+    triple_buffer_set_notify(&gb->frames, push_frame_event, as);
+    as->instance_args[i] = (gameboy_thread_args_t){
+        .gb = gb,
+    };
+    as->instance_thread_started[i] = pthread_create(&as->instance_threads[i], NULL, gameboy_run_thread, &as->instance_args[i]) == 0;
+  }
+  return true;
+}
+
 SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
+  // SDL_AppIterate only runs after an event, so with nothing new to show the app sleeps (--cooperative runs it on a clock instead)
+  SDL_SetHint(SDL_HINT_MAIN_CALLBACK_RATE, "waitevent");
   SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
 
   // appstate
@@ -27,6 +371,37 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
     return SDL_APP_FAILURE;
   }
   *appstate = as;
+  as->gb = NULL;
+  as->gb_thread_started = false;
+  SDL_memset(as->instances, 0, sizeof(as->instances));
+  SDL_memset(as->instance_thread_started, 0, sizeof(as->instance_thread_started));
+  as->drawn_hash = 0;
+  as->ghost_settled = false;
+  as->capture = NULL;
+  as->headless_frames = 0;
+  as->instance_count = 1;
+  as->mosaic = NULL;
+  as->correct_colors = false;
+  as->ghosting = false;
+  as->rs = NULL;
+  as->audio = NULL;
+  as->show_stats = false;
+  as->audio_dump_path = NULL;
+  as->audio_dump_channels = false;
+  as->audio_hashes_path = NULL;
+  as->audio_dump = NULL;
+  as->channel_outputs = NULL;
+  as->audio_thread = false;
+  as->cooperative = false;
+  as->cgb = false;
+  as->frame_skip = PPU_FRAME_SKIP_OFF;
+  as->frame_skip_interval = 1;
+  as->ppu_workers = 0;
+  as->filter = SCALE_FILTER_NEAREST;
+  as->speed = 1;
+  as->buttons = 0;
+  as->paused = false;
+  as->saved_state = NULL;
 
   as->gb = SDL_malloc(sizeof(gameboy_t));
   if (as->gb == NULL) {
@@ -41,13 +416,43 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
     // TODO:
     return SDL_APP_FAILURE;
   }
-  as->gb_thread_args = (gameboy_thread_args_t){
-      .gb = as->gb,
-  };
-  if (!pthread_create(&as->gb_thread, NULL, gameboy_run_thread, &as->gb_thread_args)) {
-    // TODO:
+  if (!parse_options(as, argc, argv)) {
+    return SDL_APP_FAILURE;
+  }
+  configure_instance(as, as->gb);
+  if (as->audio_dump_path != NULL && !start_audio_dump(as)) {
+    return SDL_APP_FAILURE;
+  }
+  if (as->headless_frames == 0) {
+    start_audio(as);
+  }
+  if (as->audio != NULL || as->audio_dump != NULL) {
+    gameboy_set_audio_sink(as->gb, handle_audio, as);
+  }
+  if (as->audio_thread && !apu_pipeline_start(as->gb)) {
+    SDL_Log("Could not start the APU thread, synthesizing on the emulator thread");
+  }
+  as->frame_event = SDL_RegisterEvents(1);
+  if (as->cooperative) {
+    set_cooperative_rate(as);
+  } else {
+    triple_buffer_set_notify(&as->gb->frames, push_frame_event, as);
+    as->gb_thread_args = (gameboy_thread_args_t){
+        .gb = as->gb,
+    };
+    as->gb_thread_started = pthread_create(&as->gb_thread, NULL, gameboy_run_thread, &as->gb_thread_args) == 0;
+    if (!as->gb_thread_started) {
+      SDL_Log("Could not start the emulator thread");
+      return SDL_APP_FAILURE;
+    }
   }
 
+  if (as->headless_frames > 0) {
+    return SDL_APP_CONTINUE;
+  }
+  if (as->instance_count > 1 && !start_instances(as)) {
+    return SDL_APP_FAILURE;
+  }
   as->rs = SDL_malloc(sizeof(render_state_t));
   if (as->rs == NULL) {
     // TODO:
@@ -56,30 +461,292 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
   if (!render_state_init(as->rs, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0)) {
     // TODO:
   }
-
-  // TODO: sound?
+  match_refresh_rate(as);
+  if (as->cooperative) {
+    set_cooperative_rate(as);
+  }
+  postprocess_set_effects(&as->rs->post, as->correct_colors, as->ghosting);
+  if (as->filter != SCALE_FILTER_NEAREST) {
+    select_filter(as);
+  }
+  if (as->instance_count > 1) {
+    triple_buffer_t* sources[MOSAIC_MAX_INSTANCES];
+    for (uint16_t i = 0; i < as->instance_count; ++i) {
+      sources[i] = &as->instances[i]->frames;
+    }
+    as->mosaic = SDL_malloc(sizeof(mosaic_t));
+    if (as->mosaic == NULL || !mosaic_init(as->mosaic, as->rs->renderer, sources, as->instance_count)) {
+      return SDL_APP_FAILURE;
+    }
+  }
 
   return SDL_APP_CONTINUE;
 }
 
+static void update_stats_overlay(appstate_t* as) {
+  char text[RENDER_OVERLAY_BYTES];
+  render_stats_t* render = &as->rs->stats;
+  int length = SDL_snprintf(text, sizeof(text), "present %.2fms jitter %.3fms\n", render->interval_mean_ns / 1e6, render_jitter_ns(render) / 1e6);
+  if (as->audio != NULL) {
+    // the emulator or APU thread is pushing while this runs, so only its published copy
+    audio_output_stats_t rate = audio_output_stats(as->audio);
+    audio_ring_stats_t ring = audio_ring_stats(&as->audio->ring);
+    SDL_snprintf(text + length, sizeof(text) - length,
+                 "audio %.1fms ratio %+.3f%% (%+.3f..%+.3f)\n"
+                 "underruns %" PRIu64 " overruns %" PRIu64 " waits %" PRIu64,
+                 rate.latency_ms, (rate.ratio - 1) * 100, (rate.min_ratio - 1) * 100, (rate.max_ratio - 1) * 100, ring.underruns, ring.overruns,
+                 rate.waits);
+  }
+  render_set_overlay(as->rs, text);
+}
+
 SDL_AppResult SDL_AppIterate(void* appstate) {
   appstate_t* as = (appstate_t*)appstate;
-  // render here
-  // TODO: mutex locking here?
-  draw_screen(as->rs, as->gb->screen);
+  if (as->cooperative) {
+    // what finishes here is published and picked up below like any other frame
+    uint64_t now = SDL_GetTicksNS();
+    gameboy_run_elapsed(as->gb, now);
+    for (uint16_t i = 1; as->mosaic != NULL && i < as->instance_count; ++i) {
+      gameboy_run_elapsed(as->instances[i], now);
+    }
+  }
+  if (as->show_stats && as->rs != NULL) {
+    update_stats_overlay(as);
+  }
+  if (as->mosaic != NULL) {
+    draw_mosaic(as->rs, as->mosaic);
+    return SDL_APP_CONTINUE;
+  }
+  // always the newest finished frame, the emulator thread keeps drawing into its own buffer
+  bool is_new;
+  const frame_t* frame = triple_buffer_acquire(&as->gb->frames, &is_new);
+  if (as->headless_frames > 0) {
+    return is_new && frame->number >= as->headless_frames ? SDL_APP_SUCCESS : SDL_APP_CONTINUE;
+  }
+  // a ghosted frame is still blended with the one before it, drawing it once more blends it with itself and the screen settles
+  bool unchanged = frame->hash == as->drawn_hash && (!as->ghosting || as->ghost_settled);
+  // the overlay changes even when the screen does not
+  if (!is_new || (unchanged && !as->show_stats)) {
+    return SDL_APP_CONTINUE;
+  }
+  as->ghost_settled = frame->hash == as->drawn_hash;
+  draw_screen(as->rs, frame);
+  as->drawn_hash = frame->hash;
+  return SDL_APP_CONTINUE;
+}
+
+static uint8_t joypad_key(SDL_Keycode key) {
+  switch (key) {
+  case SDLK_RIGHT:
+    return JOYPAD_RIGHT;
+  case SDLK_LEFT:
+    return JOYPAD_LEFT;
+  case SDLK_UP:
+    return JOYPAD_UP;
+  case SDLK_DOWN:
+    return JOYPAD_DOWN;
+  case SDLK_X:
+    return JOYPAD_A;
+  case SDLK_Z:
+    return JOYPAD_B;
+  case SDLK_BACKSPACE:
+    return JOYPAD_SELECT;
+  case SDLK_RETURN:
+    return JOYPAD_START;
+  }
+  return 0;
+}
+
+/*
+ * Arrows, X, Z, backspace and return are the joypad. P pauses, F5 saves a
+ * state and F9 loads it, tab held runs at TURBO_SPEED and escape quits.
+ */
+static SDL_AppResult handle_key(appstate_t* as, const SDL_KeyboardEvent* key) {
+  uint8_t joypad = joypad_key(key->key);
+  if (joypad != 0) {
+    as->buttons = key->down ? as->buttons | joypad : as->buttons & ~joypad;
+    send_all(as, (command_t){.type = GAMEBOY_COMMAND_JOYPAD, .value = as->buttons});
+    return SDL_APP_CONTINUE;
+  }
+  if (key->key == SDLK_TAB && !key->repeat) {
+    double speed = key->down ? as->speed * TURBO_SPEED : as->speed;
+    send_all(as, (command_t){.type = GAMEBOY_COMMAND_SPEED, .ratio = speed});
+    if (as->audio != NULL) {
+      audio_output_set_speed(as->audio, speed);
+    }
+    return SDL_APP_CONTINUE;
+  }
+  if (!key->down || key->repeat) {
+    return SDL_APP_CONTINUE;
+  }
+  switch (key->key) {
+  case SDLK_ESCAPE:
+    return SDL_APP_SUCCESS;
+  case SDLK_P:
+    as->paused = !as->paused;
+    send_all(as, (command_t){.type = as->paused ? GAMEBOY_COMMAND_PAUSE : GAMEBOY_COMMAND_RESUME});
+    break;
+  case SDLK_F5:
+    if (as->saved_state == NULL) {
+      as->saved_state = SDL_malloc(sizeof(gameboy_state_t));
+    }
+    if (as->saved_state != NULL) {
+      gameboy_send(as->gb, (command_t){.type = GAMEBOY_COMMAND_SAVE_STATE, .data = as->saved_state});
+    }
+    break;
+  case SDLK_F9:
+    if (as->saved_state != NULL) {
+      gameboy_send(as->gb, (command_t){.type = GAMEBOY_COMMAND_LOAD_STATE, .data = as->saved_state});
+    }
+    break;
+  }
   return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
   appstate_t* as = (appstate_t*)appstate;
+  if (event->type == as->frame_event) {
+    // the frame itself is picked up in SDL_AppIterate
+    return SDL_APP_CONTINUE;
+  }
   switch (event->type) {
   case SDL_EVENT_KEY_DOWN:
-    return SDL_APP_SUCCESS;
+  case SDL_EVENT_KEY_UP:
+    return handle_key(as, &event->key);
   }
   return SDL_APP_CONTINUE;
 }
 
+static void stop_emulator(gameboy_t* gb, pthread_t thread) {
+  // the queue can be full of commands nobody is taking, the next frame empties it
+  while (!gameboy_send(gb, (command_t){.type = GAMEBOY_COMMAND_SHUTDOWN})) {
+    SDL_DelayNS(1000000);
+  }
+  pthread_join(thread, NULL);
+}
+
+/*
+ * Draws whatever the workers still have and stops them, only once the
+ * emulator threads are gone
+ */
+static void stop_ppu_pipelines(appstate_t* as) {
+  if (as->gb != NULL) {
+    ppu_pipeline_stop(as->gb);
+  }
+  for (uint16_t i = 1; i < as->instance_count; ++i) {
+    if (as->instances[i] != NULL) {
+      ppu_pipeline_stop(as->instances[i]);
+    }
+  }
+}
+
+/*
+ * Shuts down whichever emulator threads got started, once they are gone
+ * nothing else touches their gameboy_t
+ */
+static void stop_emulators(appstate_t* as) {
+  if (as->gb != NULL && as->gb_thread_started) {
+    stop_emulator(as->gb, as->gb_thread);
+  }
+  for (uint16_t i = 1; i < as->instance_count; ++i) {
+    if (as->instance_thread_started[i]) {
+      stop_emulator(as->instances[i], as->instance_threads[i]);
+    }
+  }
+}
+
 void SDL_AppQuit(void* appstate, SDL_AppResult result) {
-  //
-  printf("-- complete --\n");
+  appstate_t* as = (appstate_t*)appstate;
+  if (as == NULL) {
+    return;
+  }
+  FILE* report = stdout;
+  stop_emulators(as);
+  // the frames still in the APU log reach the dump and the device before either closes, as they would have inline
+  bool apu_thread = as->gb != NULL && as->gb->apu_pipeline != NULL;
+  apu_pipeline_stats_t apu = {0};
+  if (apu_thread) {
+    apu_pipeline_flush(as->gb);
+    apu = apu_pipeline_stats(as->gb);
+    apu_pipeline_stop(as->gb);
+  }
+  if (as->capture != NULL) {
+    capture_stop(as->capture);
+    capture_stats_t capture = capture_stats(as->capture);
+    if (!as->capture->owns_file) {
+      // a capture going to standard output keeps it to itself
+      report = stderr;
+    }
+    fprintf(report, "capture submitted=%" PRIu64 " written=%" PRIu64 " dropped=%" PRIu64 " bytes=%" PRIu64 "\n", capture.submitted, capture.written,
+            capture.dropped, capture.bytes);
+  }
+  if (as->audio_dump != NULL) {
+    // like the video capture, audio frames from here on are dropped
+    wav_capture_stop(as->audio_dump);
+    wav_stats_t dump = wav_capture_stats(as->audio_dump);
+    fprintf(report, "audio dump submitted=%" PRIu64 " written=%" PRIu64 " dropped=%" PRIu64 " bytes=%" PRIu64 "\n", dump.submitted, dump.written,
+            dump.dropped, dump.bytes);
+  }
+  if (as->gb != NULL) {
+    triple_buffer_stats_t stats = triple_buffer_stats(&as->gb->frames);
+    fprintf(report, "frames published=%" PRIu64 " dropped=%" PRIu64 " duplicated=%" PRIu64 "\n", stats.published, stats.dropped, stats.duplicated);
+  }
+  if (as->mosaic != NULL) {
+    mosaic_stats_t mosaic = as->mosaic->stats;
+    fprintf(report, "mosaic instances=%d updates=%" PRIu64 " tiles uploaded=%" PRIu64 " skipped=%" PRIu64 "\n", as->mosaic->count, mosaic.updates,
+            mosaic.tiles_uploaded, mosaic.tiles_skipped);
+  }
+  if (as->audio != NULL) {
+    audio_output_close(as->audio);
+    audio_ring_stats_t audio = audio_ring_stats(&as->audio->ring);
+    fprintf(report, "audio pushed=%" PRIu64 " played=%" PRIu64 " underruns=%" PRIu64 " overruns=%" PRIu64 " dropped=%" PRIu64 " fill=%zu\n",
+            audio.pushed, audio.popped, audio.underruns, audio.overruns, audio.dropped, audio.fill);
+    audio_output_stats_t rate = audio_output_stats(as->audio);
+    fprintf(report, "audio latency=%.1fms ratio min=%+.3f%% max=%+.3f%% waits=%" PRIu64 "\n", rate.latency_ms, (rate.min_ratio - 1) * 100,
+            (rate.max_ratio - 1) * 100, rate.waits);
+  }
+  frame_pacer_stats_t pacer = as->gb != NULL ? as->gb->pacer.stats : (frame_pacer_stats_t){0};
+  if (pacer.frames > 0) {
+    fprintf(report, "pacer frames=%" PRIu64 " late=%" PRIu64 " resyncs=%" PRIu64 " error p50<%.0fus p99<%.0fus max=%.0fus spin=%.1fms\n",
+            pacer.frames, pacer.late, pacer.resyncs, frame_pacer_percentile_ns(&pacer, 0.5) / 1e3, frame_pacer_percentile_ns(&pacer, 0.99) / 1e3,
+            pacer.error_max_ns / 1e3, pacer.spin_total_ns / 1e6);
+  }
+  if (apu_thread) {
+    fprintf(report, "apu thread frames=%" PRIu64 "/%" PRIu64 " writes=%" PRIu64 " stalls=%" PRIu64 " backlog max=%" PRIu64 "\n", apu.frames,
+            apu.submitted, apu.writes, apu.stalls, apu.backlog_max);
+  }
+  if (as->gb != NULL && as->gb->ppu.pipeline != NULL) {
+    ppu_pipeline_stats_t ppu = ppu_pipeline_stats(as->gb);
+    fprintf(report, "ppu workers=%d frames=%" PRIu64 " stalls=%" PRIu64 " overflows=%" PRIu64 " latency avg=%.0fus max=%.0fus\n",
+            as->gb->ppu.pipeline->worker_count, ppu.frames, ppu.stalls, ppu.overflows, ppu.frames > 0 ? ppu.latency_total_ns / 1e3 / ppu.frames : 0,
+            ppu.latency_max_ns / 1e3);
+  }
+  stop_ppu_pipelines(as);
+  if (as->gb != NULL && as->frame_skip != PPU_FRAME_SKIP_OFF) {
+    fprintf(report, "frame skip skipped=%" PRIu64 " of %" PRIu64 "\n", as->gb->ppu.frame_skip.skipped, as->gb->ppu.frames);
+  }
+  if (as->gb != NULL && as->cooperative) {
+    fprintf(report, "cooperative skipped=%.1fms\n", as->gb->run_skipped_ns / 1e6);
+  }
+  gameboy_command_stats_t commands = as->gb != NULL ? as->gb->command_stats : (gameboy_command_stats_t){0};
+  if (commands.applied > 0) {
+    uint64_t dropped = atomic_load(&as->gb->commands.dropped);
+    fprintf(report, "commands applied=%" PRIu64 " dropped=%" PRIu64 " refused=%" PRIu64 " latency avg=%.0fus max=%.0fus\n", commands.applied, dropped,
+            commands.refused, commands.latency_total_ns / 1e3 / commands.applied, commands.latency_max_ns / 1e3);
+  }
+  // to compare the threaded and cooperative modes by
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    fprintf(report, "process cpu user=%.2fs system=%.2fs context switches voluntary=%ld involuntary=%ld\n",
+            usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6, usage.ru_nvcsw,
+            usage.ru_nivcsw);
+  }
+  render_stats_t render = as->rs != NULL ? as->rs->stats : (render_stats_t){0};
+  if (render.frames > 0) {
+    fprintf(report, "draw_screen avg=%" PRIu64 "us max=%" PRIu64 "us over %" PRIu64 " frames\n", render.total_ns / render.frames / 1000, render.max_ns / 1000,
+            render.frames);
+    fprintf(report, "present interval avg=%.2fms jitter=%.3fms max=%.2fms\n", render.interval_mean_ns / 1e6, render_jitter_ns(&render) / 1e6,
+            render.interval_max_ns / 1e6);
+  }
+  fprintf(report, "-- complete --\n");
 }
@@ -0,0 +1,92 @@
+#include "mosaic.h"
+
+bool mosaic_init(mosaic_t* mosaic, SDL_Renderer* renderer, triple_buffer_t* sources[], uint16_t count) {
+  if (count < 1 || count > MOSAIC_MAX_INSTANCES) {
+    SDL_Log("Mosaic instance count out of range: min=1, max=%d, got=%d", MOSAIC_MAX_INSTANCES, count);
+    return false;
+  }
+  mosaic->count = count;
+  mosaic->columns = 1;
+  while (mosaic->columns * mosaic->columns < count) {
+    mosaic->columns += 1;
+  }
+  mosaic->rows = (count + mosaic->columns - 1) / mosaic->columns;
+  for (uint16_t i = 0; i < count; ++i) {
+    mosaic->sources[i] = sources[i];
+    mosaic->drawn_hash[i] = 0;
+  }
+  mosaic->stats = (mosaic_stats_t){0};
+
+  mosaic->atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, mosaic->columns * SCREEN_WIDTH,
+                                    mosaic->rows * SCREEN_HEIGHT);
+  if (mosaic->atlas == NULL) {
+    SDL_Log("Could not create the mosaic atlas: %s", SDL_GetError());
+    return false;
+  }
+
+  // tiles without a frame yet, and the unused ones past `count`, start out black
+  void* pixels;
+  int pitch;
+  if (SDL_LockTexture(mosaic->atlas, NULL, &pixels, &pitch)) {
+    SDL_memset(pixels, 0, (size_t)pitch * mosaic->rows * SCREEN_HEIGHT);
+    SDL_UnlockTexture(mosaic->atlas);
+  }
+  return true;
+}
+
+uint16_t mosaic_update(mosaic_t* mosaic, const display_lut_t* lut) {
+  uint16_t uploaded = 0;
+  for (uint16_t i = 0; i < mosaic->count; ++i) {
+    bool is_new;
+    const frame_t* frame = triple_buffer_acquire(mosaic->sources[i], &is_new);
+    if (!is_new || frame->hash == mosaic->drawn_hash[i]) {
+      continue;
+    }
+    SDL_Rect tile = {
+        .x = (i % mosaic->columns) * SCREEN_WIDTH,
+        .y = (i / mosaic->columns) * SCREEN_HEIGHT,
+        .w = SCREEN_WIDTH,
+        .h = SCREEN_HEIGHT,
+    };
+    void* pixels;
+    int pitch;
+    if (!SDL_LockTexture(mosaic->atlas, &tile, &pixels, &pitch)) {
+      continue;
+    }
+    if (frame->cgb) {
+      // every instance brings its own palettes
+      display_lut_t cgb_lut = *lut;
+      display_lut_set_cgb(&cgb_lut, frame->colors);
+      display_convert(&cgb_lut, frame->pixels, pixels, pitch);
+    } else {
+      display_convert(lut, frame->pixels, pixels, pitch);
+    }
+    SDL_UnlockTexture(mosaic->atlas);
+    mosaic->drawn_hash[i] = frame->hash;
+    uploaded += 1;
+  }
+  mosaic->stats.updates += 1;
+  mosaic->stats.tiles_uploaded += uploaded;
+  mosaic->stats.tiles_skipped += mosaic->count - uploaded;
+  return uploaded;
+}
+
+void mosaic_draw(mosaic_t* mosaic, SDL_Renderer* renderer, const SDL_FRect* bounds) {
+  float width = mosaic->columns * SCREEN_WIDTH;
+  float height = mosaic->rows * SCREEN_HEIGHT;
+  float scale = bounds->w / width < bounds->h / height ? bounds->w / width : bounds->h / height;
+  SDL_FRect dest = {
+      .x = bounds->x + (bounds->w - width * scale) / 2,
+      .y = bounds->y + (bounds->h - height * scale) / 2,
+      .w = width * scale,
+      .h = height * scale,
+  };
+  // shrinking a large grid with nearest drops whole rows of pixels
+  SDL_SetTextureScaleMode(mosaic->atlas, scale < 1 ? SDL_SCALEMODE_LINEAR : SDL_SCALEMODE_NEAREST);
+  SDL_RenderTexture(renderer, mosaic->atlas, NULL, &dest);
+}
+
+void mosaic_destroy(mosaic_t* mosaic) {
+  SDL_DestroyTexture(mosaic->atlas);
+  mosaic->atlas = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef RENDER_MOSAIC_H
+#define RENDER_MOSAIC_H
+
+#include <SDL3/SDL.h>
+
+#include "../display.h"
+#include "../events/triple_buffer.h"
+
+/*
+ * Shows the screens of many emulator instances at once. Every instance owns
+ * a 160x144 tile of one streaming atlas texture, laid out in a grid as close
+ * to square as the count allows.
+ *
+ * An update picks up each instance's newest frame and only uploads the tiles
+ * whose frame hash differs from what the tile holds, so an instance with a
+ * static screen costs an atomic load and a compare. The whole grid is then
+ * drawn with a single SDL_RenderTexture.
+ */
+
+#define MOSAIC_MAX_INSTANCES 256
+
+typedef struct {
+  uint64_t updates;
+  uint64_t tiles_uploaded;
+  // tiles whose instance had nothing new, or a new frame identical to the last
+  uint64_t tiles_skipped;
+} mosaic_stats_t;
+
+typedef struct {
+  SDL_Texture* atlas;
+  uint16_t count;
+  uint16_t columns;
+  uint16_t rows;
+  triple_buffer_t* sources[MOSAIC_MAX_INSTANCES];
+  uint64_t drawn_hash[MOSAIC_MAX_INSTANCES];
+  mosaic_stats_t stats;
+} mosaic_t;
+
+bool mosaic_init(mosaic_t* mosaic, SDL_Renderer* renderer, triple_buffer_t* sources[], uint16_t count);
+
+/*
+ * Uploads the tiles that changed and returns how many did
+ */
+uint16_t mosaic_update(mosaic_t* mosaic, const display_lut_t* lut);
+
+/*
+ * Fits the grid into `bounds`, keeping tiles square and centred
+ */
+void mosaic_draw(mosaic_t* mosaic, SDL_Renderer* renderer, const SDL_FRect* bounds);
+void mosaic_destroy(mosaic_t* mosaic);
+
+#endif // !DEBUG
@@ -0,0 +1,112 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "postprocess.h"
+
+static uint16_t color_index(uint32_t color, display_format_t format) {
+  uint8_t r, g, b;
+  if (format == DISPLAY_FORMAT_ARGB8888) {
+    r = color >> 16, g = color >> 8, b = color;
+  } else {
+    r = color >> 24, g = color >> 16, b = color >> 8;
+  }
+  return (r >> 3) << 10 | (g >> 3) << 5 | (b >> 3);
+}
+
+/*
+ * The usual integer approximation of a CGB screen: each channel picks up some
+ * of the other two and the whole range tops out below full brightness before
+ * being stretched back to 0-255
+ */
+static pixel_color_t correct_color(uint16_t index) {
+  uint16_t r = (index >> 10) & 0x1F, g = (index >> 5) & 0x1F, b = index & 0x1F;
+  uint16_t cr = r * 26 + g * 4 + b * 2;
+  uint16_t cg = g * 24 + b * 8;
+  uint16_t cb = r * 6 + g * 4 + b * 22;
+  return (pixel_color_t){
+      .r = (cr < 960 ? cr : 960) * 255 / 960,
+      .g = (cg < 960 ? cg : 960) * 255 / 960,
+      .b = (cb < 960 ? cb : 960) * 255 / 960,
+  };
+}
+
+void postprocess_init(postprocess_t* post, display_format_t format) {
+  post->correct_colors = false;
+  post->ghosting = false;
+  post->format = format;
+  post->has_previous = false;
+  post->width = 0;
+  post->height = 0;
+  for (uint32_t index = 0; index < POSTPROCESS_LUT_SIZE; ++index) {
+    post->lut[index] = display_pack_color(correct_color(index), format);
+  }
+}
+
+void postprocess_set_effects(postprocess_t* post, bool correct_colors, bool ghosting) {
+  post->correct_colors = correct_colors;
+  post->ghosting = ghosting;
+  // a stale frame from before ghosting was turned on would flash up for one frame
+  post->has_previous = false;
+}
+
+static void correct_row(const postprocess_t* post, uint32_t* row, size_t width) {
+  // scaled frames come in runs of the same color, those skip the table
+  uint32_t last = 0, corrected = post->lut[0];
+  for (size_t x = 0; x < width; ++x) {
+    if (row[x] != last) {
+      last = row[x];
+      corrected = post->lut[color_index(last, post->format)];
+    }
+    row[x] = corrected;
+  }
+}
+
+/*
+ * Replaces `row` with the rounded average of itself and `previous`, and
+ * `previous` with what `row` was
+ */
+static void blend_row(uint32_t* row, uint32_t* previous, size_t width) {
+  size_t x = 0;
+#if defined(__SSE2__)
+  for (; x + 4 <= width; x += 4) {
+    __m128i current = _mm_loadu_si128((const __m128i*)&row[x]);
+    __m128i last = _mm_loadu_si128((const __m128i*)&previous[x]);
+    _mm_storeu_si128((__m128i*)&row[x], _mm_avg_epu8(current, last));
+    _mm_storeu_si128((__m128i*)&previous[x], current);
+  }
+#endif
+  for (; x < width; ++x) {
+    uint32_t current = row[x], last = previous[x];
+    // per byte (a + b + 1) / 2, the same rounding as pavgb
+    row[x] = (current | last) - (((current ^ last) >> 1) & 0x7F7F7F7F);
+    previous[x] = current;
+  }
+}
+
+void postprocess_run(postprocess_t* post, void* pixels, size_t pitch, size_t width, size_t height) {
+  if (!post->correct_colors && !post->ghosting) {
+    return;
+  }
+  if (width * height > POSTPROCESS_MAX_PIXELS) {
+    return;
+  }
+  bool blend = post->ghosting && post->has_previous && post->width == width && post->height == height;
+  for (size_t y = 0; y < height; ++y) {
+    uint32_t* row = (uint32_t*)((uint8_t*)pixels + y * pitch);
+    uint32_t* previous = &post->previous[y * width];
+    if (post->correct_colors) {
+      correct_row(post, row, width);
+    }
+    if (blend) {
+      blend_row(row, previous, width);
+    } else if (post->ghosting) {
+      memcpy(previous, row, width * sizeof(uint32_t));
+    }
+  }
+  post->has_previous = post->ghosting;
+  post->width = width;
+  post->height = height;
+}
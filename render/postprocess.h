@@ -0,0 +1,49 @@
+#ifndef RENDER_POSTPROCESS_H
+#define RENDER_POSTPROCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../display.h"
+#include "scale.h"
+
+/*
+ * Effects run over the packed pixels of a finished, scaled frame, each one
+ * can be turned on by itself.
+ *
+ *   color correction  maps every color through a table indexed by its
+ *                     15-bit RGB, the way a CGB screen washes out and mixes
+ *                     the channels
+ *   ghosting          averages every pixel with the same pixel of the
+ *                     previous frame, like the slow response of a DMG LCD
+ *
+ * The table is built once, the average is integer SIMD over 4 pixels at a
+ * time. Nothing is done per pixel in floating point.
+ */
+
+#define POSTPROCESS_LUT_SIZE (1 << 15)
+#define POSTPROCESS_MAX_PIXELS ((SCREEN_SIZE) * (SCALE_MAX_FACTOR) * (SCALE_MAX_FACTOR))
+
+typedef struct {
+  bool correct_colors;
+  bool ghosting;
+  display_format_t format;
+  // whether `previous` holds a frame of the current size to blend with
+  bool has_previous;
+  size_t width;
+  size_t height;
+  uint32_t lut[POSTPROCESS_LUT_SIZE];
+  // the previous frame as it was before blending
+  uint32_t previous[POSTPROCESS_MAX_PIXELS];
+} postprocess_t;
+
+void postprocess_init(postprocess_t* post, display_format_t format);
+void postprocess_set_effects(postprocess_t* post, bool correct_colors, bool ghosting);
+
+/*
+ * Runs the enabled effects in place over `height` rows of `width` pixels
+ */
+void postprocess_run(postprocess_t* post, void* pixels, size_t pitch, size_t width, size_t height);
+
+#endif // !DEBUG
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "postprocess.h"
+
+/*
+ * Reports what each effect costs per frame at 1x and 4x, next to the same
+ * color correction done per pixel in floating point. Noise is the worst case
+ * for the table, a 4x scaled DMG frame is what it usually sees.
+ */
+
+#define BENCH_FRAMES 200
+#define BENCH_REPEATS 5
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void float_correction(uint32_t* pixels, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    float r = (pixels[i] >> 24) / 255.0f, g = ((pixels[i] >> 16) & 0xFF) / 255.0f, b = ((pixels[i] >> 8) & 0xFF) / 255.0f;
+    float cr = (r * 26 + g * 4 + b * 2) / 30, cg = (g * 24 + b * 8) / 30, cb = (r * 6 + g * 4 + b * 22) / 30;
+    cr = cr > 1 ? 1 : cr, cg = cg > 1 ? 1 : cg, cb = cb > 1 ? 1 : cb;
+    pixels[i] = (uint32_t)(cr * 255) << 24 | (uint32_t)(cg * 255) << 16 | (uint32_t)(cb * 255) << 8 | 0xFF;
+  }
+}
+
+static double bench_run(postprocess_t* post, uint32_t* pixels, const uint32_t* source, size_t width, size_t height, bool reference) {
+  double best = 0;
+  for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+    double total = 0;
+    for (int i = 0; i < BENCH_FRAMES; ++i) {
+      // every frame starts from fresh pixels like a newly scaled one would
+      memcpy(pixels, source, width * height * sizeof(uint32_t));
+      double start = bench_now_ns();
+      if (reference) {
+        float_correction(pixels, width * height);
+      } else {
+        postprocess_run(post, pixels, width * sizeof(uint32_t), width, height);
+      }
+      total += bench_now_ns() - start;
+    }
+    double ns = total / BENCH_FRAMES;
+    if (repeat == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+int main(void) {
+  postprocess_t* post = malloc(sizeof(postprocess_t));
+  uint32_t* noise = malloc(POSTPROCESS_MAX_PIXELS * sizeof(uint32_t));
+  uint32_t* dmg = malloc(POSTPROCESS_MAX_PIXELS * sizeof(uint32_t));
+  uint32_t* pixels = malloc(POSTPROCESS_MAX_PIXELS * sizeof(uint32_t));
+  if (post == NULL || noise == NULL || dmg == NULL || pixels == NULL) {
+    return 1;
+  }
+  display_lut_t lut = display_lut_create(DISPLAY_DMG_SHADES, DISPLAY_FORMAT_RGBA8888);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < POSTPROCESS_MAX_PIXELS; ++i) {
+    seed = seed * 1103515245 + 12345;
+    noise[i] = seed | 0xFF;
+    // blocks of 4x4 random shades
+    size_t x = i % (SCREEN_WIDTH * SCALE_MAX_FACTOR) / SCALE_MAX_FACTOR, y = i / (SCREEN_WIDTH * SCALE_MAX_FACTOR) / SCALE_MAX_FACTOR;
+    dmg[i] = lut.colors[(x * 7 + y * 13 + (x * y >> 3)) % SHADE_COUNT];
+  }
+  postprocess_init(post, DISPLAY_FORMAT_RGBA8888);
+  size_t width = SCREEN_WIDTH * SCALE_MAX_FACTOR, height = SCREEN_HEIGHT * SCALE_MAX_FACTOR;
+
+  printf("%-20s %12s %12s %12s\n", "effect", "noise 1x ms", "noise 4x ms", "dmg 4x ms");
+  const struct {
+    const char* name;
+    bool correct_colors;
+    bool ghosting;
+    bool reference;
+  } runs[] = {
+      {  "correction (lut)",  true, false, false},
+      {          "ghosting", false,  true, false},
+      {              "both",  true,  true, false},
+      {"correction (float)",  true, false,  true},
+  };
+  for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r) {
+    postprocess_set_effects(post, runs[r].correct_colors, runs[r].ghosting);
+    double small = bench_run(post, pixels, noise, SCREEN_WIDTH, SCREEN_HEIGHT, runs[r].reference);
+    postprocess_set_effects(post, runs[r].correct_colors, runs[r].ghosting);
+    double large = bench_run(post, pixels, noise, width, height, runs[r].reference);
+    postprocess_set_effects(post, runs[r].correct_colors, runs[r].ghosting);
+    double scaled = bench_run(post, pixels, dmg, width, height, runs[r].reference);
+    printf("%-20s %12.3f %12.3f %12.3f\n", runs[r].name, small / 1e6, large / 1e6, scaled / 1e6);
+  }
+
+  free(pixels);
+  free(dmg);
+  free(noise);
+  free(post);
+  return 0;
+}
@@ -0,0 +1,47 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "postprocess.h"
+
+static postprocess_t post;
+static uint32_t frame[4][8];
+
+Test(postprocess, correction_keeps_black_and_white) {
+  postprocess_init(&post, DISPLAY_FORMAT_RGBA8888);
+  postprocess_set_effects(&post, true, false);
+  frame[0][0] = 0xFFFFFFFF;
+  frame[0][1] = 0x000000FF;
+  frame[0][2] = 0xFF0000FF;
+
+  postprocess_run(&post, frame, sizeof(frame[0]), 3, 1);
+
+  cr_assert(eq(u32, frame[0][0], 0xFFFFFFFF));
+  cr_assert(eq(u32, frame[0][1], 0x000000FF));
+  // pure red comes out darker and bleeds into blue
+  cr_assert(lt(u32, frame[0][2] >> 24, 0xFF));
+  cr_assert(gt(u32, (frame[0][2] >> 8) & 0xFF, 0));
+}
+
+Test(postprocess, ghosting_averages_with_the_previous_frame) {
+  postprocess_init(&post, DISPLAY_FORMAT_RGBA8888);
+  postprocess_set_effects(&post, false, true);
+  for (size_t x = 0; x < 8; ++x) {
+    frame[1][x] = 0xFFFFFFFF;
+  }
+  postprocess_run(&post, frame[1], sizeof(frame[0]), 8, 1);
+  cr_assert(eq(u32, frame[1][7], 0xFFFFFFFF));
+
+  for (size_t x = 0; x < 8; ++x) {
+    frame[1][x] = 0x000000FF;
+  }
+  postprocess_run(&post, frame[1], sizeof(frame[0]), 8, 1);
+  cr_assert(eq(u32, frame[1][0], 0x808080FF));
+  cr_assert(eq(u32, frame[1][7], 0x808080FF));
+
+  // blending is against the last frame as it came in, so a still screen settles at once
+  for (size_t x = 0; x < 8; ++x) {
+    frame[1][x] = 0x000000FF;
+  }
+  postprocess_run(&post, frame[1], sizeof(frame[0]), 8, 1);
+  cr_assert(eq(u32, frame[1][5], 0x000000FF));
+}
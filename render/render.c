@@ -1,6 +1,8 @@
 #include "render.h"
 #include <stdlib.h>
 
+static const pixel_color_t background = {200, 50, 50};
+
 bool render_state_init(render_state_t* rs, const size_t width, const size_t height, const SDL_WindowFlags flags) {
   if (width < DISPLAY_WIDTH || height < DISPLAY_HEIGHT) {
     SDL_Log("Display width/height too small, width: min=%d, got=%zu, height: min=%d, got=%zu", SCREEN_WIDTH, width, SCREEN_HEIGHT, height);
@@ -16,10 +18,83 @@ bool render_state_init(render_state_t* rs, const size_t width, const size_t heig
 
   rs->screen_start_x = (width - rs->pixel_stamp.w * SCREEN_WIDTH) / 2;
   rs->screen_start_y = (height - rs->pixel_stamp.h * SCREEN_HEIGHT) / 2;
+  rs->screen_rect = (SDL_FRect){
+      .x = rs->screen_start_x,
+      .y = rs->screen_start_y,
+      .w = rs->pixel_stamp.w * SCREEN_WIDTH,
+      .h = rs->pixel_stamp.h * SCREEN_HEIGHT,
+  };
+
+  if (!SDL_SetRenderVSync(rs->renderer, 1)) {
+    SDL_Log("VSync is not available, presents will not be paced: %s", SDL_GetError());
+  }
+
+  rs->lut = display_lut_create(DISPLAY_DMG_SHADES, DISPLAY_FORMAT_RGBA8888);
+  rs->cgb = false;
+  rs->stats = (render_stats_t){0};
+  rs->texture = NULL;
+  rs->overlay[0] = '\0';
+  postprocess_init(&rs->post, rs->lut.format);
+
+  // a software renderer would stretch the texture on the CPU anyway, so scale it up front to the size it is drawn at
+  uint8_t factor = 1;
+  if (SDL_strcmp(SDL_GetRendererName(rs->renderer), SDL_SOFTWARE_RENDERER) == 0) {
+    factor = rs->pixel_stamp.w < SCALE_MAX_FACTOR ? rs->pixel_stamp.w : SCALE_MAX_FACTOR;
+  }
+  if (!render_set_filter(rs, SCALE_FILTER_NEAREST, factor)) {
+    return false;
+  }
+
+  return true;
+}
 
+/*
+ * Swaps the screen texture for one the size `filter` scales to
+ */
+bool render_set_filter(render_state_t* rs, scale_filter_t filter, uint8_t factor) {
+  if (!scaler_supports(filter, factor)) {
+    SDL_Log("Unsupported screen filter: filter=%d, factor=%d", filter, factor);
+    return false;
+  }
+  SDL_Texture* texture =
+      SDL_CreateTexture(rs->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH * factor, SCREEN_HEIGHT * factor);
+  if (texture == NULL) {
+    SDL_Log("Could not create the screen texture: %s", SDL_GetError());
+    return false;
+  }
+  // whole multiples only, nearest keeps every scaled pixel a sharp square
+  SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+  // only once the texture is there, a failure above keeps the old filter and texture together
+  scaler_init(&rs->scaler, filter, factor, &rs->lut);
+  SDL_DestroyTexture(rs->texture);
+  rs->texture = texture;
   return true;
 }
 
+void render_set_overlay(render_state_t* rs, const char* text) {
+  //
+  SDL_strlcpy(rs->overlay, text, sizeof(rs->overlay));
+}
+
+/*
+ * SDL's built in 8x8 debug font, no font files or text rendering library
+ */
+static void draw_overlay(render_state_t* rs) {
+  if (rs->overlay[0] == '\0') {
+    return;
+  }
+  SDL_SetRenderDrawColor(rs->renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
+  char line[RENDER_OVERLAY_BYTES];
+  const char* start = rs->overlay;
+  for (float y = SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE; *start != '\0'; y += SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE * 1.5f) {
+    const char* end = SDL_strchr(start, '\n');
+    size_t length = end != NULL ? (size_t)(end - start) : SDL_strlen(start);
+    SDL_strlcpy(line, start, length + 1);
+    SDL_RenderDebugText(rs->renderer, SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE, y, line);
+    start += end != NULL ? length + 1 : length;
+  }
+}
+
 SDL_FRect create_pixel_stamp(const size_t window_width, const size_t window_height) {
   size_t side_len;
   size_t x_len = window_width / SCREEN_WIDTH;
@@ -37,25 +112,102 @@ SDL_FRect create_pixel_stamp(const size_t window_width, const size_t window_heig
   };
 }
 
-void pixel_stamp_update_draw_coordinates(render_state_t* rs, size_t i) {
-  rs->pixel_stamp.x = (i % SCREEN_WIDTH) * rs->pixel_stamp.w + rs->screen_start_x;
-  rs->pixel_stamp.y = (i / SCREEN_WIDTH) * rs->pixel_stamp.h + rs->screen_start_y;
+static void record_present(render_stats_t* stats, uint64_t start) {
+  uint64_t now = SDL_GetTicksNS();
+  stats->frames += 1;
+  stats->total_ns += now - start;
+  if (now - start > stats->max_ns) {
+    stats->max_ns = now - start;
+  }
+  if (stats->last_present_ns != 0) {
+    uint64_t interval = now - stats->last_present_ns;
+    double delta = interval - stats->interval_mean_ns;
+    stats->intervals += 1;
+    stats->interval_mean_ns += delta / stats->intervals;
+    stats->interval_m2 += delta * (interval - stats->interval_mean_ns);
+    if (interval > stats->interval_max_ns) {
+      stats->interval_max_ns = interval;
+    }
+  }
+  stats->last_present_ns = now;
+}
+
+/*
+ * Refills the colors when a CGB frame brings other palettes than the last
+ * one, or the first DMG frame after CGB ones arrives
+ */
+static void update_colors(render_state_t* rs, const frame_t* frame) {
+  if (frame->cgb) {
+    if (rs->cgb && SDL_memcmp(rs->colors, frame->colors, sizeof(rs->colors)) == 0) {
+      return;
+    }
+    SDL_memcpy(rs->colors, frame->colors, sizeof(rs->colors));
+    display_lut_set_cgb(&rs->lut, frame->colors);
+  } else {
+    if (!rs->cgb) {
+      return;
+    }
+    rs->lut = display_lut_create(DISPLAY_DMG_SHADES, rs->lut.format);
+  }
+  rs->cgb = frame->cgb;
+  scaler_set_colors(&rs->scaler, &rs->lut);
 }
 
-void draw_screen(render_state_t* rs, pixel_color_t screen[SCREEN_SIZE]) {
-  static const pixel_color_t background = {200, 50, 50};
+void draw_screen(render_state_t* rs, const frame_t* frame) {
+  uint64_t start = SDL_GetTicksNS();
+  update_colors(rs, frame);
+
+  void* pixels;
+  int pitch;
+  if (SDL_LockTexture(rs->texture, NULL, &pixels, &pitch)) {
+    scaler_run(&rs->scaler, frame->pixels, pixels, pitch);
+    postprocess_run(&rs->post, pixels, pitch, SCREEN_WIDTH * rs->scaler.factor, SCREEN_HEIGHT * rs->scaler.factor);
+    SDL_UnlockTexture(rs->texture);
+  }
+
   SDL_SetRenderDrawColor(rs->renderer, background.r, background.g, background.b, SDL_ALPHA_OPAQUE);
-  SDL_RenderFillRect(rs->renderer, NULL);
-  uint16_t pixel_num;
-  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
-    pixel_stamp_update_draw_coordinates(rs, i);
-    SDL_SetRenderDrawColor(rs->renderer, screen[i].r, screen[i].g, screen[i].b, SDL_ALPHA_OPAQUE);
-    SDL_RenderFillRect(rs->renderer, &rs->pixel_stamp);
+  SDL_RenderClear(rs->renderer);
+  SDL_RenderTexture(rs->renderer, rs->texture, NULL, &rs->screen_rect);
+  draw_overlay(rs);
+  SDL_RenderPresent(rs->renderer);
+  record_present(&rs->stats, start);
+}
+
+/*
+ * Uploads whichever instances changed and presents the whole grid, nothing is
+ * presented when none did
+ */
+void draw_mosaic(render_state_t* rs, mosaic_t* mosaic) {
+  uint64_t start = SDL_GetTicksNS();
+  if (mosaic_update(mosaic, &rs->lut) == 0) {
+    return;
   }
+  int width, height;
+  SDL_GetCurrentRenderOutputSize(rs->renderer, &width, &height);
+  SDL_FRect bounds = {0, 0, width, height};
+
+  SDL_SetRenderDrawColor(rs->renderer, background.r, background.g, background.b, SDL_ALPHA_OPAQUE);
+  SDL_RenderClear(rs->renderer);
+  mosaic_draw(mosaic, rs->renderer, &bounds);
+  draw_overlay(rs);
   SDL_RenderPresent(rs->renderer);
+  record_present(&rs->stats, start);
+}
+
+/*
+ * Standard deviation of the present-to-present interval
+ */
+double render_jitter_ns(const render_stats_t* stats) {
+  if (stats->intervals < 2) {
+    return 0;
+  }
+  return SDL_sqrt(stats->interval_m2 / stats->intervals);
 }
 
 void renderer_destroy(render_state_t* rs) {
+  SDL_DestroyTexture(rs->texture);
+  rs->texture = NULL;
+  rs->overlay[0] = '\0';
   SDL_DestroyRenderer(rs->renderer);
   rs->renderer = NULL;
   SDL_DestroyWindow(rs->window);
@@ -4,17 +4,60 @@
 #include <SDL3/SDL.h>
 
 #include "../display.h"
+#include "../events/triple_buffer.h"
+#include "mosaic.h"
+#include "postprocess.h"
+#include "scale.h"
 
+#define RENDER_OVERLAY_BYTES 256
+
+/*
+ * Time spent in draw_screen, from the start of the upload to the end of the
+ * present, and the spread of the intervals between presents
+ */
+typedef struct {
+  uint64_t frames;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t last_present_ns;
+  uint64_t intervals;
+  uint64_t interval_max_ns;
+  // running mean and sum of squared deviations (Welford)
+  double interval_mean_ns;
+  double interval_m2;
+} render_stats_t;
+
+/*
+ * The screen is a single streaming texture of 160x144 times the scaler's
+ * factor. Each frame is scaled straight into the locked texture, post
+ * processed there and drawn stretched up to whole multiples of `pixel_stamp`.
+ * Presents wait for vsync.
+ */
 typedef struct {
   SDL_Renderer* renderer;
   SDL_Window* window;
+  SDL_Texture* texture;
   SDL_FRect pixel_stamp;
+  SDL_FRect screen_rect;
   size_t screen_start_x;
   size_t screen_start_y;
+  display_lut_t lut;
+  // the palettes `lut` was last filled from, while CGB frames are drawn
+  bool cgb;
+  uint16_t colors[CGB_COLOR_COUNT];
+  scaler_t scaler;
+  postprocess_t post;
+  render_stats_t stats;
+  // drawn over the top left corner with every present, one line per '\n', empty for none
+  char overlay[RENDER_OVERLAY_BYTES];
 } render_state_t;
 
 bool render_state_init(render_state_t* rs, const size_t width, const size_t height, const SDL_WindowFlags flags);
-void draw_screen(render_state_t* rs, pixel_color_t screen[SCREEN_SIZE]);
+bool render_set_filter(render_state_t* rs, scale_filter_t filter, uint8_t factor);
+void render_set_overlay(render_state_t* rs, const char* text);
+void draw_screen(render_state_t* rs, const frame_t* frame);
+void draw_mosaic(render_state_t* rs, mosaic_t* mosaic);
+double render_jitter_ns(const render_stats_t* stats);
 SDL_FRect create_pixel_stamp(const size_t window_width, const size_t window_height);
 void render_state_destroy(render_state_t* renderer);
 
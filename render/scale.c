@@ -0,0 +1,497 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "scale.h"
+
+static uint32_t grid_color(uint32_t color, display_format_t format) {
+  // alpha stays where it is, the three color channels are scaled
+  uint32_t alpha_mask = format == DISPLAY_FORMAT_RGBA8888 ? 0x000000FF : 0xFF000000;
+  uint32_t dimmed = color & alpha_mask;
+  for (uint8_t shift = 0; shift < 32; shift += 8) {
+    if ((alpha_mask >> shift) & 0xFF) {
+      continue;
+    }
+    uint32_t channel = (color >> shift) & 0xFF;
+    dimmed |= (channel * SCALE_GRID_LEVEL / 256) << shift;
+  }
+  return dimmed;
+}
+
+static void unpack_rgb(uint32_t color, display_format_t format, int32_t rgb[3]) {
+  uint8_t shift = format == DISPLAY_FORMAT_RGBA8888 ? 8 : 0;
+  rgb[0] = (color >> (shift + 16)) & 0xFF;
+  rgb[1] = (color >> (shift + 8)) & 0xFF;
+  rgb[2] = (color >> shift) & 0xFF;
+}
+
+static int32_t magnitude(int32_t value) {
+  //
+  return value < 0 ? -value : value;
+}
+
+// the weights xBR gives luma and chroma differences, in thousandths so it stays in integers
+static uint16_t xbr_distance(uint32_t a, uint32_t b, display_format_t format) {
+  int32_t ca[3], cb[3];
+  unpack_rgb(a, format, ca);
+  unpack_rgb(b, format, cb);
+  int32_t r = ca[0] - cb[0], g = ca[1] - cb[1], bl = ca[2] - cb[2];
+  int32_t y = 299 * r + 587 * g + 114 * bl;
+  int32_t u = -169 * r - 331 * g + 500 * bl;
+  int32_t v = 500 * r - 419 * g - 81 * bl;
+  return (48 * magnitude(y) + 7 * magnitude(u) + 6 * magnitude(v)) / 1000;
+}
+
+bool scaler_supports(scale_filter_t filter, uint8_t factor) {
+  if (factor < 1 || factor > SCALE_MAX_FACTOR) {
+    return false;
+  }
+  switch (filter) {
+  case SCALE_FILTER_NEAREST:
+    return true;
+  case SCALE_FILTER_EPX:
+  case SCALE_FILTER_LCD_GRID:
+    return factor >= 2;
+  case SCALE_FILTER_XBR:
+    return factor == 2 || factor == 4;
+  }
+  return false;
+}
+
+bool scaler_init(scaler_t* scaler, scale_filter_t filter, uint8_t factor, const display_lut_t* lut) {
+  if (!scaler_supports(filter, factor)) {
+    return false;
+  }
+  scaler->filter = filter;
+  scaler->factor = factor;
+  scaler_set_colors(scaler, lut);
+  memset(scaler->padded, 0, sizeof(scaler->padded));
+  memset(scaler->doubled, 0, sizeof(scaler->doubled));
+  return true;
+}
+
+/*
+ * Takes the colors of `lut`, for a new set of CGB palettes
+ */
+void scaler_set_colors(scaler_t* scaler, const display_lut_t* lut) {
+  for (uint8_t index = 0; index < CGB_COLOR_COUNT; ++index) {
+    scaler->colors[index] = lut->colors[index];
+    scaler->grid_colors[index] = grid_color(lut->colors[index], lut->format);
+  }
+  // CGB palettes can change several times a frame, only xBR pays for its table
+  if (scaler->filter != SCALE_FILTER_XBR) {
+    return;
+  }
+  for (uint8_t a = 0; a < CGB_COLOR_COUNT; ++a) {
+    scaler->distance[a][a] = 0;
+    for (uint8_t b = 0; b < a; ++b) {
+      scaler->distance[a][b] = xbr_distance(lut->colors[a], lut->colors[b], lut->format);
+      scaler->distance[b][a] = scaler->distance[a][b];
+    }
+  }
+}
+
+static uint32_t* dest_row(void* dest, size_t pitch, size_t y) {
+  //
+  return (uint32_t*)((uint8_t*)dest + y * pitch);
+}
+
+/*
+ * Repeats the outermost pixels of a width x height image stored from (1, 1)
+ * into the border around it, so the EPX neighbours of an edge pixel are itself
+ */
+static void pad_edges(pixel_shade_t image[SCALE_PADDED_HEIGHT][SCALE_PADDED_WIDTH], size_t width, size_t height) {
+  for (size_t y = 1; y <= height; ++y) {
+    image[y][0] = image[y][1];
+    image[y][width + 1] = image[y][width];
+  }
+  memcpy(image[0], image[1], width + 2);
+  memcpy(image[height + 1], image[height], width + 2);
+}
+
+static void copy_padded(scaler_t* scaler, const pixel_shade_t screen[SCREEN_SIZE]) {
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    memcpy(&scaler->padded[y + 1][1], &screen[y * SCREEN_WIDTH], SCREEN_WIDTH);
+  }
+  pad_edges(scaler->padded, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+static void shades_to_colors(const uint32_t colors[CGB_COLOR_COUNT], const pixel_shade_t* shades, uint32_t* dest, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dest[i] = colors[shades[i] & (CGB_COLOR_COUNT - 1)];
+  }
+}
+
+/*
+ * Writes `src` out `factor` times wider. The SSE2 path widens four pixels at
+ * a time with shuffles, the 3x case has no clean shuffle and stays scalar.
+ */
+static void widen_row(const uint32_t* src, uint32_t* dest, size_t width, uint8_t factor) {
+  size_t x = 0;
+#if defined(__SSE2__)
+  if (factor == 2) {
+    for (; x + 4 <= width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i*)&src[x]);
+      _mm_storeu_si128((__m128i*)&dest[x * 2], _mm_unpacklo_epi32(v, v));
+      _mm_storeu_si128((__m128i*)&dest[x * 2 + 4], _mm_unpackhi_epi32(v, v));
+    }
+  } else if (factor == 4) {
+    for (; x + 4 <= width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i*)&src[x]);
+      _mm_storeu_si128((__m128i*)&dest[x * 4], _mm_shuffle_epi32(v, 0x00));
+      _mm_storeu_si128((__m128i*)&dest[x * 4 + 4], _mm_shuffle_epi32(v, 0x55));
+      _mm_storeu_si128((__m128i*)&dest[x * 4 + 8], _mm_shuffle_epi32(v, 0xAA));
+      _mm_storeu_si128((__m128i*)&dest[x * 4 + 12], _mm_shuffle_epi32(v, 0xFF));
+    }
+  }
+#endif
+  for (; x < width; ++x) {
+    for (uint8_t i = 0; i < factor; ++i) {
+      dest[x * factor + i] = src[x];
+    }
+  }
+}
+
+static void scale_nearest(scaler_t* scaler, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch) {
+  uint8_t factor = scaler->factor;
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    uint32_t* first = dest_row(dest, pitch, y * factor);
+    if (factor == 1) {
+      shades_to_colors(scaler->colors, &screen[y * SCREEN_WIDTH], first, SCREEN_WIDTH);
+      continue;
+    }
+    shades_to_colors(scaler->colors, &screen[y * SCREEN_WIDTH], scaler->line, SCREEN_WIDTH);
+    widen_row(scaler->line, first, SCREEN_WIDTH, factor);
+    for (uint8_t i = 1; i < factor; ++i) {
+      memcpy(dest_row(dest, pitch, y * factor + i), first, SCREEN_WIDTH * factor * sizeof(uint32_t));
+    }
+  }
+}
+
+/*
+ * Every block keeps its top-left (factor - 1) square, the rest is the grid
+ */
+static void scale_lcd_grid(scaler_t* scaler, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch) {
+  uint8_t factor = scaler->factor;
+  size_t width = SCREEN_WIDTH * factor;
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    const pixel_shade_t* shades = &screen[y * SCREEN_WIDTH];
+    uint32_t* first = dest_row(dest, pitch, y * factor);
+    uint32_t* grid = dest_row(dest, pitch, y * factor + factor - 1);
+    for (size_t x = 0; x < SCREEN_WIDTH; ++x) {
+      pixel_shade_t shade = shades[x] & (CGB_COLOR_COUNT - 1);
+      uint32_t dim = scaler->grid_colors[shade];
+      for (uint8_t i = 0; i < factor - 1; ++i) {
+        first[x * factor + i] = scaler->colors[shade];
+        grid[x * factor + i] = dim;
+      }
+      first[x * factor + factor - 1] = dim;
+      grid[x * factor + factor - 1] = dim;
+    }
+    for (uint8_t i = 1; i < factor - 1; ++i) {
+      memcpy(dest_row(dest, pitch, y * factor + i), first, width * sizeof(uint32_t));
+    }
+  }
+}
+
+/*
+ * The EPX neighbourhood of E, read from padded rows:
+ *
+ *   A B C
+ *   D E F
+ *   G H I
+ *
+ * Scale2x replaces each quarter of E with the neighbour on that corner when
+ * the two edges meeting there agree and the other two do not. Scale3x adds
+ * the edge midpoints, which follow a corner only where E differs from the
+ * pixel diagonally across.
+ */
+static void epx2_pixel(const pixel_shade_t* up, const pixel_shade_t* row, const pixel_shade_t* down, size_t x, pixel_shade_t out[4]) {
+  pixel_shade_t b = up[x + 1], d = row[x], e = row[x + 1], f = row[x + 2], h = down[x + 1];
+  out[0] = (d == b && b != f && d != h) ? d : e;
+  out[1] = (b == f && b != d && f != h) ? f : e;
+  out[2] = (d == h && d != b && h != f) ? d : e;
+  out[3] = (h == f && d != h && b != f) ? f : e;
+}
+
+static void epx3_pixel(const pixel_shade_t* up, const pixel_shade_t* row, const pixel_shade_t* down, size_t x, pixel_shade_t out[9]) {
+  pixel_shade_t a = up[x], b = up[x + 1], c = up[x + 2];
+  pixel_shade_t d = row[x], e = row[x + 1], f = row[x + 2];
+  pixel_shade_t g = down[x], h = down[x + 1], i = down[x + 2];
+  bool top_left = d == b && b != f && d != h;
+  bool top_right = b == f && b != d && f != h;
+  bool bottom_left = d == h && d != b && h != f;
+  bool bottom_right = h == f && d != h && b != f;
+  out[0] = top_left ? d : e;
+  out[1] = (top_left && e != c) || (top_right && e != a) ? b : e;
+  out[2] = top_right ? f : e;
+  out[3] = (top_left && e != g) || (bottom_left && e != a) ? d : e;
+  out[4] = e;
+  out[5] = (top_right && e != i) || (bottom_right && e != c) ? f : e;
+  out[6] = bottom_left ? d : e;
+  out[7] = (bottom_left && e != i) || (bottom_right && e != g) ? h : e;
+  out[8] = bottom_right ? f : e;
+}
+
+#if defined(__SSE2__)
+static inline __m128i select_epi8(__m128i mask, __m128i a, __m128i b) {
+  //
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// mask & ~a & ~b
+static inline __m128i only_epi8(__m128i mask, __m128i a, __m128i b) {
+  //
+  return _mm_andnot_si128(_mm_or_si128(a, b), mask);
+}
+#endif
+
+/*
+ * Scales one padded row of `width` shades into two rows twice as wide
+ */
+static void epx2_row(const pixel_shade_t* up, const pixel_shade_t* row, const pixel_shade_t* down, size_t width, pixel_shade_t* out0, pixel_shade_t* out1) {
+  size_t x = 0;
+#if defined(__SSE2__)
+  for (; x + 16 <= width; x += 16) {
+    __m128i b = _mm_loadu_si128((const __m128i*)&up[x + 1]);
+    __m128i d = _mm_loadu_si128((const __m128i*)&row[x]);
+    __m128i e = _mm_loadu_si128((const __m128i*)&row[x + 1]);
+    __m128i f = _mm_loadu_si128((const __m128i*)&row[x + 2]);
+    __m128i h = _mm_loadu_si128((const __m128i*)&down[x + 1]);
+    __m128i db = _mm_cmpeq_epi8(d, b), bf = _mm_cmpeq_epi8(b, f);
+    __m128i dh = _mm_cmpeq_epi8(d, h), hf = _mm_cmpeq_epi8(h, f);
+    __m128i e0 = select_epi8(only_epi8(db, bf, dh), d, e);
+    __m128i e1 = select_epi8(only_epi8(bf, db, hf), f, e);
+    __m128i e2 = select_epi8(only_epi8(dh, db, hf), d, e);
+    __m128i e3 = select_epi8(only_epi8(hf, dh, bf), f, e);
+    _mm_storeu_si128((__m128i*)&out0[x * 2], _mm_unpacklo_epi8(e0, e1));
+    _mm_storeu_si128((__m128i*)&out0[x * 2 + 16], _mm_unpackhi_epi8(e0, e1));
+    _mm_storeu_si128((__m128i*)&out1[x * 2], _mm_unpacklo_epi8(e2, e3));
+    _mm_storeu_si128((__m128i*)&out1[x * 2 + 16], _mm_unpackhi_epi8(e2, e3));
+  }
+#endif
+  for (; x < width; ++x) {
+    pixel_shade_t out[4];
+    epx2_pixel(up, row, down, x, out);
+    out0[x * 2] = out[0];
+    out0[x * 2 + 1] = out[1];
+    out1[x * 2] = out[2];
+    out1[x * 2 + 1] = out[3];
+  }
+}
+
+/*
+ * Scales one padded row of `width` shades into three rows three times as
+ * wide. The rules are evaluated with masks, there is no 3-way byte interleave
+ * in SSE2 so the nine results go through the stack to be spread out.
+ */
+static void epx3_row(const pixel_shade_t* up, const pixel_shade_t* row, const pixel_shade_t* down, size_t width, pixel_shade_t* out[3]) {
+  size_t x = 0;
+#if defined(__SSE2__)
+  for (; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)&up[x]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&up[x + 1]);
+    __m128i c = _mm_loadu_si128((const __m128i*)&up[x + 2]);
+    __m128i d = _mm_loadu_si128((const __m128i*)&row[x]);
+    __m128i e = _mm_loadu_si128((const __m128i*)&row[x + 1]);
+    __m128i f = _mm_loadu_si128((const __m128i*)&row[x + 2]);
+    __m128i g = _mm_loadu_si128((const __m128i*)&down[x]);
+    __m128i h = _mm_loadu_si128((const __m128i*)&down[x + 1]);
+    __m128i i = _mm_loadu_si128((const __m128i*)&down[x + 2]);
+    __m128i db = _mm_cmpeq_epi8(d, b), bf = _mm_cmpeq_epi8(b, f);
+    __m128i dh = _mm_cmpeq_epi8(d, h), hf = _mm_cmpeq_epi8(h, f);
+    __m128i ea = _mm_cmpeq_epi8(e, a), ec = _mm_cmpeq_epi8(e, c);
+    __m128i eg = _mm_cmpeq_epi8(e, g), ei = _mm_cmpeq_epi8(e, i);
+    __m128i top_left = only_epi8(db, bf, dh);
+    __m128i top_right = only_epi8(bf, db, hf);
+    __m128i bottom_left = only_epi8(dh, db, hf);
+    __m128i bottom_right = only_epi8(hf, dh, bf);
+
+    pixel_shade_t blocks[9][16];
+    _mm_storeu_si128((__m128i*)blocks[0], select_epi8(top_left, d, e));
+    _mm_storeu_si128((__m128i*)blocks[1], select_epi8(_mm_or_si128(_mm_andnot_si128(ec, top_left), _mm_andnot_si128(ea, top_right)), b, e));
+    _mm_storeu_si128((__m128i*)blocks[2], select_epi8(top_right, f, e));
+    _mm_storeu_si128((__m128i*)blocks[3], select_epi8(_mm_or_si128(_mm_andnot_si128(eg, top_left), _mm_andnot_si128(ea, bottom_left)), d, e));
+    _mm_storeu_si128((__m128i*)blocks[4], e);
+    _mm_storeu_si128((__m128i*)blocks[5], select_epi8(_mm_or_si128(_mm_andnot_si128(ei, top_right), _mm_andnot_si128(ec, bottom_right)), f, e));
+    _mm_storeu_si128((__m128i*)blocks[6], select_epi8(bottom_left, d, e));
+    _mm_storeu_si128((__m128i*)blocks[7], select_epi8(_mm_or_si128(_mm_andnot_si128(ei, bottom_left), _mm_andnot_si128(eg, bottom_right)), h, e));
+    _mm_storeu_si128((__m128i*)blocks[8], select_epi8(bottom_right, f, e));
+    for (size_t n = 0; n < 16; ++n) {
+      for (uint8_t r = 0; r < 3; ++r) {
+        out[r][(x + n) * 3 + 0] = blocks[r * 3 + 0][n];
+        out[r][(x + n) * 3 + 1] = blocks[r * 3 + 1][n];
+        out[r][(x + n) * 3 + 2] = blocks[r * 3 + 2][n];
+      }
+    }
+  }
+#endif
+  for (; x < width; ++x) {
+    pixel_shade_t block[9];
+    epx3_pixel(up, row, down, x, block);
+    for (uint8_t r = 0; r < 3; ++r) {
+      out[r][x * 3 + 0] = block[r * 3 + 0];
+      out[r][x * 3 + 1] = block[r * 3 + 1];
+      out[r][x * 3 + 2] = block[r * 3 + 2];
+    }
+  }
+}
+
+static void scale_epx2(scaler_t* scaler, void* dest, size_t pitch) {
+  size_t width = SCREEN_WIDTH * 2;
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    epx2_row(scaler->padded[y], scaler->padded[y + 1], scaler->padded[y + 2], SCREEN_WIDTH, scaler->row[0], scaler->row[1]);
+    shades_to_colors(scaler->colors, scaler->row[0], dest_row(dest, pitch, y * 2), width);
+    shades_to_colors(scaler->colors, scaler->row[1], dest_row(dest, pitch, y * 2 + 1), width);
+  }
+}
+
+static void scale_epx3(scaler_t* scaler, void* dest, size_t pitch) {
+  size_t width = SCREEN_WIDTH * 3;
+  pixel_shade_t* rows[3] = {scaler->row[0], scaler->row[1], scaler->row[2]};
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    epx3_row(scaler->padded[y], scaler->padded[y + 1], scaler->padded[y + 2], SCREEN_WIDTH, rows);
+    for (uint8_t r = 0; r < 3; ++r) {
+      shades_to_colors(scaler->colors, rows[r], dest_row(dest, pitch, y * 3 + r), width);
+    }
+  }
+}
+
+/*
+ * Scale2x into the padded intermediate, then Scale2x again from there
+ */
+static void scale_epx4(scaler_t* scaler, void* dest, size_t pitch) {
+  size_t width = SCREEN_WIDTH * 2;
+  size_t height = SCREEN_HEIGHT * 2;
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    epx2_row(scaler->padded[y], scaler->padded[y + 1], scaler->padded[y + 2], SCREEN_WIDTH, &scaler->doubled[y * 2 + 1][1],
+             &scaler->doubled[y * 2 + 2][1]);
+  }
+  pad_edges(scaler->doubled, width, height);
+  for (size_t y = 0; y < height; ++y) {
+    epx2_row(scaler->doubled[y], scaler->doubled[y + 1], scaler->doubled[y + 2], width, scaler->row[0], scaler->row[1]);
+    shades_to_colors(scaler->colors, scaler->row[0], dest_row(dest, pitch, y * 2), width * 2);
+    shades_to_colors(scaler->colors, scaler->row[1], dest_row(dest, pitch, y * 2 + 1), width * 2);
+  }
+}
+
+/*
+ * xBR-lite, on the neighbourhood of E:
+ *
+ *         A1 B1 C1
+ *      A0 A  B  C  C4
+ *      D0 D  E  F  F4
+ *      G0 G  H  I  I4
+ *         G5 H5 I5
+ *
+ * The quarter of E towards I follows an edge along H-F when
+ *
+ *   d(E,C) + d(E,G) + d(I,F4) + d(I,H5) + 4 d(H,F) < d(H,D) + d(H,I5) + d(F,I4) + d(F,B) + 4 d(E,I)
+ *
+ * and then takes whichever of F and H is closer to E, unless F and H both run
+ * straight on past E (F = B and H = D) without E joining the edge at C, G or
+ * I, which is what keeps lone pixels whole. The other quarters are the same
+ * rule mirrored by `dx`, `dy`. Real xBR blends that quarter with E,
+ * replacing it outright keeps the output indexes into the colors like every
+ * other filter here. The distances are a lookup per pair of indexes, which
+ * SSE2 cannot gather, so this runs scalar, still the same work every frame.
+ */
+static pixel_shade_t xbr_corner(const scaler_t* scaler, const pixel_shade_t* const p[5], int dx, int dy) {
+  const uint16_t(*dist)[CGB_COLOR_COUNT] = scaler->distance;
+  // named as for the quarter towards I
+  pixel_shade_t b = p[2 - dy][2], c = p[2 - dy][2 + dx];
+  pixel_shade_t d = p[2][2 - dx], e = p[2][2], f = p[2][2 + dx], f4 = p[2][2 + 2 * dx];
+  pixel_shade_t g = p[2 + dy][2 - dx], h = p[2 + dy][2], i = p[2 + dy][2 + dx], i4 = p[2 + dy][2 + 2 * dx];
+  pixel_shade_t h5 = p[2 + 2 * dy][2], i5 = p[2 + 2 * dy][2 + dx];
+  // everything is worked out whatever the pixels are, so the time does not depend on them
+  uint32_t along = dist[e][c] + dist[e][g] + dist[i][f4] + dist[i][h5] + 4 * dist[h][f];
+  uint32_t across = dist[h][d] + dist[h][i5] + dist[f][i4] + dist[f][b] + 4 * dist[e][i];
+  bool edge = (dist[f][b] != 0 && dist[h][d] != 0) | (dist[e][i] == 0 && dist[f][i4] != 0 && dist[h][i5] != 0) | (dist[e][g] == 0) | (dist[e][c] == 0);
+  bool take = (e != f) & (e != h) & (along < across) & edge;
+  pixel_shade_t closer = dist[e][f] <= dist[e][h] ? f : h;
+  return take ? closer : e;
+}
+
+static size_t clamp_index(long index, size_t count) {
+  if (index < 0) {
+    return 0;
+  }
+  return (size_t)index >= count ? count - 1 : (size_t)index;
+}
+
+/*
+ * Scales row `y` of a width x height image into two rows twice as wide. Like
+ * EPX, neighbours past the edges repeat the outermost pixels: the five rows
+ * around `y` are copied out with two of them on either side first.
+ */
+static void xbr2_row(scaler_t* scaler, const pixel_shade_t* image, size_t stride, size_t width, size_t height, size_t y, pixel_shade_t* out0,
+                     pixel_shade_t* out1) {
+  for (int r = 0; r < 5; ++r) {
+    const pixel_shade_t* source = &image[clamp_index((long)y + r - 2, height) * stride];
+    pixel_shade_t* line = scaler->xbr_lines[r];
+    for (size_t x = 0; x < width; ++x) {
+      line[x + 2] = source[x] & (CGB_COLOR_COUNT - 1);
+    }
+    line[0] = line[1] = line[2];
+    line[width + 2] = line[width + 3] = line[width + 1];
+  }
+  for (size_t x = 0; x < width; ++x) {
+    const pixel_shade_t* const p[5] = {&scaler->xbr_lines[0][x], &scaler->xbr_lines[1][x], &scaler->xbr_lines[2][x], &scaler->xbr_lines[3][x],
+                                       &scaler->xbr_lines[4][x]};
+    // all four before any store, a byte store could alias everything they read
+    pixel_shade_t top_left = xbr_corner(scaler, p, -1, -1), top_right = xbr_corner(scaler, p, 1, -1);
+    pixel_shade_t bottom_left = xbr_corner(scaler, p, -1, 1), bottom_right = xbr_corner(scaler, p, 1, 1);
+    out0[x * 2] = top_left;
+    out0[x * 2 + 1] = top_right;
+    out1[x * 2] = bottom_left;
+    out1[x * 2 + 1] = bottom_right;
+  }
+}
+
+/*
+ * At 4 the first pass goes into `doubled` and the second scales that
+ */
+static void scale_xbr(scaler_t* scaler, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch) {
+  const pixel_shade_t* image = screen;
+  size_t stride = SCREEN_WIDTH, width = SCREEN_WIDTH, height = SCREEN_HEIGHT;
+  if (scaler->factor == 4) {
+    for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+      xbr2_row(scaler, screen, SCREEN_WIDTH, SCREEN_WIDTH, SCREEN_HEIGHT, y, scaler->doubled[y * 2], scaler->doubled[y * 2 + 1]);
+    }
+    image = scaler->doubled[0];
+    stride = SCALE_PADDED_WIDTH;
+    width = SCREEN_WIDTH * 2;
+    height = SCREEN_HEIGHT * 2;
+  }
+  for (size_t y = 0; y < height; ++y) {
+    xbr2_row(scaler, image, stride, width, height, y, scaler->row[0], scaler->row[1]);
+    shades_to_colors(scaler->colors, scaler->row[0], dest_row(dest, pitch, y * 2), width * 2);
+    shades_to_colors(scaler->colors, scaler->row[1], dest_row(dest, pitch, y * 2 + 1), width * 2);
+  }
+}
+
+void scaler_run(scaler_t* scaler, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch) {
+  switch (scaler->filter) {
+  case SCALE_FILTER_NEAREST:
+    scale_nearest(scaler, screen, dest, pitch);
+    break;
+  case SCALE_FILTER_LCD_GRID:
+    scale_lcd_grid(scaler, screen, dest, pitch);
+    break;
+  case SCALE_FILTER_EPX:
+    copy_padded(scaler, screen);
+    if (scaler->factor == 2) {
+      scale_epx2(scaler, dest, pitch);
+    } else if (scaler->factor == 3) {
+      scale_epx3(scaler, dest, pitch);
+    } else {
+      scale_epx4(scaler, dest, pitch);
+    }
+    break;
+  case SCALE_FILTER_XBR:
+    scale_xbr(scaler, screen, dest, pitch);
+    break;
+  }
+}
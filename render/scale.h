@@ -0,0 +1,67 @@
+#ifndef RENDER_SCALE_H
+#define RENDER_SCALE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../display.h"
+
+/*
+ * CPU upscalers for machines where SDL renders in software. They take a
+ * frame of shades and write packed pixels (see display_lut_t) straight into
+ * locked texture memory at an integer factor.
+ *
+ *   NEAREST   every pixel becomes a factor x factor block, factors 1-4
+ *   EPX       Scale2x at 2, Scale3x at 3 and Scale2x twice at 4
+ *   LCD_GRID  nearest with the last row and column of every block darkened
+ *             to look like the gaps between LCD cells, factors 2-4
+ *   XBR       xBR-lite at 2 and twice at 4, xBR's edge rule without the
+ *             blending so every output pixel is still one of the frame's
+ *
+ * Every filter does the same work for every frame whatever is in it, the
+ * EPX rules are evaluated 16 pixels at a time with masks instead of branches.
+ */
+
+#define SCALE_MAX_FACTOR 4
+// one pixel of border on each side, rounded up so 16 byte loads never leave the row
+#define SCALE_PADDED_WIDTH ((SCREEN_WIDTH) * 2 + 32)
+#define SCALE_PADDED_HEIGHT ((SCREEN_HEIGHT) * 2 + 2)
+// darkening of the grid lines, out of 256
+#define SCALE_GRID_LEVEL 160
+
+typedef enum {
+  SCALE_FILTER_NEAREST,
+  SCALE_FILTER_EPX,
+  SCALE_FILTER_LCD_GRID,
+  SCALE_FILTER_XBR,
+} scale_filter_t;
+
+typedef struct {
+  scale_filter_t filter;
+  uint8_t factor;
+  uint32_t colors[CGB_COLOR_COUNT];
+  uint32_t grid_colors[CGB_COLOR_COUNT];
+  // xBR's weighted YUV distance between every two colors, only kept up to date while the filter is XBR
+  uint16_t distance[CGB_COLOR_COUNT][CGB_COLOR_COUNT];
+  // the frame, and for EPX at 4 the 2x intermediate, with a replicated border
+  pixel_shade_t padded[SCALE_PADDED_HEIGHT][SCALE_PADDED_WIDTH];
+  pixel_shade_t doubled[SCALE_PADDED_HEIGHT][SCALE_PADDED_WIDTH];
+  // for XBR the five rows around the one being scaled, with a border of two
+  pixel_shade_t xbr_lines[5][SCALE_PADDED_WIDTH];
+  // one scaled row of shades, and the same in colors
+  pixel_shade_t row[SCALE_MAX_FACTOR][SCREEN_WIDTH * SCALE_MAX_FACTOR];
+  uint32_t line[SCREEN_WIDTH * SCALE_MAX_FACTOR];
+} scaler_t;
+
+bool scaler_supports(scale_filter_t filter, uint8_t factor);
+bool scaler_init(scaler_t* scaler, scale_filter_t filter, uint8_t factor, const display_lut_t* lut);
+void scaler_set_colors(scaler_t* scaler, const display_lut_t* lut);
+
+/*
+ * Scales a frame into `dest`, which has to hold SCREEN_HEIGHT * factor rows
+ * of `pitch` bytes each
+ */
+void scaler_run(scaler_t* scaler, const pixel_shade_t screen[SCREEN_SIZE], void* dest, size_t pitch);
+
+#endif // !DEBUG
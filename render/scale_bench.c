@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scale.h"
+
+/*
+ * Reports what scaling a frame costs for every filter and factor, on a noisy
+ * frame and on a flat one. The work does not depend on the content, so the
+ * two should come out the same.
+ */
+
+#define BENCH_FRAMES 200
+#define BENCH_REPEATS 5
+
+typedef struct {
+  const char* name;
+  scale_filter_t filter;
+} bench_filter_t;
+
+static const bench_filter_t filters[] = {
+    { "nearest",  SCALE_FILTER_NEAREST},
+    {     "epx",      SCALE_FILTER_EPX},
+    {"lcd grid", SCALE_FILTER_LCD_GRID},
+    {     "xbr",      SCALE_FILTER_XBR},
+};
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_run(scaler_t* scaler, const pixel_shade_t* screen, uint32_t* dest, size_t pitch) {
+  double best = 0;
+  for (int repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+    double start = bench_now_ns();
+    for (int i = 0; i < BENCH_FRAMES; ++i) {
+      scaler_run(scaler, screen, dest, pitch);
+    }
+    double ns = (bench_now_ns() - start) / BENCH_FRAMES;
+    if (repeat == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+int main(void) {
+  size_t pitch = SCREEN_WIDTH * SCALE_MAX_FACTOR * sizeof(uint32_t);
+  scaler_t* scaler = malloc(sizeof(scaler_t));
+  uint32_t* dest = malloc(pitch * SCREEN_HEIGHT * SCALE_MAX_FACTOR);
+  pixel_shade_t* noisy = malloc(SCREEN_SIZE);
+  pixel_shade_t* flat = calloc(SCREEN_SIZE, 1);
+  if (scaler == NULL || dest == NULL || noisy == NULL || flat == NULL) {
+    return 1;
+  }
+  uint32_t seed = 1;
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    seed = seed * 1103515245 + 12345;
+    noisy[i] = (seed >> 16) % SHADE_COUNT;
+  }
+  display_lut_t lut = display_lut_create(DISPLAY_DMG_SHADES, DISPLAY_FORMAT_RGBA8888);
+
+  printf("%-10s %6s %12s %12s\n", "filter", "factor", "noisy ms", "flat ms");
+  for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f) {
+    for (uint8_t factor = 1; factor <= SCALE_MAX_FACTOR; ++factor) {
+      if (!scaler_init(scaler, filters[f].filter, factor, &lut)) {
+        continue;
+      }
+      double noisy_ns = bench_run(scaler, noisy, dest, pitch);
+      double flat_ns = bench_run(scaler, flat, dest, pitch);
+      printf("%-10s %5ux %12.3f %12.3f\n", filters[f].name, factor, noisy_ns / 1e6, flat_ns / 1e6);
+    }
+  }
+
+  free(flat);
+  free(noisy);
+  free(dest);
+  free(scaler);
+  return 0;
+}
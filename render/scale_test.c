@@ -0,0 +1,102 @@
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#include "scale.h"
+
+static scaler_t scaler;
+static pixel_shade_t screen[SCREEN_SIZE];
+static uint32_t dest[SCREEN_HEIGHT * SCALE_MAX_FACTOR][SCREEN_WIDTH * SCALE_MAX_FACTOR + 8];
+
+static display_lut_t test_lut(void) {
+  //
+  return display_lut_create(DISPLAY_DMG_SHADES, DISPLAY_FORMAT_RGBA8888);
+}
+
+Test(scale, rejects_unsupported_factors) {
+  display_lut_t lut = test_lut();
+
+  cr_assert(scaler_init(&scaler, SCALE_FILTER_NEAREST, 1, &lut));
+  cr_assert(not(scaler_init(&scaler, SCALE_FILTER_EPX, 1, &lut)));
+  cr_assert(not(scaler_init(&scaler, SCALE_FILTER_LCD_GRID, SCALE_MAX_FACTOR + 1, &lut)));
+  cr_assert(not(scaler_init(&scaler, SCALE_FILTER_XBR, 3, &lut)));
+}
+
+Test(scale, nearest_fills_whole_blocks) {
+  display_lut_t lut = test_lut();
+  for (size_t i = 0; i < SCREEN_SIZE; ++i) {
+    screen[i] = i % SHADE_COUNT;
+  }
+
+  for (uint8_t factor = 1; factor <= SCALE_MAX_FACTOR; ++factor) {
+    cr_assert(scaler_init(&scaler, SCALE_FILTER_NEAREST, factor, &lut));
+    scaler_run(&scaler, screen, dest, sizeof(dest[0]));
+
+    cr_assert(eq(u32, dest[factor - 1][factor * 3 - 1], lut.colors[2]));
+    cr_assert(eq(u32, dest[factor][factor - 1], lut.colors[SCREEN_WIDTH % SHADE_COUNT]));
+    cr_assert(eq(u32, dest[SCREEN_HEIGHT * factor - 1][SCREEN_WIDTH * factor - 1], lut.colors[(SCREEN_SIZE - 1) % SHADE_COUNT]));
+  }
+}
+
+Test(scale, epx_rounds_off_corners) {
+  display_lut_t lut = test_lut();
+  memset(screen, 0, sizeof(screen));
+  // a diagonal step: the pixel at (10, 10) has dark neighbours above and to the left
+  screen[9 * SCREEN_WIDTH + 10] = 3;
+  screen[10 * SCREEN_WIDTH + 9] = 3;
+
+  cr_assert(scaler_init(&scaler, SCALE_FILTER_EPX, 2, &lut));
+  scaler_run(&scaler, screen, dest, sizeof(dest[0]));
+  cr_assert(eq(u32, dest[20][20], lut.colors[3]));
+  cr_assert(eq(u32, dest[20][21], lut.colors[0]));
+  cr_assert(eq(u32, dest[21][20], lut.colors[0]));
+
+  cr_assert(scaler_init(&scaler, SCALE_FILTER_EPX, 3, &lut));
+  scaler_run(&scaler, screen, dest, sizeof(dest[0]));
+  cr_assert(eq(u32, dest[30][30], lut.colors[3]));
+  cr_assert(eq(u32, dest[31][31], lut.colors[0]));
+  cr_assert(eq(u32, dest[32][32], lut.colors[0]));
+}
+
+Test(scale, lcd_grid_darkens_block_edges) {
+  display_lut_t lut = test_lut();
+  memset(screen, 0, sizeof(screen));
+
+  cr_assert(scaler_init(&scaler, SCALE_FILTER_LCD_GRID, 3, &lut));
+  scaler_run(&scaler, screen, dest, sizeof(dest[0]));
+
+  cr_assert(eq(u32, dest[0][0], lut.colors[0]));
+  cr_assert(eq(u32, dest[1][1], lut.colors[0]));
+  cr_assert(eq(u32, dest[0][2], scaler.grid_colors[0]));
+  cr_assert(eq(u32, dest[2][0], scaler.grid_colors[0]));
+  cr_assert(eq(u32, scaler.grid_colors[0] & 0xFF, 0xFF));
+  cr_assert(lt(u32, scaler.grid_colors[0] >> 24, lut.colors[0] >> 24));
+}
+
+/*
+ * Below the diagonal is dark. The light pixels along it get their lower left
+ * corner filled in. A lone dark pixel away from it stays whole at 2, at 4 the
+ * second pass rounds it off but keeps its middle.
+ */
+Test(scale, xbr_follows_diagonals) {
+  display_lut_t lut = test_lut();
+  for (size_t y = 0; y < SCREEN_HEIGHT; ++y) {
+    for (size_t x = 0; x < SCREEN_WIDTH; ++x) {
+      screen[y * SCREEN_WIDTH + x] = x < y ? 3 : 0;
+    }
+  }
+  screen[20 * SCREEN_WIDTH + 150] = 3;
+
+  for (uint8_t factor = 2; factor <= 4; factor += 2) {
+    cr_assert(scaler_init(&scaler, SCALE_FILTER_XBR, factor, &lut));
+    scaler_run(&scaler, screen, dest, sizeof(dest[0]));
+    size_t top = 10 * factor, left = 10 * factor;
+    cr_assert(eq(u32, dest[top + factor - 1][left], lut.colors[3]));
+    cr_assert(eq(u32, dest[top][left + factor - 1], lut.colors[0]));
+    cr_assert(eq(u32, dest[top][left], lut.colors[0]));
+    for (uint8_t i = 0; i < factor; ++i) {
+      cr_assert(eq(u32, dest[20 * factor + i][150 * factor + factor / 2], lut.colors[3]));
+      cr_assert(eq(u32, dest[20 * factor + factor / 2][150 * factor + i], lut.colors[3]));
+    }
+    cr_assert(eq(u32, dest[20 * factor - 1][150 * factor], lut.colors[0]));
+  }
+}